@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include "../lib/cJSON/cJSON.h"
+#include "../lib/json_map/json_map.h"
+#include "../lib/json_index/json_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Larger documents would need several GB for the cJSON tree
+#define CJSON_DOCUMENT_LIMIT 2000000
+
+typedef struct {
+    char path[64];
+    FILE *file;
+    size_t bytes;
+} bench_file_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *format, size_t bytes, size_t records,
+                   double seconds) {
+    printf("  %-22s %-7s %10zu records %8.3fs %9.1f MB/s\n", name, format, records, seconds,
+           (double)bytes / seconds / (1024.0 * 1024.0));
+}
+
+// Write one scan record shaped like md5_scanner output
+static void write_record(FILE *file, size_t i) {
+    // Two 64-bit mixes of i give a 32-digit md5 like a real scan's
+    unsigned long long high = (unsigned long long)i * 0x9E3779B97F4A7C15ULL;
+    unsigned long long low = ((unsigned long long)i ^ 0x5bd1e995) * 0xC2B2AE3D27D4EB4FULL;
+    fprintf(file, "{\"path\":\"usr/share/bench/dir%03zu/file_%09zu.dat\","
+            "\"md5\":\"%016llx%016llx\",\"size\":%zu,"
+            "\"mtime\":\"1700000000.%09zu\",\"ctime\":\"1700000000.%09zu\","
+            "\"inode\":%zu,\"dev\":2049}",
+            i % 1000, i, high, low,
+            i * 37 % 1048576, i % 1000000000, i % 1000000000, i + 100000);
+}
+
+static int generate(bench_file_t *file, size_t entries, int document) {
+    snprintf(file->path, sizeof(file->path), "/tmp/json_bench_XXXXXX");
+    int fd = mkstemp(file->path);
+    if (fd < 0 || !(file->file = fdopen(fd, "w"))) {
+        fprintf(stderr, "Error: Cannot create benchmark input\n");
+        return -1;
+    }
+
+    if (document) {
+        fprintf(file->file, "{\n\t\"scan_info\":\t{\"scanned_directory\":\"/bench\","
+                "\"total_files\":%zu,\"errors\":0},\n\t\"files\":\t[", entries);
+    }
+    for (size_t i = 0; i < entries; i++) {
+        fputs(document ? (i ? ",\n\t\t" : "\n\t\t") : "", file->file);
+        write_record(file->file, i);
+        if (!document) fputc('\n', file->file);
+    }
+    if (document) {
+        fputs("]\n}\n", file->file);
+    } else {
+        fprintf(file->file, "{\"scan_info\":{\"total_files\":%zu,\"errors\":0}}\n", entries);
+    }
+
+    file->bytes = (size_t)ftell(file->file);
+    if (fclose(file->file) != 0) {
+        fprintf(stderr, "Error: Failed to write benchmark input\n");
+        return -1;
+    }
+    return 0;
+}
+
+static char *read_all(const bench_file_t *file) {
+    FILE *in = fopen(file->path, "r");
+    char *buffer = in ? malloc(file->bytes + 1) : NULL;
+    if (!buffer || fread(buffer, 1, file->bytes, in) != file->bytes) {
+        fprintf(stderr, "Error: Cannot read %s\n", file->path);
+        free(buffer);
+        buffer = NULL;
+    } else {
+        buffer[file->bytes] = '\0';
+    }
+    if (in) fclose(in);
+    return buffer;
+}
+
+static size_t count_cjson_records(const cJSON *object) {
+    return cJSON_IsString(cJSON_GetObjectItem(object, "path")) &&
+           cJSON_IsString(cJSON_GetObjectItem(object, "md5"));
+}
+
+static void bench_cjson_document(const bench_file_t *file) {
+    char *buffer = read_all(file);
+    if (!buffer) return;
+
+    double start = now_seconds();
+    cJSON *root = cJSON_Parse(buffer);
+    double seconds = now_seconds() - start;
+
+    size_t records = 0;
+    const cJSON *entry;
+    cJSON_ArrayForEach(entry, cJSON_GetObjectItem(root, "files")) {
+        records += count_cjson_records(entry);
+    }
+    report("cJSON_Parse", "json", file->bytes, records, seconds);
+    cJSON_Delete(root);
+    free(buffer);
+}
+
+static void bench_cjson_lines(const bench_file_t *file) {
+    char *buffer = read_all(file);
+    if (!buffer) return;
+
+    size_t records = 0;
+    double start = now_seconds();
+    for (char *line = buffer; *line; ) {
+        char *end = strchr(line, '\n');
+        size_t length = end ? (size_t)(end - line) : strlen(line);
+        cJSON *object = cJSON_ParseWithLength(line, length);
+        records += count_cjson_records(object);
+        cJSON_Delete(object);
+        line += length + (end != NULL);
+    }
+    report("cJSON_Parse per line", "ndjson", file->bytes, records, now_seconds() - start);
+    free(buffer);
+}
+
+static int count_map_record(const json_map_t *map, const json_map_record_t *record,
+                            void *user_data) {
+    size_t *records = (size_t *)user_data;
+    *records += json_map_member(map, record, "path") && json_map_member(map, record, "md5");
+    return 0;
+}
+
+static void bench_json_map(const bench_file_t *file, const char *format) {
+    static const json_index_kernel_t kernels[] = {
+        JSON_INDEX_SCALAR, JSON_INDEX_SSE42, JSON_INDEX_AVX2
+    };
+
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (json_index_set_kernel(kernels[i]) != 0) continue;
+
+        // Fault the file into the page cache first so every kernel sees the same input
+        json_map_t *map = json_map_open(file->path);
+        if (!map) {
+            fprintf(stderr, "Error: Cannot map %s\n", file->path);
+            return;
+        }
+        volatile unsigned char sink = 0;
+        for (size_t offset = 0; offset < file->bytes; offset += 4096) {
+            sink ^= (unsigned char)json_map_data(map)[offset];
+        }
+
+        size_t records = 0;
+        double start = now_seconds();
+        int result = json_map_records(map, count_map_record, &records);
+        double seconds = now_seconds() - start;
+        json_map_close(map);
+
+        char name[32];
+        snprintf(name, sizeof(name), "json_map (%s)", json_index_kernel_name(kernels[i]));
+        if (result == 0) report(name, format, file->bytes, records, seconds);
+    }
+    json_index_set_kernel(JSON_INDEX_AUTO);
+}
+
+static void bench_entries(size_t entries) {
+    bench_file_t document = {{0}, NULL, 0};
+    bench_file_t lines = {{0}, NULL, 0};
+
+    printf("%zu entries:\n", entries);
+    if (generate(&document, entries, 1) == 0 && generate(&lines, entries, 0) == 0) {
+        if (entries <= CJSON_DOCUMENT_LIMIT) {
+            bench_cjson_document(&document);
+        } else {
+            printf("  %-22s json    skipped above %d entries\n", "cJSON_Parse", CJSON_DOCUMENT_LIMIT);
+        }
+        bench_cjson_lines(&lines);
+        bench_json_map(&document, "json");
+        bench_json_map(&lines, "ndjson");
+    }
+    if (document.path[0]) unlink(document.path);
+    if (lines.path[0]) unlink(lines.path);
+}
+
+int main(int argc, char *argv[]) {
+    printf("JSON parse benchmark (auto kernel: %s)\n", json_index_kernel_name(json_index_kernel()));
+
+    if (argc < 2) {
+        bench_entries(1000000);
+        bench_entries(10000000);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        char *end = NULL;
+        unsigned long long entries = strtoull(argv[i], &end, 10);
+        if (!end || *end != '\0' || entries == 0) {
+            fprintf(stderr, "Usage: %s [entries...]\n", argv[0]);
+            return 1;
+        }
+        bench_entries((size_t)entries);
+    }
+    return 0;
+}
@@ -0,0 +1,643 @@
+#define _GNU_SOURCE
+#include "../lib/calc_md5/calc_md5.h"
+#include "../lib/md5_mb/md5_mb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+// Bytes hashed per message size and implementation
+#define DEFAULT_BENCH_BYTES (256ULL * 1024 * 1024)
+#define HEX_DIGESTS 1000000
+
+static const calc_md5_kernel_t md5_kernels[] = {
+    CALC_MD5_GENERIC, CALC_MD5_BMI2
+};
+
+static const md5_mb_kernel_t mb_kernels[] = {
+    MD5_MB_SCALAR, MD5_MB_SSE2, MD5_MB_AVX2, MD5_MB_AVX512
+};
+
+static const sha256_kernel_t sha256_kernels[] = {
+    SHA256_GENERIC, SHA256_SHANI
+};
+
+typedef void (*hash_fn)(const uint8_t *data, size_t length, uint8_t digest[16]);
+
+// ---------------------------------------------------------------------------
+// Reference: the byte-assembling transform calc_md5.c used before, kept as
+// the baseline the tuned code is measured against
+
+#define REF_F(x, y, z) (((x) & (y)) | ((~x) & (z)))
+#define REF_G(x, y, z) (((x) & (z)) | ((y) & (~z)))
+#define REF_H(x, y, z) ((x) ^ (y) ^ (z))
+#define REF_I(x, y, z) ((y) ^ ((x) | (~z)))
+#define REF_ROTLEFT(a, b) (((a) << (b)) | ((a) >> (32-(b))))
+#define REF_STEP(f, a, b, c, d, x, s, ac) { \
+    (a) += f((b), (c), (d)) + (x) + (uint32_t)(ac); \
+    (a) = REF_ROTLEFT((a), (s)); \
+    (a) += (b); \
+}
+
+static const uint8_t ref_padding[64] = {0x80};
+
+static void ref_transform(MD5_CTX *ctx, const uint8_t block[64]) {
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t x[16];
+
+    for (int i = 0; i < 16; i++) {
+        x[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+               ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    REF_STEP(REF_F, a, b, c, d, x[0], 7, 0xd76aa478);
+    REF_STEP(REF_F, d, a, b, c, x[1], 12, 0xe8c7b756);
+    REF_STEP(REF_F, c, d, a, b, x[2], 17, 0x242070db);
+    REF_STEP(REF_F, b, c, d, a, x[3], 22, 0xc1bdceee);
+    REF_STEP(REF_F, a, b, c, d, x[4], 7, 0xf57c0faf);
+    REF_STEP(REF_F, d, a, b, c, x[5], 12, 0x4787c62a);
+    REF_STEP(REF_F, c, d, a, b, x[6], 17, 0xa8304613);
+    REF_STEP(REF_F, b, c, d, a, x[7], 22, 0xfd469501);
+    REF_STEP(REF_F, a, b, c, d, x[8], 7, 0x698098d8);
+    REF_STEP(REF_F, d, a, b, c, x[9], 12, 0x8b44f7af);
+    REF_STEP(REF_F, c, d, a, b, x[10], 17, 0xffff5bb1);
+    REF_STEP(REF_F, b, c, d, a, x[11], 22, 0x895cd7be);
+    REF_STEP(REF_F, a, b, c, d, x[12], 7, 0x6b901122);
+    REF_STEP(REF_F, d, a, b, c, x[13], 12, 0xfd987193);
+    REF_STEP(REF_F, c, d, a, b, x[14], 17, 0xa679438e);
+    REF_STEP(REF_F, b, c, d, a, x[15], 22, 0x49b40821);
+
+    REF_STEP(REF_G, a, b, c, d, x[1], 5, 0xf61e2562);
+    REF_STEP(REF_G, d, a, b, c, x[6], 9, 0xc040b340);
+    REF_STEP(REF_G, c, d, a, b, x[11], 14, 0x265e5a51);
+    REF_STEP(REF_G, b, c, d, a, x[0], 20, 0xe9b6c7aa);
+    REF_STEP(REF_G, a, b, c, d, x[5], 5, 0xd62f105d);
+    REF_STEP(REF_G, d, a, b, c, x[10], 9, 0x02441453);
+    REF_STEP(REF_G, c, d, a, b, x[15], 14, 0xd8a1e681);
+    REF_STEP(REF_G, b, c, d, a, x[4], 20, 0xe7d3fbc8);
+    REF_STEP(REF_G, a, b, c, d, x[9], 5, 0x21e1cde6);
+    REF_STEP(REF_G, d, a, b, c, x[14], 9, 0xc33707d6);
+    REF_STEP(REF_G, c, d, a, b, x[3], 14, 0xf4d50d87);
+    REF_STEP(REF_G, b, c, d, a, x[8], 20, 0x455a14ed);
+    REF_STEP(REF_G, a, b, c, d, x[13], 5, 0xa9e3e905);
+    REF_STEP(REF_G, d, a, b, c, x[2], 9, 0xfcefa3f8);
+    REF_STEP(REF_G, c, d, a, b, x[7], 14, 0x676f02d9);
+    REF_STEP(REF_G, b, c, d, a, x[12], 20, 0x8d2a4c8a);
+
+    REF_STEP(REF_H, a, b, c, d, x[5], 4, 0xfffa3942);
+    REF_STEP(REF_H, d, a, b, c, x[8], 11, 0x8771f681);
+    REF_STEP(REF_H, c, d, a, b, x[11], 16, 0x6d9d6122);
+    REF_STEP(REF_H, b, c, d, a, x[14], 23, 0xfde5380c);
+    REF_STEP(REF_H, a, b, c, d, x[1], 4, 0xa4beea44);
+    REF_STEP(REF_H, d, a, b, c, x[4], 11, 0x4bdecfa9);
+    REF_STEP(REF_H, c, d, a, b, x[7], 16, 0xf6bb4b60);
+    REF_STEP(REF_H, b, c, d, a, x[10], 23, 0xbebfbc70);
+    REF_STEP(REF_H, a, b, c, d, x[13], 4, 0x289b7ec6);
+    REF_STEP(REF_H, d, a, b, c, x[0], 11, 0xeaa127fa);
+    REF_STEP(REF_H, c, d, a, b, x[3], 16, 0xd4ef3085);
+    REF_STEP(REF_H, b, c, d, a, x[6], 23, 0x04881d05);
+    REF_STEP(REF_H, a, b, c, d, x[9], 4, 0xd9d4d039);
+    REF_STEP(REF_H, d, a, b, c, x[12], 11, 0xe6db99e5);
+    REF_STEP(REF_H, c, d, a, b, x[15], 16, 0x1fa27cf8);
+    REF_STEP(REF_H, b, c, d, a, x[2], 23, 0xc4ac5665);
+
+    REF_STEP(REF_I, a, b, c, d, x[0], 6, 0xf4292244);
+    REF_STEP(REF_I, d, a, b, c, x[7], 10, 0x432aff97);
+    REF_STEP(REF_I, c, d, a, b, x[14], 15, 0xab9423a7);
+    REF_STEP(REF_I, b, c, d, a, x[5], 21, 0xfc93a039);
+    REF_STEP(REF_I, a, b, c, d, x[12], 6, 0x655b59c3);
+    REF_STEP(REF_I, d, a, b, c, x[3], 10, 0x8f0ccc92);
+    REF_STEP(REF_I, c, d, a, b, x[10], 15, 0xffeff47d);
+    REF_STEP(REF_I, b, c, d, a, x[1], 21, 0x85845dd1);
+    REF_STEP(REF_I, a, b, c, d, x[8], 6, 0x6fa87e4f);
+    REF_STEP(REF_I, d, a, b, c, x[15], 10, 0xfe2ce6e0);
+    REF_STEP(REF_I, c, d, a, b, x[6], 15, 0xa3014314);
+    REF_STEP(REF_I, b, c, d, a, x[13], 21, 0x4e0811a1);
+    REF_STEP(REF_I, a, b, c, d, x[4], 6, 0xf7537e82);
+    REF_STEP(REF_I, d, a, b, c, x[11], 10, 0xbd3af235);
+    REF_STEP(REF_I, c, d, a, b, x[2], 15, 0x2ad7d2bb);
+    REF_STEP(REF_I, b, c, d, a, x[9], 21, 0xeb86d391);
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+}
+
+static void ref_update(MD5_CTX *ctx, const uint8_t *data, size_t len) {
+    size_t i;
+    size_t index = (ctx->count[0] >> 3) & 0x3F;
+
+    if ((ctx->count[0] += (uint32_t)(len << 3)) < (len << 3)) {
+        ctx->count[1]++;
+    }
+    ctx->count[1] += (uint32_t)(len >> 29);
+
+    size_t partLen = 64 - index;
+    if (len >= partLen) {
+        memcpy(&ctx->buffer[index], data, partLen);
+        ref_transform(ctx, ctx->buffer);
+        for (i = partLen; i + 63 < len; i += 64) {
+            ref_transform(ctx, &data[i]);
+        }
+        index = 0;
+    } else {
+        i = 0;
+    }
+    memcpy(&ctx->buffer[index], &data[i], len - i);
+}
+
+static void ref_final(MD5_CTX *ctx, uint8_t digest[16]) {
+    uint8_t bits[8];
+
+    for (int i = 0; i < 8; i++) {
+        bits[i] = (uint8_t)((ctx->count[i >> 2] >> ((i & 3) << 3)) & 0xff);
+    }
+    size_t index = (ctx->count[0] >> 3) & 0x3f;
+    ref_update(ctx, ref_padding, (index < 56) ? (56 - index) : (120 - index));
+    ref_update(ctx, bits, 8);
+    for (int i = 0; i < 16; i++) {
+        digest[i] = (uint8_t)((ctx->state[i >> 2] >> ((i & 3) << 3)) & 0xff);
+    }
+}
+
+static void ref_to_string(const uint8_t digest[16], char *output) {
+    for (int i = 0; i < 16; i++) {
+        sprintf(output + i * 2, "%02x", digest[i]);
+    }
+    output[32] = '\0';
+}
+
+// ---------------------------------------------------------------------------
+
+static void hash_reference(const uint8_t *data, size_t length, uint8_t digest[16]) {
+    MD5_CTX ctx;
+    md5_init(&ctx);
+    ref_update(&ctx, data, length);
+    ref_final(&ctx, digest);
+}
+
+static void hash_tuned(const uint8_t *data, size_t length, uint8_t digest[16]) {
+    MD5_CTX ctx;
+    md5_init(&ctx);
+    md5_update(&ctx, data, length);
+    md5_final(&ctx, digest);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t now_cycles(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// RFC 1321 appendix A.5 test suite
+static int check_vectors(const char *name, hash_fn hash) {
+    static const char *const vectors[][2] = {
+        {"", "d41d8cd98f00b204e9800998ecf8427e"},
+        {"a", "0cc175b9c0f1b6a831c399e269772661"},
+        {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+        {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+        {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+        {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+         "d174ab98d277d9f5a5611c2c9f419d9f"},
+        {"12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+         "57edf4a22be3c955ac49da2e2107b67a"},
+    };
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        uint8_t digest[16];
+        char hex[33];
+        hash((const uint8_t *)vectors[i][0], strlen(vectors[i][0]), digest);
+        md5_to_string(digest, hex);
+        if (strcmp(hex, vectors[i][1]) != 0) {
+            fprintf(stderr, "FAIL %s: MD5(\"%s\") = %s, expected %s\n",
+                    name, vectors[i][0], hex, vectors[i][1]);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Feed misaligned data in uneven pieces and compare with the reference
+static int check_streaming(const uint8_t *data, size_t length) {
+    int failures = 0;
+    unsigned int seed = 1;
+
+    for (size_t offset = 0; offset < 8; offset++) {
+        size_t size = length - offset - (offset * 977) % 4096;
+        uint8_t expected[16];
+        uint8_t digest[16];
+        hash_reference(data + offset, size, expected);
+
+        MD5_CTX ctx;
+        md5_init(&ctx);
+        for (size_t done = 0; done < size; ) {
+            size_t piece = (size_t)(rand_r(&seed) % 300);
+            if (piece > size - done) piece = size - done;
+            md5_update(&ctx, data + offset + done, piece);
+            done += piece;
+        }
+        md5_final(&ctx, digest);
+        if (memcmp(digest, expected, sizeof(digest)) != 0) {
+            fprintf(stderr, "FAIL streaming: offset %zu, %zu bytes\n", offset, size);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Hash misaligned messages in every lane, some idle, over two calls per kernel
+// Every transform kernel the CPU supports must pass the same checks
+static int check_kernels(const uint8_t *data) {
+    int failures = 0;
+
+    for (size_t k = 0; k < sizeof(md5_kernels) / sizeof(md5_kernels[0]); k++) {
+        if (calc_md5_set_kernel(md5_kernels[k]) != 0) continue;
+        failures += check_vectors(calc_md5_kernel_name(md5_kernels[k]), hash_tuned) +
+                    check_streaming(data, 1024 * 1024);
+    }
+    calc_md5_set_kernel(CALC_MD5_AUTO);
+    return failures;
+}
+
+static int check_multi_buffer(const uint8_t *data) {
+    int failures = 0;
+
+    for (size_t k = 0; k < sizeof(mb_kernels) / sizeof(mb_kernels[0]); k++) {
+        if (md5_mb_set_kernel(mb_kernels[k]) != 0) continue;
+        int lanes = md5_mb_lanes();
+
+        for (size_t round = 0; round < 4; round++) {
+            MD5_CTX ctx[MD5_MB_MAX_LANES];
+            MD5_CTX *lane_ctx[MD5_MB_MAX_LANES];
+            const uint8_t *start[MD5_MB_MAX_LANES];
+            const uint8_t *input[MD5_MB_MAX_LANES];
+            size_t blocks = 1 + round * 37;
+
+            for (int i = 0; i < lanes; i++) {
+                md5_init(&ctx[i]);
+                lane_ctx[i] = (round == 1 && i % 3 == 1) ? NULL : &ctx[i];
+                start[i] = data + (size_t)i * 977 + round * 13;
+                input[i] = start[i];
+            }
+            md5_mb_update(lane_ctx, input, blocks);
+            for (int i = 0; i < lanes; i++) input[i] += blocks * 64;
+            md5_mb_update(lane_ctx, input, 3);
+
+            for (int i = 0; i < lanes; i++) {
+                if (!lane_ctx[i]) continue;
+                size_t tail = (size_t)i * 5 % 64;
+                uint8_t digest[16];
+                uint8_t expected[16];
+                md5_update(&ctx[i], input[i] + 3 * 64, tail);
+                md5_final(&ctx[i], digest);
+                hash_tuned(start[i], (blocks + 3) * 64 + tail, expected);
+                if (memcmp(digest, expected, sizeof(digest)) != 0) {
+                    fprintf(stderr, "FAIL multi-buffer %s: lane %d, round %zu\n",
+                            md5_mb_kernel_name(mb_kernels[k]), i, round);
+                    failures++;
+                }
+            }
+        }
+    }
+    md5_mb_set_kernel(MD5_MB_AUTO);
+    return failures;
+}
+
+// Known answers of the other algorithms, and streaming against one-shot
+// hashing for each of them (and each SHA-256 kernel)
+static int check_algorithms(const uint8_t *data) {
+    static const char *const vectors[][3] = {
+        {"xxh128", "", "99aa06d3014798d86001c324468d497f"},
+        {"xxh128", "abc", "06b05ab6733a618578af5f94892f3950"},
+        {"sha256", "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"sha256", "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"blake3", "", "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {"blake3", "abc", "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85"},
+    };
+    int failures = 0;
+
+    for (size_t k = 0; k < sizeof(sha256_kernels) / sizeof(sha256_kernels[0]); k++) {
+        if (sha256_set_kernel(sha256_kernels[k]) != 0) continue;
+        for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+            calc_hash_t algorithm;
+            calc_hash_ctx_t ctx;
+            uint8_t digest[CALC_HASH_MAX_DIGEST_SIZE];
+            char hex[CALC_HASH_HEX_SIZE];
+
+            calc_hash_from_name(vectors[i][0], &algorithm);
+            calc_hash_init(&ctx, algorithm);
+            calc_hash_update(&ctx, (const uint8_t *)vectors[i][1], strlen(vectors[i][1]));
+            calc_hash_to_string(digest, calc_hash_final(&ctx, digest), hex);
+            if (strcmp(hex, vectors[i][2]) != 0) {
+                fprintf(stderr, "FAIL %s (%s): \"%s\" = %s, expected %s\n", vectors[i][0],
+                        sha256_kernel_name(sha256_kernels[k]), vectors[i][1], hex, vectors[i][2]);
+                failures++;
+            }
+        }
+
+        for (int a = 0; a < CALC_HASH_COUNT; a++) {
+            static const size_t pieces[] = {1, 63, 64, 65, 255, 1000, 4096};
+            const size_t length = 200 * 1024 + 17;
+            calc_hash_ctx_t ctx;
+            uint8_t expected[CALC_HASH_MAX_DIGEST_SIZE];
+            uint8_t digest[CALC_HASH_MAX_DIGEST_SIZE];
+
+            calc_hash_init(&ctx, (calc_hash_t)a);
+            calc_hash_update(&ctx, data + 1, length);
+            size_t size = calc_hash_final(&ctx, expected);
+            for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+                calc_hash_init(&ctx, (calc_hash_t)a);
+                for (size_t offset = 0; offset < length; offset += pieces[p]) {
+                    size_t piece = length - offset < pieces[p] ? length - offset : pieces[p];
+                    calc_hash_update(&ctx, data + 1 + offset, piece);
+                }
+                calc_hash_final(&ctx, digest);
+                if (memcmp(digest, expected, size) != 0) {
+                    fprintf(stderr, "FAIL %s streaming: %zu-byte pieces\n",
+                            calc_hash_name((calc_hash_t)a), pieces[p]);
+                    failures++;
+                }
+            }
+        }
+
+        // A digest set must give every algorithm's digest of the same bytes
+        static const calc_hash_t all[] = {CALC_HASH_BLAKE3, CALC_HASH_MD5, CALC_HASH_SHA256,
+                                          CALC_HASH_XXH128};
+        const size_t length = 200 * 1024 + 17;
+        calc_hash_set_t set;
+        calc_hash_digests_t digests;
+        calc_hash_set_init(&set, all, CALC_HASH_COUNT);
+        for (size_t offset = 0; offset < length; offset += 50000) {
+            size_t piece = length - offset < 50000 ? length - offset : 50000;
+            calc_hash_set_update(&set, data + 3 + offset, piece);
+        }
+        calc_hash_set_final(&set, &digests);
+        for (int a = 0; a < CALC_HASH_COUNT; a++) {
+            calc_hash_ctx_t ctx;
+            uint8_t digest[CALC_HASH_MAX_DIGEST_SIZE];
+            char hex[CALC_HASH_HEX_SIZE];
+
+            calc_hash_init(&ctx, all[a]);
+            calc_hash_update(&ctx, data + 3, length);
+            calc_hash_to_string(digest, calc_hash_final(&ctx, digest), hex);
+            if (strcmp(hex, digests.hex[a]) != 0) {
+                fprintf(stderr, "FAIL %s in a digest set\n", calc_hash_name(all[a]));
+                failures++;
+            }
+        }
+    }
+    sha256_set_kernel(SHA256_AUTO);
+    return failures;
+}
+
+static void bench_hash(const char *name, hash_fn hash, const uint8_t *data, size_t size,
+                       uint64_t total, double *seconds_out) {
+    size_t messages = (size_t)(total / size);
+    uint8_t digest[16];
+    volatile uint8_t sink = 0;
+
+    if (messages == 0) messages = 1;
+    double start = now_seconds();
+    uint64_t cycles = now_cycles();
+    for (size_t i = 0; i < messages; i++) {
+        hash(data + (i & 7) * 64, size, digest);
+        sink ^= digest[0];
+    }
+    cycles = now_cycles() - cycles;
+    double seconds = now_seconds() - start;
+
+    double bytes = (double)messages * (double)size;
+    printf("  %-10s %9zu B %9.1f MB/s", name, size, bytes / seconds / (1024.0 * 1024.0));
+#ifdef HAVE_TSC
+    printf(" %7.2f cycles/byte", (double)cycles / bytes);
+#endif
+    printf("\n");
+    *seconds_out = seconds;
+}
+
+// Aggregate throughput of one core hashing a message of size bytes in every lane
+static void bench_multi_buffer(const uint8_t *data, size_t size, uint64_t total) {
+    for (size_t k = 0; k < sizeof(mb_kernels) / sizeof(mb_kernels[0]); k++) {
+        if (md5_mb_set_kernel(mb_kernels[k]) != 0) continue;
+        int lanes = md5_mb_lanes();
+        size_t rounds = (size_t)(total / (size * (size_t)lanes));
+        volatile uint8_t sink = 0;
+
+        if (rounds == 0) rounds = 1;
+        double start = now_seconds();
+        uint64_t cycles = now_cycles();
+        for (size_t r = 0; r < rounds; r++) {
+            MD5_CTX ctx[MD5_MB_MAX_LANES];
+            MD5_CTX *lane_ctx[MD5_MB_MAX_LANES];
+            const uint8_t *input[MD5_MB_MAX_LANES];
+            for (int i = 0; i < lanes; i++) {
+                md5_init(&ctx[i]);
+                lane_ctx[i] = &ctx[i];
+                input[i] = data + (size_t)(i & 7) * 64;
+            }
+            md5_mb_update(lane_ctx, input, size / 64);
+            for (int i = 0; i < lanes; i++) {
+                uint8_t digest[16];
+                md5_final(&ctx[i], digest);
+                sink ^= digest[0];
+            }
+        }
+        cycles = now_cycles() - cycles;
+        double seconds = now_seconds() - start;
+
+        double bytes = (double)rounds * (double)lanes * (double)size;
+        char name[32];
+        snprintf(name, sizeof(name), "%s x%d", md5_mb_kernel_name(mb_kernels[k]), lanes);
+        printf("  %-10s %9zu B %9.1f MB/s", name, size, bytes / seconds / (1024.0 * 1024.0));
+#ifdef HAVE_TSC
+        printf(" %7.2f cycles/byte", (double)cycles / bytes);
+#endif
+        printf("\n");
+    }
+    md5_mb_set_kernel(MD5_MB_AUTO);
+}
+
+// Throughput of each digest algorithm through the calc_hash interface
+static void bench_algorithm(const char *name, calc_hash_t algorithm, const uint8_t *data,
+                            size_t size, uint64_t total) {
+    size_t messages = (size_t)(total / size);
+    uint8_t digest[CALC_HASH_MAX_DIGEST_SIZE];
+    volatile uint8_t sink = 0;
+
+    if (messages == 0) messages = 1;
+    double start = now_seconds();
+    uint64_t cycles = now_cycles();
+    for (size_t i = 0; i < messages; i++) {
+        calc_hash_ctx_t ctx;
+        calc_hash_init(&ctx, algorithm);
+        calc_hash_update(&ctx, data + (i & 7) * 64, size);
+        calc_hash_final(&ctx, digest);
+        sink ^= digest[0];
+    }
+    cycles = now_cycles() - cycles;
+    double seconds = now_seconds() - start;
+
+    double bytes = (double)messages * (double)size;
+    printf("  %-10s %9zu B %9.1f MB/s", name, size, bytes / seconds / (1024.0 * 1024.0));
+#ifdef HAVE_TSC
+    printf(" %7.2f cycles/byte", (double)cycles / bytes);
+#endif
+    printf("\n");
+}
+
+// One pass of a digest set over a buffer larger than the cache, against one
+// pass per digest as separate scans would read it
+static void bench_hash_set(const calc_hash_t *hashes, int count, const uint8_t *data,
+                           size_t size, uint64_t total) {
+    size_t messages = (size_t)(total / size);
+    calc_hash_digests_t digests;
+    char names[64];
+
+    if (messages == 0) messages = 1;
+    double start = now_seconds();
+    for (size_t i = 0; i < messages; i++) {
+        calc_hash_set_t set;
+        calc_hash_set_init(&set, hashes, count);
+        calc_hash_set_update(&set, data, size);
+        calc_hash_set_final(&set, &digests);
+    }
+    double together = now_seconds() - start;
+
+    start = now_seconds();
+    for (size_t i = 0; i < messages; i++) {
+        for (int h = 0; h < count; h++) {
+            calc_hash_set_t set;
+            calc_hash_set_init(&set, &hashes[h], 1);
+            calc_hash_set_update(&set, data, size);
+            calc_hash_set_final(&set, &digests);
+        }
+    }
+    double separate = now_seconds() - start;
+
+    double bytes = (double)messages * (double)size;
+    calc_hash_format_list(hashes, count, names, sizeof(names));
+    printf("  %-28s one pass %8.1f MB/s, a pass each %8.1f MB/s (%.2fx)\n", names,
+           bytes / together / (1024.0 * 1024.0), bytes / separate / (1024.0 * 1024.0),
+           separate / together);
+}
+
+static void bench_hex(void) {
+    uint8_t digest[16];
+    char hex[33];
+    volatile char sink = 0;
+
+    for (int i = 0; i < 16; i++) digest[i] = (uint8_t)(i * 37 + 11);
+
+    double start = now_seconds();
+    for (int i = 0; i < HEX_DIGESTS; i++) {
+        digest[0] = (uint8_t)i;
+        ref_to_string(digest, hex);
+        sink ^= hex[1];
+    }
+    double reference = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < HEX_DIGESTS; i++) {
+        digest[0] = (uint8_t)i;
+        md5_to_string(digest, hex);
+        sink ^= hex[1];
+    }
+    double tuned = now_seconds() - start;
+
+    printf("Hex encoding: sprintf %.1f ns, table %.1f ns per digest (%.1fx)\n",
+           reference * 1e9 / HEX_DIGESTS, tuned * 1e9 / HEX_DIGESTS, reference / tuned);
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t sizes[] = {64, 1024, 64 * 1024, 16 * 1024 * 1024};
+    uint64_t total = DEFAULT_BENCH_BYTES;
+
+    if (argc > 1) {
+        char *end = NULL;
+        unsigned long long megabytes = strtoull(argv[1], &end, 10);
+        if (!end || *end != '\0' || megabytes == 0) {
+            fprintf(stderr, "Usage: %s [megabytes per run]\n", argv[0]);
+            return 1;
+        }
+        total = megabytes * 1024 * 1024;
+    }
+
+    size_t length = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1] + 8 * 64;
+    uint8_t *data = malloc(length);
+    if (!data) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    unsigned int seed = 42;
+    for (size_t i = 0; i < length; i++) data[i] = (uint8_t)rand_r(&seed);
+
+    int failures = check_vectors("reference", hash_reference) + check_kernels(data) +
+                   check_multi_buffer(data) + check_algorithms(data);
+    if (failures > 0) {
+        fprintf(stderr, "%d hash check%s failed\n", failures, failures == 1 ? "" : "s");
+        free(data);
+        return 1;
+    }
+    printf("RFC 1321 test vectors, streaming, multi-buffer, algorithm and digest set checks passed\n");
+
+    printf("MD5 throughput (%llu MB per run, %s kernel):\n", (unsigned long long)(total >> 20),
+           calc_md5_kernel_name(calc_md5_kernel()));
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        double reference;
+        double tuned;
+        bench_hash("reference", hash_reference, data, sizes[i], total, &reference);
+        bench_hash("tuned", hash_tuned, data, sizes[i], total, &tuned);
+        printf("  %-10s %9zu B %9.2fx\n", "speedup", sizes[i], reference / tuned);
+    }
+    printf("Transform kernels:\n");
+    for (size_t k = 0; k < sizeof(md5_kernels) / sizeof(md5_kernels[0]); k++) {
+        if (calc_md5_set_kernel(md5_kernels[k]) != 0) continue;
+        double seconds;
+        bench_hash(calc_md5_kernel_name(md5_kernels[k]), hash_tuned, data, 64 * 1024, total, &seconds);
+    }
+    calc_md5_set_kernel(CALC_MD5_AUTO);
+    printf("Multi-buffer MD5, one core, every lane busy:\n");
+    for (size_t i = 1; i < sizeof(sizes) / sizeof(sizes[0]) - 1; i++) {
+        bench_multi_buffer(data, sizes[i], total);
+    }
+    printf("Hash algorithms (%s SHA-256):\n", sha256_kernel_name(sha256_kernel()));
+    for (size_t i = 2; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (int a = 0; a < CALC_HASH_COUNT; a++) {
+            bench_algorithm(calc_hash_name((calc_hash_t)a), (calc_hash_t)a, data, sizes[i], total);
+        }
+    }
+    printf("SHA-256 kernels:\n");
+    for (size_t k = 0; k < sizeof(sha256_kernels) / sizeof(sha256_kernels[0]); k++) {
+        if (sha256_set_kernel(sha256_kernels[k]) != 0) continue;
+        bench_algorithm(sha256_kernel_name(sha256_kernels[k]), CALC_HASH_SHA256, data,
+                        64 * 1024, total);
+    }
+    sha256_set_kernel(SHA256_AUTO);
+    printf("Digest sets, %zu MB files:\n", sizes[sizeof(sizes) / sizeof(sizes[0]) - 1] >> 20);
+    {
+        static const calc_hash_t md5_sha256[] = {CALC_HASH_MD5, CALC_HASH_SHA256};
+        static const calc_hash_t all[] = {CALC_HASH_MD5, CALC_HASH_XXH128, CALC_HASH_SHA256,
+                                          CALC_HASH_BLAKE3};
+        size_t size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+        bench_hash_set(md5_sha256, 2, data, size, total);
+        bench_hash_set(all, CALC_HASH_COUNT, data, size, total);
+    }
+    bench_hex();
+
+    free(data);
+    return 0;
+}
@@ -1,14 +1,19 @@
 #include <gtk/gtk.h>
-#include "../lib/cJSON/cJSON.h"
+#include "../lib/json_map/json_map.h"
+#include "../lib/scan_bin/scan_bin.h"
+#include "../lib/calc_md5/calc_md5.h"
 #include <stdio.h>
 #include <string.h>
 #include <glib.h>
 
+// 各字段是映射文件中的视图（偏移+长度），加载时不复制字符串；长度为0表示空
 typedef struct {
-    char *md5;
-    char *file1_path;
-    char *file2_path;
-    char *status;
+    json_view_t digest;
+    json_view_t file2_digest; // 按路径对比时file2一侧的摘要（仅modified记录）
+    json_view_t file1_path;
+    json_view_t file2_path;
+    json_view_t status;
+    gboolean paired;        // 来自单条格式记录
 } DiffEntry;
 
 typedef struct {
@@ -19,24 +24,34 @@ typedef struct {
     GtkListStore *file1_store;
     GtkListStore *file2_store;
     GArray *diff_entries;
-    GHashTable *unique_entries; // 用于去重
+    json_map_t *map;        // 当前打开的diff文件，DiffEntry的视图指向其中
+    scan_bin_t *scan;       // 当前打开的二进制扫描文件（与map互斥）
+    GHashTable *unique_entries; // 用于旧版单条格式记录去重
 } AppData;
 
 enum {
     COL_FILENAME = 0,
-    COL_MD5,
+    COL_DIGEST,
     COL_STATUS,
     N_COLUMNS
 };
 
-// 释放DiffEntry
-static void free_diff_entry(DiffEntry *entry) {
-    if (entry) {
-        g_free(entry->md5);
-        g_free(entry->file1_path);
-        g_free(entry->file2_path);
-        g_free(entry->status);
-    }
+static const json_view_t empty_view = {0, 0, 0};
+
+// 将视图解码为以NUL结尾的字符串，结果存放在scratch中
+static const char *view_text(const AppData *app_data, const json_view_t *view, GString *scratch) {
+    g_string_set_size(scratch, view->length);
+    g_string_truncate(scratch, json_map_decode(app_data->map, view, scratch->str));
+    return scratch->str;
+}
+
+// 关闭当前文件并清空记录
+static void clear_diff_entries(AppData *app_data) {
+    g_array_set_size(app_data->diff_entries, 0);
+    json_map_close(app_data->map);
+    app_data->map = NULL;
+    scan_bin_close(app_data->scan);
+    app_data->scan = NULL;
 }
 
 // 创建文件树视图
@@ -58,9 +73,9 @@ static GtkWidget *create_file_tree(GtkListStore **store) {
     gtk_tree_view_column_set_sort_column_id(column, COL_FILENAME);
     gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
     
-    // MD5列
+    // 摘要列
     renderer = gtk_cell_renderer_text_new();
-    column = gtk_tree_view_column_new_with_attributes("MD5", renderer, "text", COL_MD5, NULL);
+    column = gtk_tree_view_column_new_with_attributes("摘要", renderer, "text", COL_DIGEST, NULL);
     gtk_tree_view_column_set_resizable(column, TRUE);
     gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), column);
     
@@ -73,147 +88,248 @@ static GtkWidget *create_file_tree(GtkListStore **store) {
     return tree_view;
 }
 
-// 解析JSON文件
-static gboolean parse_diff_json(const char *filename, AppData *app_data) {
-    FILE *file;
-    char *buffer;
-    long file_size;
-    cJSON *root, *diff_array, *entry_obj;
-    cJSON *md5_obj, *file1_obj, *file2_obj, *status_obj;
-    int array_len;
-
-    // 读取文件
-    file = fopen(filename, "r");
-    if (!file) {
-        g_warning("无法打开文件: %s", filename);
-        return FALSE;
+// 追加一条记录
+static void append_entry(AppData *app_data, const json_view_t *digest,
+                         const json_view_t *file2_digest, const json_view_t *file1_path,
+                         const json_view_t *file2_path, const json_view_t *status,
+                         gboolean paired) {
+    DiffEntry entry;
+    entry.digest = *digest;
+    entry.file2_digest = file2_digest ? *file2_digest : empty_view;
+    entry.file1_path = *file1_path;
+    entry.file2_path = *file2_path;
+    entry.status = *status;
+    entry.paired = paired;
+    g_array_append_val(app_data->diff_entries, entry);
+}
+
+// 展开分组记录的路径数组，每个路径在对应一侧显示为一行
+static void append_grouped_paths(AppData *app_data, const json_map_record_t *record,
+                                 const json_member_t *digest, const json_member_t *paths,
+                                 gboolean file1_side, const json_member_t *status) {
+    if (!paths || paths->kind != JSON_MAP_ARRAY) {
+        return;
+    }
+    for (size_t i = 0; i < paths->count; i++) {
+        const json_view_t *path = &record->elements[paths->first + i];
+        append_entry(app_data, &digest->value, NULL,
+                     file1_side ? path : &empty_view, file1_side ? &empty_view : path,
+                     &status->value, FALSE);
     }
+}
+
+// 解码视图为新分配的字符串
+static char *view_dup(const json_map_t *map, const json_view_t *view) {
+    char *text = g_malloc(view->length + 1);
+    json_map_decode(map, view, text);
+    return text;
+}
+
+static gboolean is_string_member(const json_member_t *member) {
+    return member && member->kind == JSON_MAP_STRING;
+}
 
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    buffer = g_malloc(file_size + 1);
-    fread(buffer, 1, file_size, file);
-    buffer[file_size] = '\0';
-    fclose(file);
-
-    // 解析JSON
-    root = cJSON_Parse(buffer);
-    if (!root) {
-        const char *error_ptr = cJSON_GetErrorPtr();
-        if (error_ptr != NULL) {
-            g_warning("JSON解析失败，错误位置: %s", error_ptr);
-        } else {
-            g_warning("JSON解析失败");
+// 摘要字段以算法命名（md5、sha256等），按路径对比的file2一侧带file2_前缀
+static const json_member_t *digest_member(const json_map_t *map, const json_map_record_t *record,
+                                          const char *prefix) {
+    char name[32];
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        g_snprintf(name, sizeof(name), "%s%s", prefix, calc_hash_name((calc_hash_t)i));
+        const json_member_t *member = json_map_member(map, record, name);
+        if (member) {
+            return member;
         }
-        g_free(buffer);
-        return FALSE;
     }
-    g_free(buffer);
+    return NULL;
+}
 
-    diff_array = cJSON_GetObjectItem(root, "files");
-    if (!diff_array) {
-        g_warning("找不到files对象");
-        cJSON_Delete(root);
-        return FALSE;
+// 每条记录的回调：只记录视图，不复制字符串
+static int append_diff_record(const json_map_t *map, const json_map_record_t *record,
+                              void *user_data) {
+    AppData *app_data = (AppData *)user_data;
+    const json_member_t *digest = digest_member(map, record, "");
+    const json_member_t *status = json_map_member(map, record, "status");
+    const json_member_t *file1 = json_map_member(map, record, "file1_path");
+    const json_member_t *file2 = json_map_member(map, record, "file2_path");
+    const json_member_t *file2_digest = digest_member(map, record, "file2_");
+    const json_member_t *file1_paths = json_map_member(map, record, "file1_paths");
+    const json_member_t *file2_paths = json_map_member(map, record, "file2_paths");
+
+    if (!is_string_member(digest) || !is_string_member(status)) {
+        return 0;
     }
-    
-    if (!cJSON_IsArray(diff_array)) {
-        g_warning("files不是数组类型");
-        cJSON_Delete(root);
-        return FALSE;
+
+    if ((file1_paths && file1_paths->kind == JSON_MAP_ARRAY) ||
+        (file2_paths && file2_paths->kind == JSON_MAP_ARRAY)) {
+        // 分组格式：每个摘要一条记录，两侧各列出全部路径
+        append_grouped_paths(app_data, record, digest, file1_paths, TRUE, status);
+        append_grouped_paths(app_data, record, digest, file2_paths, FALSE, status);
+    } else if (is_string_member(file1) && is_string_member(file2)) {
+        // 单条格式：每条记录对应一对路径，旧版输出的重复记录在加载后去除
+        append_entry(app_data, &digest->value,
+                     is_string_member(file2_digest) ? &file2_digest->value : NULL,
+                     &file1->value, &file2->value, &status->value, TRUE);
     }
+    return 0;
+}
 
-    array_len = cJSON_GetArraySize(diff_array);
-    
-    for (int i = 0; i < (int)array_len; i++) {
-        entry_obj = cJSON_GetArrayItem(diff_array, i);
-        
-        md5_obj = cJSON_GetObjectItem(entry_obj, "md5");
-        file1_obj = cJSON_GetObjectItem(entry_obj, "file1_path");
-        file2_obj = cJSON_GetObjectItem(entry_obj, "file2_path");
-        status_obj = cJSON_GetObjectItem(entry_obj, "status");
-        
-        if (md5_obj && file1_obj && file2_obj && status_obj &&
-            cJSON_IsString(md5_obj) && cJSON_IsString(file1_obj) && 
-            cJSON_IsString(file2_obj) && cJSON_IsString(status_obj)) {
-            
-            const char *md5 = cJSON_GetStringValue(md5_obj);
-            const char *file1_path = cJSON_GetStringValue(file1_obj);
-            const char *file2_path = cJSON_GetStringValue(file2_obj);
-            const char *status = cJSON_GetStringValue(status_obj);
-
-            // 创建唯一键用于去重 (md5 + file1_path + file2_path)
-            char *unique_key = g_strdup_printf("%s|%s|%s", md5, file1_path, file2_path);
-            
-            // 检查是否已存在
-            if (!g_hash_table_contains(app_data->unique_entries, unique_key)) {
-                DiffEntry entry;
-                entry.md5 = g_strdup(md5);
-                entry.file1_path = g_strdup(file1_path);
-                entry.file2_path = g_strdup(file2_path);
-                entry.status = g_strdup(status);
-                
-                g_array_append_val(app_data->diff_entries, entry);
-                g_hash_table_insert(app_data->unique_entries, unique_key, GINT_TO_POINTER(1));
-            } else {
+// 旧版单条格式的结果中同一对路径可能重复出现，按(摘要 + file1_path + file2_path)
+// 去重；comparison_info带join字段的新版输出不会重复，不调用这一步
+static void dedup_pair_entries(AppData *app_data, const json_map_t *map) {
+    GArray *entries = app_data->diff_entries;
+    guint kept = 0;
+
+    for (guint i = 0; i < entries->len; i++) {
+        DiffEntry *entry = &g_array_index(entries, DiffEntry, i);
+        if (entry->paired) {
+            char *digest_text = view_dup(map, &entry->digest);
+            char *file1_text = view_dup(map, &entry->file1_path);
+            char *file2_text = view_dup(map, &entry->file2_path);
+            char *unique_key = g_strdup_printf("%s|%s|%s", digest_text, file1_text, file2_text);
+            g_free(digest_text);
+            g_free(file1_text);
+            g_free(file2_text);
+
+            if (g_hash_table_contains(app_data->unique_entries, unique_key)) {
                 g_free(unique_key);
+                continue;
             }
+            g_hash_table_insert(app_data->unique_entries, unique_key, GINT_TO_POINTER(1));
+        }
+        g_array_index(entries, DiffEntry, kept++) = *entry;
+    }
+    g_array_set_size(entries, kept);
+    g_hash_table_remove_all(app_data->unique_entries);
+}
+
+// 以mmap方式加载JSON文件，记录以视图形式指向映射区域；二进制扫描文件直接映射，显示时逐条解码
+static gboolean parse_diff_json(const char *filename, AppData *app_data) {
+    json_map_t *map;
+
+    clear_diff_entries(app_data);
+
+    if (scan_bin_probe(filename)) {
+        app_data->scan = scan_bin_open(filename);
+        if (!app_data->scan) {
+            g_warning("无法打开二进制扫描文件: %s", filename);
+            return FALSE;
         }
+        return TRUE;
     }
 
-    cJSON_Delete(root);
+    map = json_map_open(filename);
+    if (!map) {
+        g_warning("无法打开文件: %s", filename);
+        return FALSE;
+    }
+
+    if (json_map_records(map, append_diff_record, app_data) != 0) {
+        g_warning("JSON解析失败: %s", filename);
+        g_array_set_size(app_data->diff_entries, 0);
+        json_map_close(map);
+        return FALSE;
+    }
+
+    // comparison_info可能位于记录之后，遍历结束后再判断
+    if (!json_map_info_member(map, "join")) {
+        dedup_pair_entries(app_data, map);
+    }
+
+    app_data->map = map;
     return TRUE;
 }
 
+// 二进制扫描的显示状态
+typedef struct {
+    GtkListStore *store;
+    const char *search_text;
+} ScanFilter;
+
+// 每条扫描记录的回调：按搜索条件加入file1树
+static int append_scan_entry(const scan_bin_entry_t *entry, void *user_data) {
+    ScanFilter *filter = (ScanFilter *)user_data;
+    GtkTreeIter iter;
+    char hex[2 * SCAN_BIN_DIGEST_SIZE + 1];
+
+    if (filter->search_text && strlen(filter->search_text) > 0 &&
+        !strstr(entry->path, filter->search_text)) {
+        return 0;
+    }
+    for (int i = 0; i < SCAN_BIN_DIGEST_SIZE; i++) {
+        g_snprintf(hex + 2 * i, 3, "%02x", entry->digest[i]);
+    }
+    gtk_list_store_append(filter->store, &iter);
+    gtk_list_store_set(filter->store, &iter,
+        COL_FILENAME, entry->path,
+        COL_DIGEST, hex,
+        COL_STATUS, "scanned",
+        -1);
+    return 0;
+}
+
+// 已加载的记录数
+static guint record_count(const AppData *app_data) {
+    return app_data->scan ? (guint)scan_bin_count(app_data->scan) : app_data->diff_entries->len;
+}
+
 // 更新文件树显示
 static void update_file_trees(AppData *app_data, const char *search_text) {
     GtkTreeIter iter;
+    GString *path;
+    GString *digest;
+    GString *status;
     
     // 清空现有数据
     gtk_list_store_clear(app_data->file1_store);
     gtk_list_store_clear(app_data->file2_store);
     
+    // 二进制扫描文件只有一侧，全部列在file1树中
+    if (app_data->scan) {
+        ScanFilter filter = {app_data->file1_store, search_text};
+        if (scan_bin_read(app_data->scan, append_scan_entry, &filter) != 0) {
+            g_warning("二进制扫描文件已损坏");
+        }
+        return;
+    }
+    
+    path = g_string_new(NULL);
+    digest = g_string_new(NULL);
+    status = g_string_new(NULL);
+    
     for (int i = 0; i < (int)app_data->diff_entries->len; i++) {
         DiffEntry *entry = &g_array_index(app_data->diff_entries, DiffEntry, i);
         
-        // 搜索过滤
-        gboolean show_file1 = TRUE, show_file2 = TRUE;
-        if (search_text && strlen(search_text) > 0) {
-            if (strlen(entry->file1_path) > 0) {
-                show_file1 = (strstr(entry->file1_path, search_text) != NULL);
-            } else {
-                show_file1 = FALSE;
+        // 添加到file1树（按需解码，列表存储会复制字符串）
+        if (entry->file1_path.length > 0) {
+            view_text(app_data, &entry->file1_path, path);
+            if (!search_text || strlen(search_text) == 0 || strstr(path->str, search_text)) {
+                gtk_list_store_append(app_data->file1_store, &iter);
+                gtk_list_store_set(app_data->file1_store, &iter,
+                    COL_FILENAME, path->str,
+                    COL_DIGEST, view_text(app_data, &entry->digest, digest),
+                    COL_STATUS, view_text(app_data, &entry->status, status),
+                    -1);
             }
-            
-            if (strlen(entry->file2_path) > 0) {
-                show_file2 = (strstr(entry->file2_path, search_text) != NULL);
-            } else {
-                show_file2 = FALSE;
-            }
-        }
-        
-        // 添加到file1树
-        if (strlen(entry->file1_path) > 0 && show_file1) {
-            gtk_list_store_append(app_data->file1_store, &iter);
-            gtk_list_store_set(app_data->file1_store, &iter,
-                COL_FILENAME, entry->file1_path,
-                COL_MD5, entry->md5,
-                COL_STATUS, entry->status,
-                -1);
         }
         
         // 添加到file2树
-        if (strlen(entry->file2_path) > 0 && show_file2) {
-            gtk_list_store_append(app_data->file2_store, &iter);
-            gtk_list_store_set(app_data->file2_store, &iter,
-                COL_FILENAME, entry->file2_path,
-                COL_MD5, entry->md5,
-                COL_STATUS, entry->status,
-                -1);
+        if (entry->file2_path.length > 0) {
+            view_text(app_data, &entry->file2_path, path);
+            if (!search_text || strlen(search_text) == 0 || strstr(path->str, search_text)) {
+                gtk_list_store_append(app_data->file2_store, &iter);
+                gtk_list_store_set(app_data->file2_store, &iter,
+                    COL_FILENAME, path->str,
+                    COL_DIGEST, view_text(app_data, entry->file2_digest.length > 0 ?
+                                       &entry->file2_digest : &entry->digest, digest),
+                    COL_STATUS, view_text(app_data, &entry->status, status),
+                    -1);
+            }
         }
     }
+    
+    g_string_free(path, TRUE);
+    g_string_free(digest, TRUE);
+    g_string_free(status, TRUE);
 }
 
 // 搜索回调函数
@@ -240,25 +356,18 @@ static void on_open_file(GtkWidget *widget, gpointer user_data) {
     
     // 添加文件过滤器
     filter = gtk_file_filter_new();
-    gtk_file_filter_set_name(filter, "JSON files");
+    gtk_file_filter_set_name(filter, "JSON/binary scan files");
     gtk_file_filter_add_pattern(filter, "*.json");
+    gtk_file_filter_add_pattern(filter, "*.bin");
     gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
     
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
         
-        // 清空现有数据
-        for (int i = 0; i < (int)app_data->diff_entries->len; i++) {
-            DiffEntry *entry = &g_array_index(app_data->diff_entries, DiffEntry, i);
-            free_diff_entry(entry);
-        }
-        g_array_set_size(app_data->diff_entries, 0);
-        g_hash_table_remove_all(app_data->unique_entries);
-        
-        // 解析新文件
+        // 解析新文件（会先关闭当前文件）
         if (parse_diff_json(filename, app_data)) {
             update_file_trees(app_data, NULL);
-            g_print("成功加载文件: %s (去重后共%d条记录)\n", filename, app_data->diff_entries->len);
+            g_print("成功加载文件: %s (共%u条记录)\n", filename, record_count(app_data));
         }
         
         g_free(filename);
@@ -325,11 +434,8 @@ static GtkWidget *create_menubar(AppData *app_data) {
 
 // 程序退出时的清理
 static void cleanup_app_data(AppData *app_data) {
-    // 释放diff_entries数组
-    for (int i = 0; i < (int)app_data->diff_entries->len; i++) {
-        DiffEntry *entry = &g_array_index(app_data->diff_entries, DiffEntry, i);
-        free_diff_entry(entry);
-    }
+    // 关闭映射文件并释放diff_entries数组
+    clear_diff_entries(app_data);
     g_array_free(app_data->diff_entries, TRUE);
     
     // 释放哈希表
@@ -414,7 +520,7 @@ int main(int argc, char *argv[]) {
     if (argc > 1) {
         if (parse_diff_json(argv[1], &app_data)) {
             update_file_trees(&app_data, NULL);
-            g_print("成功加载文件: %s (去重后共%d条记录)\n", argv[1], app_data.diff_entries->len);
+            g_print("成功加载文件: %s (共%u条记录)\n", argv[1], record_count(&app_data));
         }
     }
     
@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+#include "blake3.h"
+#include <string.h>
+
+// Domain separation flags
+#define CHUNK_START (1 << 0)
+#define CHUNK_END (1 << 1)
+#define PARENT (1 << 2)
+#define ROOT (1 << 3)
+
+static const uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// Message word order of each of the seven rounds
+static const uint8_t SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t load_le32(const uint8_t *bytes) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+#else
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+#endif
+}
+
+static inline void store_le32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define G(a, b, c, d, x, y) { \
+    v[a] += v[b] + (x); v[d] = ROTR(v[d] ^ v[a], 16); \
+    v[c] += v[d];       v[b] = ROTR(v[b] ^ v[c], 12); \
+    v[a] += v[b] + (y); v[d] = ROTR(v[d] ^ v[a], 8);  \
+    v[c] += v[d];       v[b] = ROTR(v[b] ^ v[c], 7);  \
+}
+
+// Compress one block into the chaining value cv (first half of the output)
+static void compress(uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_length,
+                     uint64_t counter, uint8_t flags) {
+    uint32_t m[16];
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        (uint32_t)counter, (uint32_t)(counter >> 32), block_length, flags
+    };
+
+    for (int i = 0; i < 16; i++) {
+        m[i] = load_le32(block + i * 4);
+    }
+    for (int r = 0; r < 7; r++) {
+        const uint8_t *s = SCHEDULE[r];
+        G(0, 4, 8, 12, m[s[0]], m[s[1]]);
+        G(1, 5, 9, 13, m[s[2]], m[s[3]]);
+        G(2, 6, 10, 14, m[s[4]], m[s[5]]);
+        G(3, 7, 11, 15, m[s[6]], m[s[7]]);
+        G(0, 5, 10, 15, m[s[8]], m[s[9]]);
+        G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(2, 7, 8, 13, m[s[12]], m[s[13]]);
+        G(3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) {
+        cv[i] = v[i] ^ v[i + 8];
+    }
+}
+
+// Chaining value of the parent node over two children
+static void parent_cv(const uint32_t left[8], const uint32_t right[8], uint8_t flags,
+                      uint32_t out[8]) {
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    for (int i = 0; i < 8; i++) {
+        store_le32(block + i * 4, left[i]);
+        store_le32(block + 32 + i * 4, right[i]);
+    }
+    memcpy(out, IV, sizeof(IV));
+    compress(out, block, BLAKE3_BLOCK_LEN, 0, PARENT | flags);
+}
+
+static uint8_t chunk_start_flag(const blake3_hasher_t *hasher) {
+    return hasher->blocks_compressed == 0 ? CHUNK_START : 0;
+}
+
+// Push the chaining value of a finished chunk, merging completed subtrees:
+// after total_chunks chunks the stack holds one subtree per set bit
+static void push_chunk_cv(blake3_hasher_t *hasher, uint32_t cv[8], uint64_t total_chunks) {
+    while ((total_chunks & 1) == 0) {
+        hasher->stack_length--;
+        parent_cv(hasher->stack[hasher->stack_length], cv, 0, cv);
+        total_chunks >>= 1;
+    }
+    memcpy(hasher->stack[hasher->stack_length++], cv, 8 * sizeof(uint32_t));
+}
+
+void blake3_init(blake3_hasher_t *hasher) {
+    memcpy(hasher->cv, IV, sizeof(IV));
+    hasher->chunk_counter = 0;
+    hasher->block_length = 0;
+    hasher->blocks_compressed = 0;
+    hasher->stack_length = 0;
+}
+
+void blake3_update(blake3_hasher_t *hasher, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        // A full chunk is only closed once more input follows, since the
+        // last chunk of the input is finalized differently
+        if (hasher->blocks_compressed * BLAKE3_BLOCK_LEN + hasher->block_length == BLAKE3_CHUNK_LEN) {
+            compress(hasher->cv, hasher->block, BLAKE3_BLOCK_LEN, hasher->chunk_counter,
+                     chunk_start_flag(hasher) | CHUNK_END);
+            push_chunk_cv(hasher, hasher->cv, ++hasher->chunk_counter);
+            memcpy(hasher->cv, IV, sizeof(IV));
+            hasher->block_length = 0;
+            hasher->blocks_compressed = 0;
+        }
+
+        // Likewise a full block is compressed only when more input follows
+        if (hasher->block_length == BLAKE3_BLOCK_LEN) {
+            compress(hasher->cv, hasher->block, BLAKE3_BLOCK_LEN, hasher->chunk_counter,
+                     chunk_start_flag(hasher));
+            hasher->blocks_compressed++;
+            hasher->block_length = 0;
+        }
+
+        // Whole blocks in the middle of a chunk are compressed in place
+        while (hasher->block_length == 0 && len > BLAKE3_BLOCK_LEN &&
+               hasher->blocks_compressed < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1) {
+            compress(hasher->cv, data, BLAKE3_BLOCK_LEN, hasher->chunk_counter,
+                     chunk_start_flag(hasher));
+            hasher->blocks_compressed++;
+            data += BLAKE3_BLOCK_LEN;
+            len -= BLAKE3_BLOCK_LEN;
+        }
+
+        size_t take = BLAKE3_BLOCK_LEN - hasher->block_length;
+        if (take > len) take = len;
+        memcpy(hasher->block + hasher->block_length, data, take);
+        hasher->block_length += (uint8_t)take;
+        data += take;
+        len -= take;
+    }
+}
+
+void blake3_final(const blake3_hasher_t *hasher, uint8_t digest[BLAKE3_DIGEST_SIZE]) {
+    uint8_t block[BLAKE3_BLOCK_LEN] = {0};
+    uint32_t cv[8];
+    uint8_t flags = chunk_start_flag(hasher) | CHUNK_END;
+
+    // The last chunk is the root when it is the only one; otherwise it is
+    // folded into the stacked subtrees from right to left, the last parent
+    // being the root
+    memcpy(block, hasher->block, hasher->block_length);
+    memcpy(cv, hasher->cv, sizeof(cv));
+    if (hasher->stack_length == 0) {
+        compress(cv, block, hasher->block_length, hasher->chunk_counter, flags | ROOT);
+    } else {
+        compress(cv, block, hasher->block_length, hasher->chunk_counter, flags);
+        for (int i = hasher->stack_length - 1; i >= 0; i--) {
+            parent_cv(hasher->stack[i], cv, i == 0 ? ROOT : 0, cv);
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        store_le32(digest + i * 4, cv[i]);
+    }
+}
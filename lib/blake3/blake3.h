@@ -0,0 +1,35 @@
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLAKE3_DIGEST_SIZE 32
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_LEN 1024
+// Enough chaining values for 2^54 chunks, more than a 64-bit length can hold
+#define BLAKE3_MAX_DEPTH 54
+
+// Incremental BLAKE3 hasher (unkeyed hash mode)
+typedef struct {
+    uint32_t cv[8];             // Chaining value of the current chunk
+    uint64_t chunk_counter;
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint8_t block_length;
+    uint8_t blocks_compressed;
+    uint8_t stack_length;
+    uint32_t stack[BLAKE3_MAX_DEPTH][8];  // Chaining values of completed subtrees
+} blake3_hasher_t;
+
+void blake3_init(blake3_hasher_t *hasher);
+void blake3_update(blake3_hasher_t *hasher, const uint8_t *data, size_t len);
+
+/**
+ * Finish a BLAKE3 hash with the default 32-byte output
+ *
+ * @param hasher Hasher, unchanged by the call
+ * @param digest Output digest
+ */
+void blake3_final(const blake3_hasher_t *hasher, uint8_t digest[BLAKE3_DIGEST_SIZE]);
+
+#endif // BLAKE3_H
@@ -1,11 +1,26 @@
+#define _GNU_SOURCE
 #include "calc_md5.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-
-// MD5 constants
-#define F(x, y, z) (((x) & (y)) | ((~x) & (z)))
-#define G(x, y, z) (((x) & (z)) | ((y) & (~z)))
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CALC_MD5_X86 1
+#endif
+
+// MD5 constants; F and G are rewritten to shorten the dependency on x:
+// F selects with one AND between two XORs, and the two terms of G never
+// share a bit, so they can be added and the half without x computed early
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((y) & ~(z)) + ((x) & (z)))
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
@@ -35,102 +50,196 @@
     (a) += (b); \
 }
 
-// MD5 padding
-static uint8_t PADDING[64] = {
-    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+static calc_md5_options_t hash_options = {
+    CALC_MD5_DEFAULT_MMAP_THRESHOLD,
+    CALC_MD5_DEFAULT_MMAP_WINDOW,
+    0,
+    0,
+    {CALC_HASH_MD5},
+    1,
+    0
 };
 
-static void md5_transform(MD5_CTX *ctx, const uint8_t block[64]) {
-    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
-    uint32_t x[16];
-    int i;
-
-    for (i = 0; i < 16; i++) {
-        x[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
-               ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
-    }
-
-    // Round 1
-    FF(a, b, c, d, x[0], 7, 0xd76aa478);
-    FF(d, a, b, c, x[1], 12, 0xe8c7b756);
-    FF(c, d, a, b, x[2], 17, 0x242070db);
-    FF(b, c, d, a, x[3], 22, 0xc1bdceee);
-    FF(a, b, c, d, x[4], 7, 0xf57c0faf);
-    FF(d, a, b, c, x[5], 12, 0x4787c62a);
-    FF(c, d, a, b, x[6], 17, 0xa8304613);
-    FF(b, c, d, a, x[7], 22, 0xfd469501);
-    FF(a, b, c, d, x[8], 7, 0x698098d8);
-    FF(d, a, b, c, x[9], 12, 0x8b44f7af);
-    FF(c, d, a, b, x[10], 17, 0xffff5bb1);
-    FF(b, c, d, a, x[11], 22, 0x895cd7be);
-    FF(a, b, c, d, x[12], 7, 0x6b901122);
-    FF(d, a, b, c, x[13], 12, 0xfd987193);
-    FF(c, d, a, b, x[14], 17, 0xa679438e);
-    FF(b, c, d, a, x[15], 22, 0x49b40821);
-
-    // Round 2
-    GG(a, b, c, d, x[1], 5, 0xf61e2562);
-    GG(d, a, b, c, x[6], 9, 0xc040b340);
-    GG(c, d, a, b, x[11], 14, 0x265e5a51);
-    GG(b, c, d, a, x[0], 20, 0xe9b6c7aa);
-    GG(a, b, c, d, x[5], 5, 0xd62f105d);
-    GG(d, a, b, c, x[10], 9, 0x02441453);
-    GG(c, d, a, b, x[15], 14, 0xd8a1e681);
-    GG(b, c, d, a, x[4], 20, 0xe7d3fbc8);
-    GG(a, b, c, d, x[9], 5, 0x21e1cde6);
-    GG(d, a, b, c, x[14], 9, 0xc33707d6);
-    GG(c, d, a, b, x[3], 14, 0xf4d50d87);
-    GG(b, c, d, a, x[8], 20, 0x455a14ed);
-    GG(a, b, c, d, x[13], 5, 0xa9e3e905);
-    GG(d, a, b, c, x[2], 9, 0xfcefa3f8);
-    GG(c, d, a, b, x[7], 14, 0x676f02d9);
-    GG(b, c, d, a, x[12], 20, 0x8d2a4c8a);
-
-    // Round 3
-    HH(a, b, c, d, x[5], 4, 0xfffa3942);
-    HH(d, a, b, c, x[8], 11, 0x8771f681);
-    HH(c, d, a, b, x[11], 16, 0x6d9d6122);
-    HH(b, c, d, a, x[14], 23, 0xfde5380c);
-    HH(a, b, c, d, x[1], 4, 0xa4beea44);
-    HH(d, a, b, c, x[4], 11, 0x4bdecfa9);
-    HH(c, d, a, b, x[7], 16, 0xf6bb4b60);
-    HH(b, c, d, a, x[10], 23, 0xbebfbc70);
-    HH(a, b, c, d, x[13], 4, 0x289b7ec6);
-    HH(d, a, b, c, x[0], 11, 0xeaa127fa);
-    HH(c, d, a, b, x[3], 16, 0xd4ef3085);
-    HH(b, c, d, a, x[6], 23, 0x04881d05);
-    HH(a, b, c, d, x[9], 4, 0xd9d4d039);
-    HH(d, a, b, c, x[12], 11, 0xe6db99e5);
-    HH(c, d, a, b, x[15], 16, 0x1fa27cf8);
-    HH(b, c, d, a, x[2], 23, 0xc4ac5665);
-
-    // Round 4
-    II(a, b, c, d, x[0], 6, 0xf4292244);
-    II(d, a, b, c, x[7], 10, 0x432aff97);
-    II(c, d, a, b, x[14], 15, 0xab9423a7);
-    II(b, c, d, a, x[5], 21, 0xfc93a039);
-    II(a, b, c, d, x[12], 6, 0x655b59c3);
-    II(d, a, b, c, x[3], 10, 0x8f0ccc92);
-    II(c, d, a, b, x[10], 15, 0xffeff47d);
-    II(b, c, d, a, x[1], 21, 0x85845dd1);
-    II(a, b, c, d, x[8], 6, 0x6fa87e4f);
-    II(d, a, b, c, x[15], 10, 0xfe2ce6e0);
-    II(c, d, a, b, x[6], 15, 0xa3014314);
-    II(b, c, d, a, x[13], 21, 0x4e0811a1);
-    II(a, b, c, d, x[4], 6, 0xf7537e82);
-    II(d, a, b, c, x[11], 10, 0xbd3af235);
-    II(c, d, a, b, x[2], 15, 0x2ad7d2bb);
-    II(b, c, d, a, x[9], 21, 0xeb86d391);
-
-    ctx->state[0] += a;
-    ctx->state[1] += b;
-    ctx->state[2] += c;
-    ctx->state[3] += d;
+// Aligned O_DIRECT buffer, one per hashing thread and reused across files
+static pthread_key_t direct_buffer_key;
+static pthread_once_t direct_buffer_once = PTHREAD_ONCE_INIT;
+
+// Little-endian word load; a single unaligned load on little-endian hosts
+static inline uint32_t load_le32(const uint8_t *bytes) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+#else
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+#endif
+}
+
+// Message word i of the current block, loaded where the step uses it
+#define X(i) load_le32(data + (i) * 4)
+
+// Hash count consecutive 64-byte blocks, keeping the state in registers;
+// inlined into one kernel per ISA level so each gets its own code generation
+static inline __attribute__((always_inline))
+void md5_transform_blocks(uint32_t state[4], const uint8_t *data, size_t count) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+    for (; count > 0; count--, data += 64) {
+        uint32_t aa = a, bb = b, cc = c, dd = d;
+
+        // Round 1
+        FF(a, b, c, d, X(0), 7, 0xd76aa478);
+        FF(d, a, b, c, X(1), 12, 0xe8c7b756);
+        FF(c, d, a, b, X(2), 17, 0x242070db);
+        FF(b, c, d, a, X(3), 22, 0xc1bdceee);
+        FF(a, b, c, d, X(4), 7, 0xf57c0faf);
+        FF(d, a, b, c, X(5), 12, 0x4787c62a);
+        FF(c, d, a, b, X(6), 17, 0xa8304613);
+        FF(b, c, d, a, X(7), 22, 0xfd469501);
+        FF(a, b, c, d, X(8), 7, 0x698098d8);
+        FF(d, a, b, c, X(9), 12, 0x8b44f7af);
+        FF(c, d, a, b, X(10), 17, 0xffff5bb1);
+        FF(b, c, d, a, X(11), 22, 0x895cd7be);
+        FF(a, b, c, d, X(12), 7, 0x6b901122);
+        FF(d, a, b, c, X(13), 12, 0xfd987193);
+        FF(c, d, a, b, X(14), 17, 0xa679438e);
+        FF(b, c, d, a, X(15), 22, 0x49b40821);
+
+        // Round 2
+        GG(a, b, c, d, X(1), 5, 0xf61e2562);
+        GG(d, a, b, c, X(6), 9, 0xc040b340);
+        GG(c, d, a, b, X(11), 14, 0x265e5a51);
+        GG(b, c, d, a, X(0), 20, 0xe9b6c7aa);
+        GG(a, b, c, d, X(5), 5, 0xd62f105d);
+        GG(d, a, b, c, X(10), 9, 0x02441453);
+        GG(c, d, a, b, X(15), 14, 0xd8a1e681);
+        GG(b, c, d, a, X(4), 20, 0xe7d3fbc8);
+        GG(a, b, c, d, X(9), 5, 0x21e1cde6);
+        GG(d, a, b, c, X(14), 9, 0xc33707d6);
+        GG(c, d, a, b, X(3), 14, 0xf4d50d87);
+        GG(b, c, d, a, X(8), 20, 0x455a14ed);
+        GG(a, b, c, d, X(13), 5, 0xa9e3e905);
+        GG(d, a, b, c, X(2), 9, 0xfcefa3f8);
+        GG(c, d, a, b, X(7), 14, 0x676f02d9);
+        GG(b, c, d, a, X(12), 20, 0x8d2a4c8a);
+
+        // Round 3
+        HH(a, b, c, d, X(5), 4, 0xfffa3942);
+        HH(d, a, b, c, X(8), 11, 0x8771f681);
+        HH(c, d, a, b, X(11), 16, 0x6d9d6122);
+        HH(b, c, d, a, X(14), 23, 0xfde5380c);
+        HH(a, b, c, d, X(1), 4, 0xa4beea44);
+        HH(d, a, b, c, X(4), 11, 0x4bdecfa9);
+        HH(c, d, a, b, X(7), 16, 0xf6bb4b60);
+        HH(b, c, d, a, X(10), 23, 0xbebfbc70);
+        HH(a, b, c, d, X(13), 4, 0x289b7ec6);
+        HH(d, a, b, c, X(0), 11, 0xeaa127fa);
+        HH(c, d, a, b, X(3), 16, 0xd4ef3085);
+        HH(b, c, d, a, X(6), 23, 0x04881d05);
+        HH(a, b, c, d, X(9), 4, 0xd9d4d039);
+        HH(d, a, b, c, X(12), 11, 0xe6db99e5);
+        HH(c, d, a, b, X(15), 16, 0x1fa27cf8);
+        HH(b, c, d, a, X(2), 23, 0xc4ac5665);
+
+        // Round 4
+        II(a, b, c, d, X(0), 6, 0xf4292244);
+        II(d, a, b, c, X(7), 10, 0x432aff97);
+        II(c, d, a, b, X(14), 15, 0xab9423a7);
+        II(b, c, d, a, X(5), 21, 0xfc93a039);
+        II(a, b, c, d, X(12), 6, 0x655b59c3);
+        II(d, a, b, c, X(3), 10, 0x8f0ccc92);
+        II(c, d, a, b, X(10), 15, 0xffeff47d);
+        II(b, c, d, a, X(1), 21, 0x85845dd1);
+        II(a, b, c, d, X(8), 6, 0x6fa87e4f);
+        II(d, a, b, c, X(15), 10, 0xfe2ce6e0);
+        II(c, d, a, b, X(6), 15, 0xa3014314);
+        II(b, c, d, a, X(13), 21, 0x4e0811a1);
+        II(a, b, c, d, X(4), 6, 0xf7537e82);
+        II(d, a, b, c, X(11), 10, 0xbd3af235);
+        II(c, d, a, b, X(2), 15, 0x2ad7d2bb);
+        II(b, c, d, a, X(9), 21, 0xeb86d391);
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+    }
+
+    state[0] = a;
+    state[1] = b;
+    state[2] = c;
+    state[3] = d;
+}
+
+typedef void (*transform_fn)(uint32_t state[4], const uint8_t *data, size_t count);
+
+static calc_md5_kernel_t active_kernel = CALC_MD5_AUTO;
+static transform_fn md5_transform = NULL;
+
+// Baseline build, runs on every CPU of the target architecture
+static void transform_generic(uint32_t state[4], const uint8_t *data, size_t count) {
+    md5_transform_blocks(state, data, count);
+}
+
+#ifdef CALC_MD5_X86
+// G and I take ANDN for their inverted operand, rotations become RORX
+__attribute__((target("bmi,bmi2")))
+static void transform_bmi2(uint32_t state[4], const uint8_t *data, size_t count) {
+    md5_transform_blocks(state, data, count);
+}
+#endif
+
+static void select_kernel(void) {
+    if (md5_transform) return;
+    calc_md5_set_kernel(CALC_MD5_AUTO);
+}
+
+int calc_md5_set_kernel(calc_md5_kernel_t kernel) {
+#ifdef CALC_MD5_X86
+    __builtin_cpu_init();
+    int has_bmi2 = __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#else
+    int has_bmi2 = 0;
+#endif
+
+    if (kernel == CALC_MD5_AUTO) {
+        kernel = has_bmi2 ? CALC_MD5_BMI2 : CALC_MD5_GENERIC;
+    }
+
+    switch (kernel) {
+        case CALC_MD5_GENERIC:
+            md5_transform = transform_generic;
+            break;
+#ifdef CALC_MD5_X86
+        case CALC_MD5_BMI2:
+            if (!has_bmi2) return -1;
+            md5_transform = transform_bmi2;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+calc_md5_kernel_t calc_md5_kernel(void) {
+    select_kernel();
+    return active_kernel;
+}
+
+const char *calc_md5_kernel_name(calc_md5_kernel_t kernel) {
+    switch (kernel) {
+        case CALC_MD5_AUTO:    return "auto";
+        case CALC_MD5_GENERIC: return "generic";
+        case CALC_MD5_BMI2:    return "bmi2";
+    }
+    return "unknown";
 }
 
 void md5_init(MD5_CTX *ctx) {
+    select_kernel();
     ctx->count[0] = ctx->count[1] = 0;
     ctx->state[0] = 0x67452301;
     ctx->state[1] = 0xefcdab89;
@@ -139,7 +248,6 @@ void md5_init(MD5_CTX *ctx) {
 }
 
 void md5_update(MD5_CTX *ctx, const uint8_t *data, size_t len) {
-    size_t i;
     size_t index = (ctx->count[0] >> 3) & 0x3F;
 
     if ((ctx->count[0] += (uint32_t)(len << 3)) < (len << 3)) {
@@ -147,40 +255,44 @@ void md5_update(MD5_CTX *ctx, const uint8_t *data, size_t len) {
     }
     ctx->count[1] += (uint32_t)(len >> 29);
 
-    size_t partLen = 64 - index;
-
-    if (len >= partLen) {
-        memcpy(&ctx->buffer[index], data, partLen);
-        md5_transform(ctx, ctx->buffer);
-
-        for (i = partLen; i + 63 < len; i += 64) {
-            md5_transform(ctx, &data[i]);
+    // Complete a partial block first; whole blocks are hashed in place
+    if (index > 0) {
+        size_t partLen = 64 - index;
+        if (len < partLen) {
+            memcpy(&ctx->buffer[index], data, len);
+            return;
         }
-
-        index = 0;
-    } else {
-        i = 0;
+        memcpy(&ctx->buffer[index], data, partLen);
+        md5_transform(ctx->state, ctx->buffer, 1);
+        data += partLen;
+        len -= partLen;
     }
 
-    memcpy(&ctx->buffer[index], &data[i], len - i);
+    if (len >= 64) {
+        md5_transform(ctx->state, data, len / 64);
+        data += len & ~(size_t)63;
+        len &= 63;
+    }
+    if (len > 0) {
+        memcpy(ctx->buffer, data, len);
+    }
 }
 
 void md5_final(MD5_CTX *ctx, uint8_t digest[16]) {
-    uint8_t bits[8];
-    size_t index, padLen;
+    size_t index = (ctx->count[0] >> 3) & 0x3f;
 
-    // Save number of bits
+    // Pad with 0x80 and zeros to 56 mod 64, then the bit count
+    ctx->buffer[index++] = 0x80;
+    if (index > 56) {
+        memset(&ctx->buffer[index], 0, 64 - index);
+        md5_transform(ctx->state, ctx->buffer, 1);
+        index = 0;
+    }
+    memset(&ctx->buffer[index], 0, 56 - index);
     for (int i = 0; i < 8; i++) {
-        bits[i] = (uint8_t)((ctx->count[i >> 2] >> ((i & 3) << 3)) & 0xff);
+        ctx->buffer[56 + i] = (uint8_t)((ctx->count[i >> 2] >> ((i & 3) << 3)) & 0xff);
     }
-
-    // Pad out to 56 mod 64
-    index = (ctx->count[0] >> 3) & 0x3f;
-    padLen = (index < 56) ? (56 - index) : (120 - index);
-    md5_update(ctx, PADDING, padLen);
-
-    // Append length (before padding)
-    md5_update(ctx, bits, 8);
+    md5_transform(ctx->state, ctx->buffer, 1);
 
     // Store state in digest
     for (int i = 0; i < 16; i++) {
@@ -192,34 +304,661 @@ void md5_final(MD5_CTX *ctx, uint8_t digest[16]) {
 }
 
 void md5_to_string(const uint8_t digest[16], char *output) {
-    int i;
-    for (i = 0; i < 16; i++) {
-        sprintf(output + i * 2, "%02x", digest[i]);
+    calc_hash_to_string(digest, 16, output);
+}
+
+void calc_hash_to_string(const uint8_t *digest, size_t size, char *output) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++) {
+        output[i * 2] = hex[digest[i] >> 4];
+        output[i * 2 + 1] = hex[digest[i] & 0x0f];
     }
-    output[32] = '\0';
+    output[size * 2] = '\0';
 }
 
-int calculate_file_md5(const char *filename, char *md5_string) {
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        return -1;
+void calc_hash_init(calc_hash_ctx_t *ctx, calc_hash_t algorithm) {
+    ctx->algorithm = algorithm;
+    switch (algorithm) {
+        case CALC_HASH_MD5:    md5_init(&ctx->u.md5); break;
+        case CALC_HASH_XXH128: xxh3_128_init(&ctx->u.xxh3); break;
+        case CALC_HASH_SHA256: sha256_init(&ctx->u.sha256); break;
+        case CALC_HASH_BLAKE3: blake3_init(&ctx->u.blake3); break;
     }
+}
+
+void calc_hash_update(calc_hash_ctx_t *ctx, const uint8_t *data, size_t len) {
+    switch (ctx->algorithm) {
+        case CALC_HASH_MD5:    md5_update(&ctx->u.md5, data, len); break;
+        case CALC_HASH_XXH128: xxh3_128_update(&ctx->u.xxh3, data, len); break;
+        case CALC_HASH_SHA256: sha256_update(&ctx->u.sha256, data, len); break;
+        case CALC_HASH_BLAKE3: blake3_update(&ctx->u.blake3, data, len); break;
+    }
+}
+
+size_t calc_hash_final(calc_hash_ctx_t *ctx, uint8_t *digest) {
+    switch (ctx->algorithm) {
+        case CALC_HASH_MD5:    md5_final(&ctx->u.md5, digest); break;
+        case CALC_HASH_XXH128: xxh3_128_final(&ctx->u.xxh3, digest); break;
+        case CALC_HASH_SHA256: sha256_final(&ctx->u.sha256, digest); break;
+        case CALC_HASH_BLAKE3: blake3_final(&ctx->u.blake3, digest); break;
+    }
+    return calc_hash_digest_size(ctx->algorithm);
+}
 
-    MD5_CTX ctx;
-    md5_init(&ctx);
+size_t calc_hash_digest_size(calc_hash_t algorithm) {
+    switch (algorithm) {
+        case CALC_HASH_MD5:    return 16;
+        case CALC_HASH_XXH128: return XXH3_DIGEST_SIZE;
+        case CALC_HASH_SHA256: return SHA256_DIGEST_SIZE;
+        case CALC_HASH_BLAKE3: return BLAKE3_DIGEST_SIZE;
+    }
+    return 0;
+}
 
+const char *calc_hash_name(calc_hash_t algorithm) {
+    switch (algorithm) {
+        case CALC_HASH_MD5:    return "md5";
+        case CALC_HASH_XXH128: return "xxh128";
+        case CALC_HASH_SHA256: return "sha256";
+        case CALC_HASH_BLAKE3: return "blake3";
+    }
+    return "unknown";
+}
+
+int calc_hash_from_name(const char *name, calc_hash_t *algorithm) {
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        if (strcmp(name, calc_hash_name((calc_hash_t)i)) == 0) {
+            *algorithm = (calc_hash_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int calc_hash_parse_list(const char *text, calc_hash_t *hashes, int *count) {
+    calc_hash_t parsed[CALC_HASH_COUNT];
+    int n = 0;
+
+    while (*text) {
+        const char *end = strchr(text, ',');
+        size_t length = end ? (size_t)(end - text) : strlen(text);
+        char name[16];
+        calc_hash_t algorithm;
+
+        if (length == 0 || length >= sizeof(name) || n == CALC_HASH_COUNT) {
+            return -1;
+        }
+        memcpy(name, text, length);
+        name[length] = '\0';
+        if (calc_hash_from_name(name, &algorithm) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (parsed[i] == algorithm) return -1;
+        }
+        parsed[n++] = algorithm;
+
+        if (!end) break;
+        text = end + 1;
+        if (*text == '\0') return -1;
+    }
+
+    if (n == 0) return -1;
+    memcpy(hashes, parsed, (size_t)n * sizeof(parsed[0]));
+    *count = n;
+    return 0;
+}
+
+void calc_hash_format_list(const calc_hash_t *hashes, int count, char *output, size_t size) {
+    size_t used = 0;
+
+    if (size == 0) return;
+    output[0] = '\0';
+    for (int i = 0; i < count && used < size; i++) {
+        int written = snprintf(output + used, size - used, "%s%s", i > 0 ? "," : "",
+                               calc_hash_name(hashes[i]));
+        if (written < 0) break;
+        used += (size_t)written;
+    }
+}
+
+void calc_hash_set_init(calc_hash_set_t *set, const calc_hash_t *hashes, int count) {
+    set->count = count;
+    for (int i = 0; i < count; i++) {
+        calc_hash_init(&set->ctx[i], hashes[i]);
+    }
+}
+
+void calc_hash_set_update(calc_hash_set_t *set, const uint8_t *data, size_t len) {
+    if (set->count == 1) {
+        calc_hash_update(&set->ctx[0], data, len);
+        return;
+    }
+
+    // Each slice is read from memory once and hashed from L1 by the rest
+    while (len > 0) {
+        size_t slice = len < CALC_HASH_SET_SLICE ? len : CALC_HASH_SET_SLICE;
+        for (int i = 0; i < set->count; i++) {
+            calc_hash_update(&set->ctx[i], data, slice);
+        }
+        data += slice;
+        len -= slice;
+    }
+}
+
+void calc_hash_set_final(calc_hash_set_t *set, calc_hash_digests_t *digests) {
+    for (int i = 0; i < set->count; i++) {
+        uint8_t digest[CALC_HASH_MAX_DIGEST_SIZE];
+        size_t size = calc_hash_final(&set->ctx[i], digest);
+        calc_hash_to_string(digest, size, digests->hex[i]);
+    }
+}
+
+void calc_md5_set_options(const calc_md5_options_t *options) {
+    if (!options) return;
+
+    hash_options = *options;
+    if (hash_options.hash_count < 1 || hash_options.hash_count > CALC_HASH_COUNT) {
+        hash_options.hashes[0] = CALC_HASH_MD5;
+        hash_options.hash_count = 1;
+    }
+
+    // Windows must start on page boundaries
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t page = page_size > 0 ? (uint64_t)page_size : 4096;
+    if (hash_options.mmap_window < page) {
+        hash_options.mmap_window = page;
+    }
+    hash_options.mmap_window -= hash_options.mmap_window % page;
+
+    // Pick the transform kernels before any hashing thread starts
+    select_kernel();
+    sha256_kernel();
+}
+
+void calc_md5_get_options(calc_md5_options_t *options) {
+    if (options) {
+        *options = hash_options;
+    }
+}
+
+// Cache hygiene for buffered reads: read ahead of the hashing position and
+// drop everything behind it, one fadvise window at a time
+typedef struct {
+    int fd;
+    uint64_t dropped;  // Everything before this offset has been released
+    uint64_t ahead;    // Readahead has been requested up to this offset
+} cache_hygiene_t;
+
+static void hygiene_start(cache_hygiene_t *hygiene, int fd, uint64_t offset) {
+    hygiene->fd = fd;
+    hygiene->dropped = offset;
+    hygiene->ahead = offset + CALC_MD5_FADVISE_WINDOW;
+    if (hash_options.fadvise) {
+        posix_fadvise(fd, (off_t)offset, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(fd, (off_t)offset, CALC_MD5_FADVISE_WINDOW, POSIX_FADV_WILLNEED);
+    }
+}
+
+static void hygiene_advance(cache_hygiene_t *hygiene, uint64_t offset) {
+    if (!hash_options.fadvise || offset - hygiene->dropped < CALC_MD5_FADVISE_WINDOW) {
+        return;
+    }
+    posix_fadvise(hygiene->fd, (off_t)hygiene->dropped, (off_t)(offset - hygiene->dropped),
+                  POSIX_FADV_DONTNEED);
+    hygiene->dropped = offset;
+    posix_fadvise(hygiene->fd, (off_t)hygiene->ahead, CALC_MD5_FADVISE_WINDOW, POSIX_FADV_WILLNEED);
+    hygiene->ahead += CALC_MD5_FADVISE_WINDOW;
+}
+
+static void hygiene_finish(cache_hygiene_t *hygiene) {
+    if (hash_options.fadvise) {
+        // Length 0 releases everything up to EOF
+        posix_fadvise(hygiene->fd, (off_t)hygiene->dropped, 0, POSIX_FADV_DONTNEED);
+    }
+}
+
+// Hash from offset (the current file position) to EOF with read()
+static int hash_read(int fd, uint64_t offset, calc_hash_set_t *set) {
     uint8_t buffer[8192];
-    size_t bytes_read;
+    cache_hygiene_t hygiene;
+
+    hygiene_start(&hygiene, fd, offset);
+    for (;;) {
+        ssize_t bytes_read = read(fd, buffer, sizeof(buffer));
+        if (bytes_read > 0) {
+            calc_hash_set_update(set, buffer, (size_t)bytes_read);
+            offset += (uint64_t)bytes_read;
+            hygiene_advance(&hygiene, offset);
+        } else if (bytes_read == 0) {
+            hygiene_finish(&hygiene);
+            return 0;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+static void create_direct_buffer_key(void) {
+    pthread_key_create(&direct_buffer_key, free);
+}
+
+static uint8_t *get_direct_buffer(void) {
+    pthread_once(&direct_buffer_once, create_direct_buffer_key);
 
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        md5_update(&ctx, buffer, bytes_read);
+    void *buffer = pthread_getspecific(direct_buffer_key);
+    if (!buffer) {
+        if (posix_memalign(&buffer, CALC_MD5_DIRECT_ALIGNMENT, CALC_MD5_DIRECT_BUFFER_SIZE) != 0) {
+            return NULL;
+        }
+        pthread_setspecific(direct_buffer_key, buffer);
+    }
+    return buffer;
+}
+
+// Hash with O_DIRECT reads into an aligned buffer. The final block of a file
+// is usually short, which leaves the offset unaligned; if the kernel then
+// rejects a read, O_DIRECT is dropped for the remaining bytes.
+static int hash_direct(int fd, calc_hash_set_t *set) {
+    uint8_t *buffer = get_direct_buffer();
+    if (!buffer) {
+        return hash_read(fd, 0, set);
+    }
+
+    uint64_t offset = 0;
+    for (;;) {
+        ssize_t bytes_read = read(fd, buffer, CALC_MD5_DIRECT_BUFFER_SIZE);
+        if (bytes_read > 0) {
+            calc_hash_set_update(set, buffer, (size_t)bytes_read);
+            offset += (uint64_t)bytes_read;
+        } else if (bytes_read == 0) {
+            return 0;
+        } else if (errno == EINVAL) {
+            int flags = fcntl(fd, F_GETFL);
+            if (flags < 0 || !(flags & O_DIRECT) || fcntl(fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+                return -1;
+            }
+            return hash_read(fd, offset, set);
+        } else if (errno != EINTR) {
+            return -1;
+        }
     }
+}
 
-    fclose(file);
+// Hash a large file straight out of the page cache, one window at a time so
+// multi-GB images never need more than mmap_window of address space.
+// A file truncated while it is mapped raises SIGBUS on the first page past
+// its new end. The handler jumps back into the window being hashed, which
+// then reads the rest of the file instead; any other SIGBUS stays fatal.
+static __thread sigjmp_buf *mmap_fault_jump;
+static pthread_once_t mmap_fault_once = PTHREAD_ONCE_INIT;
+static int mmap_fault_ready;
+
+static void mmap_fault_handler(int signo) {
+    if (!mmap_fault_jump) {
+        signal(signo, SIG_DFL);
+        raise(signo);
+        return;
+    }
+    siglongjmp(*mmap_fault_jump, 1);
+}
 
-    uint8_t digest[16];
-    md5_final(&ctx, digest);
-    md5_to_string(digest, md5_string);
+static void install_mmap_fault_handler(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = mmap_fault_handler;
+    sigemptyset(&action.sa_mask);
+    mmap_fault_ready = sigaction(SIGBUS, &action, NULL) == 0;
+}
 
+// Hash one mapped window; on SIGBUS the set is put back as it was before
+// the window and -1 returned
+static int hash_window(calc_hash_set_t *set, const uint8_t *map, size_t length) {
+    calc_hash_set_t saved = *set;
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 1) != 0) {
+        mmap_fault_jump = NULL;
+        *set = saved;
+        return -1;
+    }
+    mmap_fault_jump = &jump;
+    calc_hash_set_update(set, map, length);
+    mmap_fault_jump = NULL;
     return 0;
 }
+
+static int hash_mmap(int fd, uint64_t size, calc_hash_set_t *set) {
+    uint64_t offset = 0;
+
+    // Without the SIGBUS guard a truncation would kill the scan
+    pthread_once(&mmap_fault_once, install_mmap_fault_handler);
+    if (!mmap_fault_ready) {
+        return hash_read(fd, 0, set);
+    }
+
+    if (hash_options.fadvise) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    while (offset < size) {
+        size_t length = (size_t)(size - offset < hash_options.mmap_window ?
+                                 size - offset : hash_options.mmap_window);
+        void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+        if (map == MAP_FAILED) {
+            // Not mappable after all: read the rest instead
+            if (lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+                return -1;
+            }
+            return hash_read(fd, offset, set);
+        }
+
+        madvise(map, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(map, length, MADV_HUGEPAGE);
+#endif
+        if (hash_window(set, (const uint8_t *)map, length) != 0) {
+            // Truncated while mapped: read what is left from this window on
+            munmap(map, length);
+            if (lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+                return -1;
+            }
+            return hash_read(fd, offset, set);
+        }
+        munmap(map, length);
+        if (hash_options.fadvise) {
+            posix_fadvise(fd, (off_t)offset, (off_t)length, POSIX_FADV_DONTNEED);
+        }
+        offset += length;
+    }
+
+    // The file may have grown since fstat(); pick up any new tail
+    if (lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    return hash_read(fd, offset, set);
+}
+
+// Ring of read buffers shared by the reading thread and one helper thread per
+// extra digest. The reader hashes the primary digest itself; a buffer is only
+// refilled once every digest has consumed it, so a slow digest throttles the
+// reads instead of the ring growing. One ring per hashing thread, kept for
+// the thread's lifetime.
+typedef struct hash_ring hash_ring_t;
+
+typedef struct {
+    hash_ring_t *ring;
+    int index;                  // Context of the file's set this helper feeds
+} ring_helper_t;
+
+struct hash_ring {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *buffers[CALC_HASH_RING_SLOTS];
+    size_t lengths[CALC_HASH_RING_SLOTS];
+    uint64_t produced;                   // Buffers filled so far
+    uint64_t consumed[CALC_HASH_COUNT];  // Buffers each digest has hashed
+    calc_hash_set_t *set;                // Digests of the current file
+    int helper_count;
+    int shutdown;
+    pthread_t threads[CALC_HASH_COUNT];
+    ring_helper_t helpers[CALC_HASH_COUNT];
+};
+
+static pthread_key_t hash_ring_key;
+static pthread_once_t hash_ring_once = PTHREAD_ONCE_INIT;
+
+static void *ring_helper_main(void *arg) {
+    ring_helper_t *helper = (ring_helper_t *)arg;
+    hash_ring_t *ring = helper->ring;
+    int index = helper->index;
+
+    pthread_mutex_lock(&ring->lock);
+    for (;;) {
+        while (!ring->shutdown && ring->consumed[index] == ring->produced) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+        if (ring->consumed[index] == ring->produced) {
+            break;
+        }
+
+        size_t slot = (size_t)(ring->consumed[index] % CALC_HASH_RING_SLOTS);
+        calc_hash_set_t *set = ring->set;
+        pthread_mutex_unlock(&ring->lock);
+
+        if (set && index < set->count) {
+            calc_hash_update(&set->ctx[index], ring->buffers[slot], ring->lengths[slot]);
+        }
+
+        pthread_mutex_lock(&ring->lock);
+        ring->consumed[index]++;
+        pthread_cond_broadcast(&ring->cond);
+    }
+    pthread_mutex_unlock(&ring->lock);
+    return NULL;
+}
+
+static void destroy_hash_ring(void *arg) {
+    hash_ring_t *ring = (hash_ring_t *)arg;
+
+    pthread_mutex_lock(&ring->lock);
+    ring->shutdown = 1;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+
+    for (int i = 1; i <= ring->helper_count; i++) {
+        pthread_join(ring->threads[i], NULL);
+    }
+    for (int i = 0; i < CALC_HASH_RING_SLOTS; i++) {
+        free(ring->buffers[i]);
+    }
+    pthread_cond_destroy(&ring->cond);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring);
+}
+
+static void create_hash_ring_key(void) {
+    pthread_key_create(&hash_ring_key, destroy_hash_ring);
+}
+
+// This thread's ring with helpers for digests 1..count-1, NULL on failure
+static hash_ring_t *get_hash_ring(int count) {
+    pthread_once(&hash_ring_once, create_hash_ring_key);
+
+    hash_ring_t *ring = pthread_getspecific(hash_ring_key);
+    if (!ring) {
+        ring = calloc(1, sizeof(*ring));
+        if (!ring) {
+            return NULL;
+        }
+        for (int i = 0; i < CALC_HASH_RING_SLOTS; i++) {
+            void *buffer;
+            if (posix_memalign(&buffer, CALC_MD5_DIRECT_ALIGNMENT, CALC_HASH_RING_BUFFER_SIZE) != 0) {
+                for (int j = 0; j < i; j++) free(ring->buffers[j]);
+                free(ring);
+                return NULL;
+            }
+            ring->buffers[i] = buffer;
+        }
+        pthread_mutex_init(&ring->lock, NULL);
+        pthread_cond_init(&ring->cond, NULL);
+        pthread_setspecific(hash_ring_key, ring);
+    }
+
+    // Helpers are started on first use and kept for later files
+    while (ring->helper_count < count - 1) {
+        int index = ring->helper_count + 1;
+        ring->helpers[index].ring = ring;
+        ring->helpers[index].index = index;
+        ring->consumed[index] = ring->produced;
+        if (pthread_create(&ring->threads[index], NULL, ring_helper_main,
+                           &ring->helpers[index]) != 0) {
+            break;
+        }
+        ring->helper_count++;
+    }
+    return ring->helper_count >= count - 1 ? ring : NULL;
+}
+
+// Buffers the slowest thread of the ring has yet to hash
+static uint64_t ring_pending(const hash_ring_t *ring) {
+    uint64_t pending = 0;
+    for (int i = 0; i <= ring->helper_count; i++) {
+        uint64_t behind = ring->produced - ring->consumed[i];
+        if (behind > pending) pending = behind;
+    }
+    return pending;
+}
+
+// Read a whole file into the ring, hashing the primary digest on this
+// thread while the helpers hash the others from the same buffers
+static int hash_parallel(int fd, hash_ring_t *ring, calc_hash_set_t *set) {
+    cache_hygiene_t hygiene;
+    uint64_t offset = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&ring->lock);
+    ring->set = set;
+    pthread_mutex_unlock(&ring->lock);
+
+    hygiene_start(&hygiene, fd, 0);
+    for (;;) {
+        pthread_mutex_lock(&ring->lock);
+        while (ring_pending(ring) >= CALC_HASH_RING_SLOTS) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+        size_t slot = (size_t)(ring->produced % CALC_HASH_RING_SLOTS);
+        pthread_mutex_unlock(&ring->lock);
+
+        uint8_t *buffer = ring->buffers[slot];
+        ssize_t bytes_read = read(fd, buffer, CALC_HASH_RING_BUFFER_SIZE);
+        if (bytes_read < 0) {
+            // A short O_DIRECT read leaves the offset unaligned; read the
+            // rest buffered, as hash_direct() does
+            int flags;
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL && (flags = fcntl(fd, F_GETFL)) >= 0 && (flags & O_DIRECT) &&
+                fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+                continue;
+            }
+            ret = -1;
+            break;
+        }
+        if (bytes_read == 0) {
+            hygiene_finish(&hygiene);
+            break;
+        }
+
+        pthread_mutex_lock(&ring->lock);
+        ring->lengths[slot] = (size_t)bytes_read;
+        ring->produced++;
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+
+        calc_hash_update(&set->ctx[0], buffer, (size_t)bytes_read);
+        offset += (uint64_t)bytes_read;
+        hygiene_advance(&hygiene, offset);
+
+        pthread_mutex_lock(&ring->lock);
+        ring->consumed[0]++;
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+    }
+
+    // The set must not be finished while a helper is still hashing into it
+    pthread_mutex_lock(&ring->lock);
+    while (ring_pending(ring) > 0) {
+        pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    ring->set = NULL;
+    pthread_mutex_unlock(&ring->lock);
+
+    return ret;
+}
+
+// Hash an open file with the given algorithms and close it
+static int hash_fd(int fd, const calc_hash_t *hashes, int hash_count,
+                   calc_hash_digests_t *digests) {
+    calc_hash_set_t set;
+    calc_hash_set_init(&set, hashes, hash_count);
+
+    struct stat statbuf;
+    int have_stat = fstat(fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode);
+    hash_ring_t *ring = NULL;
+    int ret;
+
+    if (hash_options.parallel_hashes && set.count > 1 && have_stat &&
+        (uint64_t)statbuf.st_size >= CALC_HASH_PARALLEL_MIN_SIZE) {
+        ring = get_hash_ring(set.count);
+    }
+
+    if (ring) {
+        ret = hash_parallel(fd, ring, &set);
+    } else if (hash_options.direct_io) {
+        ret = hash_direct(fd, &set);
+    } else if (hash_options.mmap_threshold > 0 && have_stat &&
+        (uint64_t)statbuf.st_size >= hash_options.mmap_threshold) {
+        ret = hash_mmap(fd, (uint64_t)statbuf.st_size, &set);
+    } else {
+        ret = hash_read(fd, 0, &set);
+    }
+
+    close(fd);
+    if (ret != 0) {
+        return -1;
+    }
+
+    calc_hash_set_final(&set, digests);
+    return 0;
+}
+
+// Open for hashing; filesystems without O_DIRECT support get a buffered fd
+int calc_md5_open_at(int dir_fd, const char *filename) {
+    int flags = O_RDONLY | O_CLOEXEC;
+
+    if (hash_options.direct_io) {
+        int fd = openat(dir_fd, filename, flags | O_DIRECT);
+        if (fd >= 0 || errno != EINVAL) {
+            return fd;
+        }
+    }
+    return openat(dir_fd, filename, flags);
+}
+
+int calculate_file_md5(const char *filename, char *md5_string) {
+    return calculate_file_md5_at(AT_FDCWD, filename, md5_string);
+}
+
+int calculate_file_md5_at(int dir_fd, const char *filename, char *md5_string) {
+    static const calc_hash_t md5 = CALC_HASH_MD5;
+    calc_hash_digests_t digests;
+
+    int fd = calc_md5_open_at(dir_fd, filename);
+    if (fd < 0 || hash_fd(fd, &md5, 1, &digests) != 0) {
+        return -1;
+    }
+
+    memcpy(md5_string, digests.hex[0], 33);
+    return 0;
+}
+
+int calculate_file_digests_at(int dir_fd, const char *filename, calc_hash_digests_t *digests) {
+    int fd = calc_md5_open_at(dir_fd, filename);
+    if (fd < 0) {
+        return -1;
+    }
+
+    return hash_fd(fd, hash_options.hashes, hash_options.hash_count, digests);
+}
+
+int calc_md5_prefetch_at(int dir_fd, const char *filename) {
+    int fd = openat(dir_fd, filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int ret = posix_fadvise(fd, 0, CALC_MD5_PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+    close(fd);
+    return ret == 0 ? 0 : -1;
+}
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../xxh3/xxh3.h"
+#include "../sha256/sha256.h"
+#include "../blake3/blake3.h"
 
 // MD5 context structure
 typedef struct {
@@ -11,14 +14,165 @@ typedef struct {
     uint8_t buffer[64];
 } MD5_CTX;
 
+// Digest algorithms for file hashing
+typedef enum {
+    CALC_HASH_MD5,          // MD5, the default and the format of older scans
+    CALC_HASH_XXH128,       // XXH3-128, non-cryptographic change detection
+    CALC_HASH_SHA256,       // SHA-256, SHA-NI when the CPU has it
+    CALC_HASH_BLAKE3        // BLAKE3, 256-bit output
+} calc_hash_t;
+
+#define CALC_HASH_COUNT 4
+#define CALC_HASH_MAX_DIGEST_SIZE 32
+#define CALC_HASH_HEX_SIZE (CALC_HASH_MAX_DIGEST_SIZE * 2 + 1)
+
+// Streaming context of any algorithm
+typedef struct {
+    calc_hash_t algorithm;
+    union {
+        MD5_CTX md5;
+        xxh3_state_t xxh3;
+        sha256_ctx_t sha256;
+        blake3_hasher_t blake3;
+    } u;
+} calc_hash_ctx_t;
+
+// Several digests of the same bytes, fed from one read of the data
+typedef struct {
+    int count;
+    calc_hash_ctx_t ctx[CALC_HASH_COUNT];
+} calc_hash_set_t;
+
+// Hex digests of one file, in the order of calc_md5_options_t.hashes
+typedef struct {
+    char hex[CALC_HASH_COUNT][CALC_HASH_HEX_SIZE];
+} calc_hash_digests_t;
+
+#define CALC_MD5_DEFAULT_MMAP_THRESHOLD (16ULL * 1024 * 1024)
+#define CALC_MD5_DEFAULT_MMAP_WINDOW (64ULL * 1024 * 1024)
+#define CALC_MD5_DIRECT_ALIGNMENT 4096
+#define CALC_MD5_DIRECT_BUFFER_SIZE (1024 * 1024)
+#define CALC_MD5_FADVISE_WINDOW (8 * 1024 * 1024)
+#define CALC_MD5_PREFETCH_BYTES (512 * 1024)
+#define CALC_HASH_SET_SLICE (32 * 1024)
+#define CALC_HASH_RING_SLOTS 8
+#define CALC_HASH_RING_BUFFER_SIZE (256 * 1024)
+#define CALC_HASH_PARALLEL_MIN_SIZE (1024 * 1024)
+
+// Tuning for the file hashing functions; set once before hashing starts
+typedef struct {
+    uint64_t mmap_threshold;  // Hash files at least this large from mmap (0 = never)
+    uint64_t mmap_window;     // Bytes mapped at a time, multiple of the page size
+    int direct_io;            // Read with O_DIRECT, bypassing the page cache
+    int fadvise;              // Read ahead with fadvise, drop hashed ranges from the cache
+    calc_hash_t hashes[CALC_HASH_COUNT];  // Digests computed per file; hashes[0] is the primary
+    int hash_count;           // Entries used in hashes
+    int parallel_hashes;      // Hash large files on one thread per digest, fed from a ring of reads
+} calc_md5_options_t;
+
+// Scalar transform kernels, one per ISA level
+typedef enum {
+    CALC_MD5_AUTO,          // Best kernel the CPU supports
+    CALC_MD5_GENERIC,       // Baseline instruction set
+    CALC_MD5_BMI2           // x86 BMI1 + BMI2 (ANDN, RORX)
+} calc_md5_kernel_t;
+
+/**
+ * Select the transform kernel used by md5_update() and the file functions
+ *
+ * @param kernel Kernel, or CALC_MD5_AUTO for the best supported one
+ * @return 0 on success, -1 if the CPU or build does not support it
+ */
+int calc_md5_set_kernel(calc_md5_kernel_t kernel);
+
+// Kernel currently in use (never CALC_MD5_AUTO)
+calc_md5_kernel_t calc_md5_kernel(void);
+
+const char *calc_md5_kernel_name(calc_md5_kernel_t kernel);
+
 // MD5 function declarations
 void md5_init(MD5_CTX *ctx);
 void md5_update(MD5_CTX *ctx, const uint8_t *data, size_t len);
 void md5_final(MD5_CTX *ctx, uint8_t digest[16]);
 
-// High-level function to calculate MD5 of a file
+void calc_hash_init(calc_hash_ctx_t *ctx, calc_hash_t algorithm);
+void calc_hash_update(calc_hash_ctx_t *ctx, const uint8_t *data, size_t len);
+
+/**
+ * Finish a digest
+ *
+ * @param ctx Context, must be initialized again before reuse
+ * @param digest Output, at least CALC_HASH_MAX_DIGEST_SIZE bytes
+ * @return Digest size in bytes
+ */
+size_t calc_hash_final(calc_hash_ctx_t *ctx, uint8_t *digest);
+
+// Digest size in bytes of an algorithm
+size_t calc_hash_digest_size(calc_hash_t algorithm);
+
+// Name of an algorithm, also its key in scan records ("md5", "xxh128", ...)
+const char *calc_hash_name(calc_hash_t algorithm);
+
+/**
+ * Look up an algorithm by name
+ *
+ * @param name Algorithm name as returned by calc_hash_name()
+ * @param algorithm Output algorithm
+ * @return 0 on success, -1 if the name is unknown
+ */
+int calc_hash_from_name(const char *name, calc_hash_t *algorithm);
+
+/**
+ * Parse a comma-separated list of algorithm names, e.g. "md5,sha256"
+ *
+ * @param text List to parse
+ * @param hashes Output algorithms in list order, CALC_HASH_COUNT entries
+ * @param count Output number of algorithms
+ * @return 0 on success, -1 if a name is unknown, repeated or the list is empty
+ */
+int calc_hash_parse_list(const char *text, calc_hash_t *hashes, int *count);
+
+// Write a list of algorithm names joined by commas, truncated to size bytes
+void calc_hash_format_list(const calc_hash_t *hashes, int count, char *output, size_t size);
+
+// Convert a digest to lowercase hex; output needs 2 * size + 1 bytes
+void calc_hash_to_string(const uint8_t *digest, size_t size, char *output);
+
+void calc_hash_set_init(calc_hash_set_t *set, const calc_hash_t *hashes, int count);
+
+// Feed the same bytes to every digest, a cache-sized slice at a time
+void calc_hash_set_update(calc_hash_set_t *set, const uint8_t *data, size_t len);
+
+// Finish every digest as hex, in the order given to calc_hash_set_init()
+void calc_hash_set_final(calc_hash_set_t *set, calc_hash_digests_t *digests);
+
+// High-level function to calculate MD5 of a file (md5_string: 33 bytes);
+// always MD5, whatever calc_md5_options_t.hashes selects
 int calculate_file_md5(const char *filename, char *md5_string);
 
+// Calculate MD5 of a file named relative to the directory descriptor dir_fd
+int calculate_file_md5_at(int dir_fd, const char *filename, char *md5_string);
+
+/**
+ * Compute every configured digest of a file in one pass over its data
+ *
+ * @param dir_fd Directory descriptor the name is relative to
+ * @param filename File name
+ * @param digests Output digests, in the order of calc_md5_options_t.hashes
+ * @return 0 on success, -1 on error
+ */
+int calculate_file_digests_at(int dir_fd, const char *filename, calc_hash_digests_t *digests);
+
+// Set or query the options used by the file hashing functions
+void calc_md5_set_options(const calc_md5_options_t *options);
+void calc_md5_get_options(calc_md5_options_t *options);
+
+// Open a file for hashing relative to dir_fd, with O_DIRECT if configured
+int calc_md5_open_at(int dir_fd, const char *filename);
+
+// Ask the kernel to start reading the head of a file that will be hashed soon
+int calc_md5_prefetch_at(int dir_fd, const char *filename);
+
 // Convert MD5 digest to hex string
 void md5_to_string(const uint8_t digest[16], char *output);
 
@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include "compare_output.h"
+#include "../json_writer/json_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_STATUSES 8
+#define MIN_PATHS 16
+
+struct compare_output {
+    FILE *file;
+    json_writer_t *json;
+    char *file1_path;
+    char *file2_path;
+    char *description;
+    char *join;
+    char *total_key;
+    calc_hash_t hash;
+    char file2_key[32];     // "file2_" plus the algorithm name
+    char scan_time[32];
+    const char *const *statuses;
+    int status_count;
+    size_t total;
+    size_t counts[MAX_STATUSES];
+    int info_header;
+    off_t total_slot;
+    off_t count_slots[MAX_STATUSES];
+    size_t group_paths;     // Paths written on the current side of an open group
+};
+
+// Emit the comparison_info object; with reserve the counts are slots for patching
+static void write_info(compare_output_t *output, int reserve) {
+    json_writer_t *json = output->json;
+
+    json_writer_raw(json, "{");
+    json_writer_key(json, "comparison_time");
+    json_writer_string(json, output->scan_time);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "file1");
+    json_writer_string(json, output->file1_path);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "file2");
+    json_writer_string(json, output->file2_path);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "description");
+    json_writer_string(json, output->description);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "join");
+    json_writer_string(json, output->join);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "hash");
+    json_writer_string(json, calc_hash_name(output->hash));
+    json_writer_raw(json, ",");
+    json_writer_key(json, output->total_key);
+    if (reserve) output->total_slot = json_writer_reserve_number(json);
+    else json_writer_uint(json, output->total);
+    for (int i = 0; i < output->status_count; i++) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, output->statuses[i]);
+        if (reserve) output->count_slots[i] = json_writer_reserve_number(json);
+        else json_writer_uint(json, output->counts[i]);
+    }
+    json_writer_raw(json, "}");
+}
+
+static void free_output(compare_output_t *output) {
+    free(output->file1_path);
+    free(output->file2_path);
+    free(output->description);
+    free(output->join);
+    free(output->total_key);
+    free(output);
+}
+
+compare_output_t *compare_output_open(const char *path, const char *file1_path,
+                                      const char *file2_path, const char *description,
+                                      const char *join, calc_hash_t hash,
+                                      const char *total_key, const char *const *statuses) {
+    compare_output_t *output = calloc(1, sizeof(compare_output_t));
+    if (!output) return NULL;
+
+    output->file1_path = strdup(file1_path);
+    output->file2_path = strdup(file2_path);
+    output->description = strdup(description);
+    output->join = strdup(join);
+    output->total_key = strdup(total_key);
+    if (!output->file1_path || !output->file2_path || !output->description ||
+        !output->join || !output->total_key) {
+        free_output(output);
+        return NULL;
+    }
+
+    output->hash = hash;
+    snprintf(output->file2_key, sizeof(output->file2_key), "file2_%s", calc_hash_name(hash));
+    output->statuses = statuses;
+    while (statuses && statuses[output->status_count] && output->status_count < MAX_STATUSES) {
+        output->status_count++;
+    }
+
+    time_t now = time(NULL);
+    char *time_str = ctime(&now);
+    snprintf(output->scan_time, sizeof(output->scan_time), "%s", time_str ? time_str : "");
+    size_t length = strlen(output->scan_time);
+    if (length > 0 && output->scan_time[length - 1] == '\n') {
+        output->scan_time[length - 1] = '\0';
+    }
+
+    output->file = fopen(path, "w");
+    if (!output->file) {
+        fprintf(stderr, "Error: Cannot create output file %s\n", path);
+        free_output(output);
+        return NULL;
+    }
+    output->json = json_writer_create(output->file);
+    if (!output->json) {
+        fclose(output->file);
+        free_output(output);
+        return NULL;
+    }
+
+    output->info_header = json_writer_seekable(output->json);
+    json_writer_raw(output->json, "{\n");
+    if (output->info_header) {
+        json_writer_raw(output->json, "\t\"comparison_info\":\t");
+        write_info(output, 1);
+        json_writer_raw(output->json, ",\n");
+    }
+    json_writer_raw(output->json, "\t\"files\":\t[");
+    return output;
+}
+
+static void write_paths(json_writer_t *json, const char *const *paths, const size_t *lengths,
+                        size_t count) {
+    json_writer_raw(json, "[");
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) json_writer_raw(json, ",");
+        if (lengths) {
+            json_writer_string_body(json, paths[i], lengths[i]);
+        } else {
+            json_writer_string(json, paths[i]);
+        }
+    }
+    json_writer_raw(json, "]");
+}
+
+// Open a row with its digest member
+static void begin_row(compare_output_t *output, const char *digest) {
+    json_writer_t *json = output->json;
+
+    json_writer_raw(json, output->total ? ",\n\t\t{" : "\n\t\t{");
+    json_writer_key(json, calc_hash_name(output->hash));
+    json_writer_string(json, digest);
+}
+
+// Close a row with its status member and count it
+static void end_row(compare_output_t *output, const char *status) {
+    json_writer_t *json = output->json;
+
+    if (status) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, "status");
+        json_writer_string(json, status);
+
+        for (int i = 0; i < output->status_count; i++) {
+            if (strcmp(status, output->statuses[i]) == 0) {
+                output->counts[i]++;
+                break;
+            }
+        }
+    }
+    json_writer_raw(json, "}");
+    output->total++;
+}
+
+void compare_output_write(compare_output_t *output, const compare_record_t *record) {
+    json_writer_t *json = output->json;
+
+    begin_row(output, record->digest);
+    if (record->file2_digest) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, output->file2_key);
+        json_writer_string(json, record->file2_digest);
+    }
+    if (record->grouped) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, "file1_paths");
+        write_paths(json, record->file1_paths, record->file1_lengths, record->file1_count);
+        json_writer_raw(json, ",");
+        json_writer_key(json, "file2_paths");
+        write_paths(json, record->file2_paths, record->file2_lengths, record->file2_count);
+    } else {
+        json_writer_raw(json, ",");
+        json_writer_key(json, "file1_path");
+        json_writer_string(json, record->file1_path ? record->file1_path : "");
+        json_writer_raw(json, ",");
+        json_writer_key(json, "file2_path");
+        json_writer_string(json, record->file2_path ? record->file2_path : "");
+    }
+    end_row(output, record->status);
+}
+
+void compare_output_begin_group(compare_output_t *output, const char *digest) {
+    begin_row(output, digest);
+    json_writer_raw(output->json, ",");
+    json_writer_key(output->json, "file1_paths");
+    json_writer_raw(output->json, "[");
+    output->group_paths = 0;
+}
+
+void compare_output_group_path(compare_output_t *output, const char *path) {
+    if (output->group_paths++ > 0) json_writer_raw(output->json, ",");
+    json_writer_string(output->json, path);
+}
+
+void compare_output_group_side(compare_output_t *output) {
+    json_writer_raw(output->json, "],");
+    json_writer_key(output->json, "file2_paths");
+    json_writer_raw(output->json, "[");
+    output->group_paths = 0;
+}
+
+void compare_output_end_group(compare_output_t *output, const char *status) {
+    json_writer_raw(output->json, "]");
+    end_row(output, status);
+}
+
+size_t compare_output_count(const compare_output_t *output) {
+    return output->total;
+}
+
+int compare_output_close(compare_output_t *output) {
+    json_writer_t *json = output->json;
+    int result = 0;
+
+    json_writer_raw(json, output->total ? "\n\t]" : "]");
+    if (output->info_header) {
+        json_writer_raw(json, "\n}\n");
+        if (json_writer_patch_number(json, output->total_slot, output->total) != 0) {
+            result = -1;
+        }
+        for (int i = 0; i < output->status_count; i++) {
+            if (json_writer_patch_number(json, output->count_slots[i], output->counts[i]) != 0) {
+                result = -1;
+            }
+        }
+    } else {
+        json_writer_raw(json, ",\n\t\"comparison_info\":\t");
+        write_info(output, 0);
+        json_writer_raw(json, "\n}\n");
+    }
+
+    if (json_writer_finish(json) != 0) result = -1;
+    if (fclose(output->file) != 0) result = -1;
+    free_output(output);
+    return result;
+}
+
+int compare_paths_reserve(compare_paths_t *array, size_t count) {
+    if (count <= array->capacity && array->paths) return 0;
+
+    size_t capacity = array->capacity ? array->capacity : MIN_PATHS;
+    while (capacity < count) capacity *= 2;
+    const char **paths = realloc(array->paths, capacity * sizeof(const char *));
+    if (!paths) return -1;
+    array->paths = paths;
+    size_t *lengths = realloc(array->lengths, capacity * sizeof(size_t));
+    if (!lengths) return -1;
+    array->lengths = lengths;
+    array->capacity = capacity;
+    return 0;
+}
+
+void compare_paths_free(compare_paths_t *array) {
+    free(array->paths);
+    free(array->lengths);
+    array->paths = NULL;
+    array->lengths = NULL;
+    array->capacity = 0;
+}
+
+void compare_output_print_header(const char *title, const char *file1_path,
+                                 const char *file2_path, const char *diff_path,
+                                 const char *same_path) {
+    printf("%s:\n", title);
+    printf("  File 1: %s\n", file1_path);
+    printf("  File 2: %s\n", file2_path);
+    printf("  Diff output: %s\n", diff_path);
+    printf("  Same output: %s\n", same_path);
+    printf("\n");
+}
+
+int compare_output_open_digest(const char *diff_path, const char *same_path,
+                               const char *file1_path, const char *file2_path,
+                               const char *join, calc_hash_t hash,
+                               compare_output_t **diff, compare_output_t **same) {
+    static const char *const diff_statuses[] = {"only_in_file1", "only_in_file2", NULL};
+
+    *diff = compare_output_open(diff_path, file1_path, file2_path,
+                                "Files with different or unique digests",
+                                join, hash, "total_differences", diff_statuses);
+    *same = compare_output_open(same_path, file1_path, file2_path,
+                                "Files with matching digests",
+                                join, hash, "total_matches", NULL);
+    if (*diff && *same) return 0;
+
+    if (*diff) compare_output_close(*diff);
+    if (*same) compare_output_close(*same);
+    *diff = NULL;
+    *same = NULL;
+    return -1;
+}
+
+int compare_output_close_digest(compare_output_t *diff, compare_output_t *same,
+                                const char *diff_path, const char *same_path,
+                                size_t diff_files, size_t same_files, int result) {
+    calc_hash_t hash = diff ? diff->hash : CALC_HASH_MD5;
+    size_t diff_count = diff ? compare_output_count(diff) : 0;
+    size_t same_count = same ? compare_output_count(same) : 0;
+
+    if (diff && compare_output_close(diff) != 0) {
+        fprintf(stderr, "Error: Failed to write diff output file %s\n", diff_path);
+        result = -1;
+    }
+    if (same && compare_output_close(same) != 0) {
+        fprintf(stderr, "Error: Failed to write same output file %s\n", same_path);
+        result = -1;
+    }
+    if (result != 0) return -1;
+
+    printf("Comparison completed successfully!\n");
+    printf("Digests with same %s: %zu covering %zu files (saved to %s)\n",
+           calc_hash_name(hash), same_count, same_files, same_path);
+    printf("Digests with different/unique %s: %zu covering %zu files (saved to %s)\n",
+           calc_hash_name(hash), diff_count, diff_files, diff_path);
+    return 0;
+}
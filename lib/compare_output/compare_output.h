@@ -0,0 +1,142 @@
+#ifndef COMPARE_OUTPUT_H
+#define COMPARE_OUTPUT_H
+
+#include <stddef.h>
+#include "../calc_md5/calc_md5.h"
+
+// One row of diff.json/same.json; NULL members are left out
+typedef struct {
+    const char *digest;     // Written under the algorithm's name, e.g. "md5"
+    const char *file1_path;
+    const char *file2_path;
+    const char *status;
+    const char *file2_digest;   // Only set when the two sides differ in content
+    // Grouped rows list every path with the digest instead of one path per side
+    int grouped;
+    const char *const *file1_paths;
+    size_t file1_count;
+    const char *const *file2_paths;
+    size_t file2_count;
+    // If set, the grouped paths are views of escaped JSON text of these lengths
+    const size_t *file1_lengths;
+    const size_t *file2_lengths;
+} compare_record_t;
+
+typedef struct compare_output compare_output_t;
+
+// Reusable array of the paths of one group, for compare_record_t
+typedef struct {
+    const char **paths;
+    size_t *lengths;
+    size_t capacity;
+} compare_paths_t;
+
+/**
+ * Open a streamed comparison result file
+ *
+ * Rows are written as they are produced. comparison_info goes first with
+ * its counts patched in on close when the file is seekable, and last
+ * otherwise. Each row carries its digest under the name of the algorithm
+ * compared by ("md5", "sha256", ...), and file2's differing digest under
+ * "file2_" plus that name.
+ *
+ * @param path Output file
+ * @param file1_path First scan, recorded in comparison_info
+ * @param file2_path Second scan, recorded in comparison_info
+ * @param description Description recorded in comparison_info
+ * @param join Join strategy recorded in comparison_info
+ * @param hash Algorithm the scans were compared by, recorded in comparison_info
+ * @param total_key Name of the row count in comparison_info
+ * @param statuses NULL-terminated status names counted separately, or NULL
+ * @return Output or NULL on error
+ */
+compare_output_t *compare_output_open(const char *path, const char *file1_path,
+                                      const char *file2_path, const char *description,
+                                      const char *join, calc_hash_t hash,
+                                      const char *total_key, const char *const *statuses);
+
+// Append one row
+void compare_output_write(compare_output_t *output, const compare_record_t *record);
+
+/**
+ * Start a grouped row whose paths are streamed instead of passed as arrays
+ *
+ * Write file1's paths with compare_output_group_path(), switch to file2
+ * with compare_output_group_side(), then finish the row with
+ * compare_output_end_group(). Nothing is buffered, so a group may hold
+ * any number of paths.
+ *
+ * @param output Output to write to
+ * @param digest Hex digest of the group
+ */
+void compare_output_begin_group(compare_output_t *output, const char *digest);
+
+// Append a path to the current side of the open group
+void compare_output_group_path(compare_output_t *output, const char *path);
+
+// Close the open group's file1 paths and continue with file2's
+void compare_output_group_side(compare_output_t *output);
+
+// Finish the open group with its status
+void compare_output_end_group(compare_output_t *output, const char *status);
+
+// Number of rows written so far
+size_t compare_output_count(const compare_output_t *output);
+
+/**
+ * Finish comparison_info, close the file and free the output
+ *
+ * @param output Output to close
+ * @return 0 if everything was written, -1 otherwise
+ */
+int compare_output_close(compare_output_t *output);
+
+// Make room for count paths; returns 0, or -1 if out of memory
+int compare_paths_reserve(compare_paths_t *array, size_t count);
+
+void compare_paths_free(compare_paths_t *array);
+
+// Print the scans and outputs a join is about to compare, under title
+void compare_output_print_header(const char *title, const char *file1_path,
+                                 const char *file2_path, const char *diff_path,
+                                 const char *same_path);
+
+/**
+ * Open the diff and same outputs of a join by digest
+ *
+ * The diff rows are counted as only_in_file1 and only_in_file2.
+ *
+ * @param diff_path Output of digests found on one side only
+ * @param same_path Output of digests found on both sides
+ * @param file1_path First scan
+ * @param file2_path Second scan
+ * @param join Join strategy recorded in comparison_info
+ * @param hash Algorithm the scans are compared by
+ * @param diff Set to the diff output
+ * @param same Set to the same output
+ * @return 0 on success, -1 with neither output left open
+ */
+int compare_output_open_digest(const char *diff_path, const char *same_path,
+                               const char *file1_path, const char *file2_path,
+                               const char *join, calc_hash_t hash,
+                               compare_output_t **diff, compare_output_t **same);
+
+/**
+ * Close the outputs of a join by digest and print its summary
+ *
+ * The summary is only printed if the join and both writes succeeded.
+ *
+ * @param diff Diff output, or NULL if the join failed before opening it
+ * @param same Same output, or NULL likewise
+ * @param diff_path Diff output file, for messages
+ * @param same_path Same output file, for messages
+ * @param diff_files Paths listed in diff rows
+ * @param same_files Paths listed in same rows
+ * @param result 0 if the join itself succeeded
+ * @return 0 if the join succeeded and both outputs were written, -1 otherwise
+ */
+int compare_output_close_digest(compare_output_t *diff, compare_output_t *same,
+                                const char *diff_path, const char *same_path,
+                                size_t diff_files, size_t same_files, int result);
+
+#endif // COMPARE_OUTPUT_H
@@ -0,0 +1,396 @@
+#define _GNU_SOURCE
+#include "digest_table.h"
+#include "../scan_reader/scan_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CAPACITY 1024
+#define MIN_POSTINGS 1024
+#define MIN_POOL_SIZE (64 * 1024)
+
+// Slot with head == 0 is empty
+typedef struct {
+    unsigned char digest[DIGEST_SIZE];
+    uint32_t head;              // First posting index + 1
+    uint32_t tail;              // Last posting index + 1
+    uint32_t count;
+} digest_slot_t;
+
+typedef struct {
+    uint64_t path;              // Offset into the string pool or the view buffer
+    uint32_t length;
+    uint32_t next;              // Next posting index + 1, 0 at the end
+} posting_t;
+
+struct digest_table {
+    digest_slot_t *slots;
+    size_t capacity;            // Power of two
+    size_t entries;
+    posting_t *postings;
+    size_t posting_count;
+    size_t posting_capacity;
+    unsigned char (*order)[DIGEST_SIZE];    // Distinct digests by first insertion
+    size_t order_capacity;
+    char *pool;
+    const char *views;          // Path buffer of a view table, NULL if paths are pooled
+    size_t pool_used;
+    size_t pool_size;
+    size_t resizes;
+    uint64_t lookups;
+    uint64_t probes;
+    size_t max_probe;
+};
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int digest_from_hex(const char *hex, size_t size, unsigned char digest[DIGEST_SIZE]) {
+    return digest_from_hex_length(hex, strlen(hex), size, digest);
+}
+
+int digest_from_hex_length(const char *hex, size_t length, size_t size,
+                           unsigned char digest[DIGEST_SIZE]) {
+    if (size > DIGEST_SIZE || length != 2 * size) return -1;
+    for (size_t i = 0; i < size; i++) {
+        int high = hex_value(hex[2 * i]);
+        if (high < 0) return -1;
+        int low = hex_value(hex[2 * i + 1]);
+        if (low < 0) return -1;
+        digest[i] = (unsigned char)(high << 4 | low);
+    }
+    memset(digest + size, 0, DIGEST_SIZE - size);
+    return 0;
+}
+
+void digest_from_bytes(const unsigned char *bytes, size_t size, unsigned char digest[DIGEST_SIZE]) {
+    memcpy(digest, bytes, size);
+    memset(digest + size, 0, DIGEST_SIZE - size);
+}
+
+void digest_to_hex(const unsigned char digest[DIGEST_SIZE], size_t size,
+                   char hex[2 * DIGEST_SIZE + 1]) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0xf];
+    }
+    hex[2 * size] = '\0';
+}
+
+// Digests are already uniformly distributed, so their leading bytes are the hash
+static size_t digest_hash(const unsigned char digest[DIGEST_SIZE]) {
+    uint64_t hash;
+    memcpy(&hash, digest, sizeof(hash));
+    return (size_t)hash;
+}
+
+// Linear probe for a digest; returns its slot or the empty slot ending the run
+static digest_slot_t *probe(digest_table_t *table, const unsigned char digest[DIGEST_SIZE]) {
+    size_t mask = table->capacity - 1;
+    size_t index = digest_hash(digest) & mask;
+    size_t length = 1;
+
+    while (table->slots[index].head != 0 &&
+           memcmp(table->slots[index].digest, digest, DIGEST_SIZE) != 0) {
+        index = (index + 1) & mask;
+        length++;
+    }
+
+    table->lookups++;
+    table->probes += length;
+    if (length > table->max_probe) table->max_probe = length;
+    return &table->slots[index];
+}
+
+static int grow_slots(digest_table_t *table) {
+    size_t capacity = table->capacity * 2;
+    digest_slot_t *slots = calloc(capacity, sizeof(digest_slot_t));
+    if (!slots) return -1;
+
+    // Rehash without touching the probe counters
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i].head == 0) continue;
+        size_t index = digest_hash(table->slots[i].digest) & mask;
+        while (slots[index].head != 0) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    table->resizes++;
+    return 0;
+}
+
+// Make room for one more posting and, if needed, one more distinct digest
+static int reserve_entry(digest_table_t *table) {
+    if (table->posting_count >= UINT32_MAX - 1) return -1;
+
+    if (table->posting_count == table->posting_capacity) {
+        size_t capacity = table->posting_capacity * 2;
+        posting_t *postings = realloc(table->postings, capacity * sizeof(posting_t));
+        if (!postings) return -1;
+        table->postings = postings;
+        table->posting_capacity = capacity;
+    }
+
+    if (table->entries == table->order_capacity) {
+        size_t capacity = table->order_capacity * 2;
+        unsigned char (*order)[DIGEST_SIZE] = realloc(table->order, capacity * DIGEST_SIZE);
+        if (!order) return -1;
+        table->order = order;
+        table->order_capacity = capacity;
+    }
+    return 0;
+}
+
+// Append a path to the string pool, returning its offset or 0 on failure
+static uint64_t pool_add(digest_table_t *table, const char *path) {
+    size_t length = strlen(path) + 1;
+
+    if (length > table->pool_size - table->pool_used) {
+        size_t size = table->pool_size * 2;
+        while (length > size - table->pool_used) size *= 2;
+        char *pool = realloc(table->pool, size);
+        if (!pool) return 0;
+        table->pool = pool;
+        table->pool_size = size;
+    }
+
+    uint64_t offset = table->pool_used;
+    memcpy(table->pool + offset, path, length);
+    table->pool_used += length;
+    return offset;
+}
+
+digest_table_t *digest_table_create(size_t expected) {
+    digest_table_t *table = calloc(1, sizeof(digest_table_t));
+    if (!table) return NULL;
+
+    // Start at or below 50% load for the expected entry count
+    table->capacity = MIN_CAPACITY;
+    while (table->capacity < expected * 2) table->capacity *= 2;
+    table->posting_capacity = MIN_POSTINGS;
+    table->order_capacity = MIN_POSTINGS;
+
+    table->slots = calloc(table->capacity, sizeof(digest_slot_t));
+    table->postings = malloc(table->posting_capacity * sizeof(posting_t));
+    table->order = malloc(table->order_capacity * DIGEST_SIZE);
+    table->pool_size = MIN_POOL_SIZE;
+    table->pool = malloc(table->pool_size);
+    if (!table->slots || !table->postings || !table->order || !table->pool) {
+        digest_table_free(table);
+        return NULL;
+    }
+
+    table->pool[0] = '\0';
+    table->pool_used = 1;
+    return table;
+}
+
+digest_table_t *digest_table_create_view(size_t expected, const char *base) {
+    digest_table_t *table = digest_table_create(expected);
+    if (table) table->views = base;
+    return table;
+}
+
+void digest_table_free(digest_table_t *table) {
+    if (!table) return;
+    free(table->slots);
+    free(table->postings);
+    free(table->order);
+    free(table->pool);
+    free(table);
+}
+
+// Link a new posting for a path at offset into the digest's list
+static int add_posting(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                       uint64_t offset, uint32_t length) {
+    uint32_t index = (uint32_t)table->posting_count++;
+    table->postings[index].path = offset;
+    table->postings[index].length = length;
+    table->postings[index].next = 0;
+
+    digest_slot_t *slot = probe(table, digest);
+    if (slot->head == 0) {
+        memcpy(slot->digest, digest, DIGEST_SIZE);
+        slot->head = index + 1;
+        slot->count = 0;
+        memcpy(table->order[table->entries], digest, DIGEST_SIZE);
+        table->entries++;
+    } else {
+        table->postings[slot->tail - 1].next = index + 1;
+    }
+    slot->tail = index + 1;
+    slot->count++;
+    return 0;
+}
+
+// Keep the load factor at or below 70% and make room for one more posting
+static int prepare_insert(digest_table_t *table) {
+    if ((table->entries + 1) * 10 > table->capacity * 7 && grow_slots(table) != 0) {
+        return -1;
+    }
+    return reserve_entry(table);
+}
+
+int digest_table_insert(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                        const char *path) {
+    if (table->views || prepare_insert(table) != 0) return -1;
+
+    size_t length = strlen(path);
+    if (length > UINT32_MAX) return -1;
+    uint64_t offset = pool_add(table, path);
+    if (offset == 0) return -1;
+    return add_posting(table, digest, offset, (uint32_t)length);
+}
+
+int digest_table_insert_view(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                             uint64_t offset, uint32_t length) {
+    if (!table->views || prepare_insert(table) != 0) return -1;
+    return add_posting(table, digest, offset, length);
+}
+
+size_t digest_table_lookup(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                           digest_cursor_t *cursor) {
+    digest_slot_t *slot = probe(table, digest);
+    if (cursor) cursor->next = slot->head;
+    return slot->head ? slot->count : 0;
+}
+
+const char *digest_cursor_next(const digest_table_t *table, digest_cursor_t *cursor) {
+    if (cursor->next == 0) return NULL;
+
+    const posting_t *posting = &table->postings[cursor->next - 1];
+    cursor->next = posting->next;
+    return (table->views ? table->views : table->pool) + posting->path;
+}
+
+const char *digest_cursor_next_view(const digest_table_t *table, digest_cursor_t *cursor,
+                                    size_t *length) {
+    if (cursor->next == 0) return NULL;
+
+    const posting_t *posting = &table->postings[cursor->next - 1];
+    cursor->next = posting->next;
+    *length = posting->length;
+    return (table->views ? table->views : table->pool) + posting->path;
+}
+
+size_t digest_table_size(const digest_table_t *table) {
+    return table->entries;
+}
+
+const unsigned char *digest_table_digest(const digest_table_t *table, size_t index) {
+    return index < table->entries ? table->order[index] : NULL;
+}
+
+void digest_table_get_stats(const digest_table_t *table, digest_table_stats_t *stats) {
+    stats->entries = table->entries;
+    stats->postings = table->posting_count;
+    stats->capacity = table->capacity;
+    stats->resizes = table->resizes;
+    stats->lookups = table->lookups;
+    stats->probes = table->probes;
+    stats->max_probe = table->max_probe;
+    stats->pool_bytes = table->pool_used;
+}
+
+int digest_scan_open(digest_scan_t *scan, const char *filepath, calc_hash_t hash, int map) {
+    memset(scan, 0, sizeof(*scan));
+    scan->filepath = filepath;
+    scan->hash = hash;
+    scan->digest_size = calc_hash_digest_size(hash);
+    if (scan_bin_probe(filepath)) {
+        scan->bin = scan_bin_open(filepath);
+        return scan->bin ? 0 : -1;
+    }
+    if (map) scan->map = json_map_open(filepath);
+    return 0;
+}
+
+size_t digest_scan_count(const digest_scan_t *scan) {
+    return scan->bin ? scan_bin_count(scan->bin) : 0;
+}
+
+// Record callback for streamed scans
+static int scan_record(const scan_record_t *record, void *user_data) {
+    digest_scan_t *scan = (digest_scan_t *)user_data;
+    unsigned char digest[DIGEST_SIZE];
+
+    const char *hex = record->digests[scan->hash];
+    if (!hex || digest_from_hex(hex, scan->digest_size, digest) != 0) {
+        scan->skipped++;
+        return 0;
+    }
+    return scan->fn(digest, record->path, strlen(record->path), scan->user_data);
+}
+
+// Record callback for mapped scans: pass path views instead of copies
+static int scan_view_record(const json_map_t *map, const json_map_record_t *record,
+                            void *user_data) {
+    digest_scan_t *scan = (digest_scan_t *)user_data;
+    const json_member_t *path = json_map_member(map, record, "path");
+    const json_member_t *hex = json_map_member(map, record, calc_hash_name(scan->hash));
+    unsigned char digest[DIGEST_SIZE];
+
+    if (!path || !hex || path->kind != JSON_MAP_STRING || hex->kind != JSON_MAP_STRING) {
+        return 0;
+    }
+    if (hex->value.escaped ||
+        digest_from_hex_length(json_map_data(map) + hex->value.offset, hex->value.length,
+                               scan->digest_size, digest) != 0) {
+        scan->skipped++;
+        return 0;
+    }
+    return scan->fn(digest, json_map_data(map) + path->value.offset, path->value.length,
+                    scan->user_data);
+}
+
+// Record callback for binary scans, whose digests are already binary
+static int scan_bin_entry(const scan_bin_entry_t *entry, void *user_data) {
+    digest_scan_t *scan = (digest_scan_t *)user_data;
+    unsigned char digest[DIGEST_SIZE];
+
+    digest_from_bytes(entry->digest, SCAN_BIN_DIGEST_SIZE, digest);
+    return scan->fn(digest, entry->path, entry->path_length, scan->user_data);
+}
+
+int digest_scan_read(digest_scan_t *scan, digest_scan_fn fn, void *user_data) {
+    int result;
+
+    scan->fn = fn;
+    scan->user_data = user_data;
+    scan->skipped = 0;
+    if (scan->bin) {
+        // Front-coded paths are rebuilt record by record; the index is not needed after
+        result = scan_bin_read(scan->bin, scan_bin_entry, scan);
+        scan_bin_close(scan->bin);
+        scan->bin = NULL;
+    } else if (scan->map) {
+        result = json_map_records(scan->map, scan_view_record, scan);
+    } else {
+        result = scan_reader_read(scan->filepath, scan_record, scan);
+    }
+    if (result != 0) return -1;
+
+    if (scan->skipped > 0) {
+        fprintf(stderr, "Warning: Skipped %zu records with invalid %s in %s\n",
+                scan->skipped, calc_hash_name(scan->hash), scan->filepath);
+    }
+    return 0;
+}
+
+void digest_scan_close(digest_scan_t *scan) {
+    scan_bin_close(scan->bin);
+    json_map_close(scan->map);
+    scan->bin = NULL;
+    scan->map = NULL;
+}
@@ -0,0 +1,182 @@
+#ifndef DIGEST_TABLE_H
+#define DIGEST_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../calc_md5/calc_md5.h"
+#include "../scan_bin/scan_bin.h"
+#include "../json_map/json_map.h"
+
+// Keys hold the widest digest; shorter ones are zero-padded
+#define DIGEST_SIZE CALC_HASH_MAX_DIGEST_SIZE
+
+typedef struct digest_table digest_table_t;
+
+// Iterates the paths stored for one digest, in insertion order
+typedef struct {
+    uint32_t next;          // Posting index + 1, 0 at the end
+} digest_cursor_t;
+
+// Occupancy and probe-length counters of a table
+typedef struct {
+    size_t entries;             // Distinct digests
+    size_t postings;            // Paths over all digests
+    size_t capacity;
+    size_t resizes;
+    uint64_t lookups;           // Inserts and finds
+    uint64_t probes;            // Slots inspected by all lookups
+    size_t max_probe;           // Longest single lookup
+    size_t pool_bytes;          // Path string pool size
+} digest_table_stats_t;
+
+/**
+ * Parse a hex digest into its binary key
+ *
+ * @param hex Hex digits, either case
+ * @param size Digest size of the scan's algorithm; hex must have 2 * size digits
+ * @param digest Output key, zero-padded past size
+ * @return 0 on success, -1 if hex is not a valid digest of that size
+ */
+int digest_from_hex(const char *hex, size_t size, unsigned char digest[DIGEST_SIZE]);
+
+// As digest_from_hex() for a digest of length characters, not NUL-terminated
+int digest_from_hex_length(const char *hex, size_t length, size_t size,
+                           unsigned char digest[DIGEST_SIZE]);
+
+// Widen a binary digest of size bytes into a zero-padded key
+void digest_from_bytes(const unsigned char *bytes, size_t size, unsigned char digest[DIGEST_SIZE]);
+
+// Format the first size bytes of a key as lowercase hex plus terminator
+void digest_to_hex(const unsigned char digest[DIGEST_SIZE], size_t size,
+                   char hex[2 * DIGEST_SIZE + 1]);
+
+/**
+ * Create an open-addressing table keyed on binary digests
+ *
+ * Each digest maps to a posting list of every path inserted with it.
+ * Paths are copied into a single string pool and postings hold offsets
+ * into it, so an insert costs no per-entry allocation. The table doubles
+ * when its load factor would pass 70%.
+ *
+ * @param expected Expected number of distinct digests (0 if unknown)
+ * @return Table or NULL on error
+ */
+digest_table_t *digest_table_create(size_t expected);
+
+/**
+ * Create a table whose paths are views into an external buffer
+ *
+ * Paths are inserted with digest_table_insert_view() and never copied,
+ * so base (typically a mapped scan file) must outlive the table.
+ *
+ * @param expected Expected number of distinct digests (0 if unknown)
+ * @param base Buffer the path offsets refer to
+ * @return Table or NULL on error
+ */
+digest_table_t *digest_table_create_view(size_t expected, const char *base);
+
+void digest_table_free(digest_table_t *table);
+
+/**
+ * Append a path to a digest's posting list
+ *
+ * @param table Table to insert into
+ * @param digest Binary digest
+ * @param path Path associated with the digest
+ * @return 0 on success, -1 on allocation failure
+ */
+int digest_table_insert(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                        const char *path);
+
+/**
+ * Append a path view to a digest's posting list
+ *
+ * @param table Table from digest_table_create_view()
+ * @param digest Binary digest
+ * @param offset Offset of the path in the table's base buffer
+ * @param length Path length in bytes
+ * @return 0 on success, -1 on allocation failure
+ */
+int digest_table_insert_view(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                             uint64_t offset, uint32_t length);
+
+/**
+ * Look up the posting list of a digest
+ *
+ * @param table Table to search
+ * @param digest Binary digest
+ * @param cursor Set to the start of the list; may be NULL
+ * @return Number of paths stored for the digest, 0 if absent
+ */
+size_t digest_table_lookup(digest_table_t *table, const unsigned char digest[DIGEST_SIZE],
+                           digest_cursor_t *cursor);
+
+// Next path of a posting list, valid until the next insert, or NULL at the end
+const char *digest_cursor_next(const digest_table_t *table, digest_cursor_t *cursor);
+
+// As digest_cursor_next(), also giving the length; view paths are not NUL-terminated
+const char *digest_cursor_next_view(const digest_table_t *table, digest_cursor_t *cursor,
+                                    size_t *length);
+
+// Number of distinct digests
+size_t digest_table_size(const digest_table_t *table);
+
+// The index-th distinct digest, in order of first insertion
+const unsigned char *digest_table_digest(const digest_table_t *table, size_t index);
+
+void digest_table_get_stats(const digest_table_t *table, digest_table_stats_t *stats);
+
+/**
+ * Called for each record of a scan with its digest as a zero-padded key
+ *
+ * path is NUL-terminated and only valid during the call, except in a
+ * mapped scan, where it points into the mapping as length bytes of
+ * still JSON-escaped text.
+ */
+typedef int (*digest_scan_fn)(const unsigned char digest[DIGEST_SIZE], const char *path,
+                              size_t length, void *user_data);
+
+// A scan opened for a join by digest
+typedef struct {
+    const char *filepath;
+    calc_hash_t hash;       // Algorithm the scans are compared by
+    size_t digest_size;     // Its digest size in bytes
+    scan_bin_t *bin;        // Binary scan, until it is read
+    json_map_t *map;        // Mapped scan the paths point into, if any
+    size_t skipped;         // Records with a malformed digest
+    digest_scan_fn fn;
+    void *user_data;
+} digest_scan_t;
+
+/**
+ * Open a scan for a join by digest
+ *
+ * A binary scan is decoded record by record. A JSON or NDJSON scan is
+ * mapped when map is set and the file can be mapped, and streamed
+ * otherwise.
+ *
+ * @param scan Scan to initialize; safe to close even on failure
+ * @param filepath Scan file
+ * @param hash Algorithm to key the records on
+ * @param map Whether the scan may be mapped
+ * @return 0 on success, -1 on error
+ */
+int digest_scan_open(digest_scan_t *scan, const char *filepath, calc_hash_t hash, int map);
+
+// Records of a binary scan, 0 when the count is not known before reading
+size_t digest_scan_count(const digest_scan_t *scan);
+
+/**
+ * Pass every record of an opened scan to fn
+ *
+ * Records without a valid digest of the scan's algorithm are skipped
+ * with a single warning giving their number.
+ *
+ * @return 0 on success, -1 if the scan could not be read or fn failed
+ */
+int digest_scan_read(digest_scan_t *scan, digest_scan_fn fn, void *user_data);
+
+// Release the scan, including the mapping its paths point into
+void digest_scan_close(digest_scan_t *scan);
+
+#endif // DIGEST_TABLE_H
@@ -0,0 +1,553 @@
+#define _GNU_SOURCE
+#include "external_join.h"
+#include "../scan_reader/scan_reader.h"
+#include "../digest_table/digest_table.h"
+#include "../compare_output/compare_output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RUN_HEADER_SIZE (DIGEST_SIZE + 4)
+#define MIN_READ_BUFFER (16 * 1024)
+#define MAX_READ_BUFFER (1024 * 1024)
+#define MAX_FAN_IN 64
+
+// One buffered record of a run being built, keyed on its zero-padded digest
+typedef struct {
+    unsigned char digest[DIGEST_SIZE];
+    uint64_t path;          // Offset of the path in the run buffer
+    uint32_t length;
+    uint32_t unused;
+} run_entry_t;
+
+// Spilled runs of one scan, in scan order
+typedef struct {
+    char **names;
+    size_t count;
+    size_t capacity;
+} run_list_t;
+
+// Where runs go and how many were written
+typedef struct {
+    char *directory;
+    size_t next_run;        // Number of the next run file
+    size_t spilled;         // Runs cut from the input
+    size_t passes;          // Intermediate merges
+} spill_t;
+
+// Run generation for one scan: paths fill the buffer from the front and
+// entries from the back, and the run is spilled when the two would meet
+typedef struct {
+    spill_t *spill;
+    run_list_t *runs;
+    char *buffer;
+    size_t size;
+    size_t used;            // Path bytes at the front
+    size_t count;           // Entries at the back
+    size_t records;
+    int failed;             // Error already reported
+    calc_hash_t hash;       // Algorithm the scans are compared by
+} run_builder_t;
+
+// Sequential reader of one spilled run
+typedef struct {
+    FILE *file;
+    char *buffer;           // stdio buffer
+    const char *name;
+    size_t index;           // Position of the run, orders equal digests by scan
+    unsigned char digest[DIGEST_SIZE];
+    char *path;
+    size_t length;
+    size_t capacity;
+} run_reader_t;
+
+// k-way merge of runs, a binary heap of readers keyed on the current record
+typedef struct {
+    run_reader_t *readers;
+    run_reader_t **heap;
+    size_t count;           // Readers opened
+    size_t size;            // Readers with a current record
+} run_merge_t;
+
+// Digest order, then input order for equal digests
+static int compare_entries(const void *a, const void *b) {
+    const run_entry_t *entry_a = (const run_entry_t *)a;
+    const run_entry_t *entry_b = (const run_entry_t *)b;
+    int result = memcmp(entry_a->digest, entry_b->digest, DIGEST_SIZE);
+    if (result != 0) return result;
+    return entry_a->path < entry_b->path ? -1 : entry_a->path > entry_b->path;
+}
+
+// Reader buffer size when count files are open at once
+static size_t read_buffer_size(uint64_t mem_limit, size_t count) {
+    uint64_t size = mem_limit / (count + 1);
+    if (size < MIN_READ_BUFFER) size = MIN_READ_BUFFER;
+    if (size > MAX_READ_BUFFER) size = MAX_READ_BUFFER;
+    return (size_t)size;
+}
+
+// Most runs merged at once, leaving a minimal buffer for every reader and the writer
+static size_t fan_in(uint64_t mem_limit) {
+    uint64_t readers = mem_limit / MIN_READ_BUFFER - 1;
+    return readers < MAX_FAN_IN ? (size_t)readers : MAX_FAN_IN;
+}
+
+static char *create_spill_directory(const char *temp_dir) {
+    if (!temp_dir) temp_dir = getenv("TMPDIR");
+    if (!temp_dir || temp_dir[0] == '\0') temp_dir = "/tmp";
+
+    size_t length = strlen(temp_dir) + sizeof("/md5_scanner.XXXXXX");
+    char *directory = malloc(length);
+    if (!directory) return NULL;
+    snprintf(directory, length, "%s/md5_scanner.XXXXXX", temp_dir);
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "Error: Cannot create temporary directory in %s\n", temp_dir);
+        free(directory);
+        return NULL;
+    }
+    return directory;
+}
+
+static char *next_run_name(spill_t *spill) {
+    size_t length = strlen(spill->directory) + 32;
+    char *name = malloc(length);
+    if (name) snprintf(name, length, "%s/run-%zu", spill->directory, spill->next_run++);
+    return name;
+}
+
+static void free_runs(run_list_t *runs) {
+    for (size_t i = 0; i < runs->count; i++) {
+        unlink(runs->names[i]);
+        free(runs->names[i]);
+    }
+    free(runs->names);
+    runs->names = NULL;
+    runs->count = 0;
+    runs->capacity = 0;
+}
+
+static int append_run(run_list_t *runs, char *name) {
+    if (runs->count == runs->capacity) {
+        size_t capacity = runs->capacity ? runs->capacity * 2 : 16;
+        char **names = realloc(runs->names, capacity * sizeof(char *));
+        if (!names) return -1;
+        runs->names = names;
+        runs->capacity = capacity;
+    }
+    runs->names[runs->count++] = name;
+    return 0;
+}
+
+static int write_record(FILE *file, const unsigned char digest[DIGEST_SIZE], const char *path,
+                        uint32_t length) {
+    unsigned char header[RUN_HEADER_SIZE];
+    memcpy(header, digest, DIGEST_SIZE);
+    for (int i = 0; i < 4; i++) header[DIGEST_SIZE + i] = (unsigned char)(length >> (8 * i));
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) return -1;
+    if (length > 0 && fwrite(path, 1, length, file) != length) return -1;
+    return 0;
+}
+
+// Open a new run file for writing with a buffer of buffer_size bytes
+static FILE *create_run(spill_t *spill, char **name, char **buffer, size_t buffer_size) {
+    *name = next_run_name(spill);
+    *buffer = *name ? malloc(buffer_size) : NULL;
+    FILE *file = *buffer ? fopen(*name, "wb") : NULL;
+    if (!file) {
+        if (*name) fprintf(stderr, "Error: Cannot create run file %s\n", *name);
+        free(*name);
+        free(*buffer);
+        return NULL;
+    }
+    setvbuf(file, *buffer, _IOFBF, buffer_size);
+    return file;
+}
+
+// Close a run opened by create_run(); on failure the file is removed
+static int finish_run(FILE *file, char *name, char *buffer, int result) {
+    if (ferror(file)) result = -1;
+    if (fclose(file) != 0) result = -1;
+    free(buffer);
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to write run file %s\n", name);
+        unlink(name);
+    }
+    return result;
+}
+
+// Sort the buffered records and write them out as the next run
+static int spill_run(run_builder_t *builder) {
+    run_entry_t *entries = (run_entry_t *)(builder->buffer + builder->size) - builder->count;
+    qsort(entries, builder->count, sizeof(run_entry_t), compare_entries);
+
+    char *name;
+    char *buffer;
+    FILE *file = create_run(builder->spill, &name, &buffer, MIN_READ_BUFFER);
+    if (!file) return -1;
+
+    int result = 0;
+    for (size_t i = 0; i < builder->count && result == 0; i++) {
+        result = write_record(file, entries[i].digest, builder->buffer + entries[i].path,
+                              entries[i].length);
+    }
+    if (finish_run(file, name, buffer, result) != 0 || append_run(builder->runs, name) != 0) {
+        unlink(name);
+        free(name);
+        return -1;
+    }
+
+    builder->spill->spilled++;
+    builder->used = 0;
+    builder->count = 0;
+    return 0;
+}
+
+// Record callback: buffer one record, spilling the run when the buffer is full
+static int add_path(const unsigned char digest[DIGEST_SIZE], const char *path, size_t length,
+                    void *user_data) {
+    run_builder_t *builder = (run_builder_t *)user_data;
+    size_t needed = length + sizeof(run_entry_t);
+
+    if (length > UINT32_MAX || needed > builder->size) {
+        fprintf(stderr, "Error: A path of %zu bytes does not fit in the memory limit\n", length);
+        builder->failed = 1;
+        return -1;
+    }
+    if (needed > builder->size - builder->used - builder->count * sizeof(run_entry_t)) {
+        if (spill_run(builder) != 0) {
+            builder->failed = 1;
+            return -1;
+        }
+    }
+
+    memcpy(builder->buffer + builder->used, path, length);
+    run_entry_t *entry = (run_entry_t *)(builder->buffer + builder->size) - ++builder->count;
+    memcpy(entry->digest, digest, DIGEST_SIZE);
+    entry->path = builder->used;
+    entry->length = (uint32_t)length;
+    entry->unused = 0;
+    builder->used += length;
+    builder->records++;
+    return 0;
+}
+
+// Cut one scan into sorted runs; paths are copied, so the scan is never mapped
+static int build_runs(const char *filepath, run_builder_t *builder) {
+    digest_scan_t scan;
+    int result = digest_scan_open(&scan, filepath, builder->hash, 0);
+
+    if (result == 0) result = digest_scan_read(&scan, add_path, builder);
+    digest_scan_close(&scan);
+    if (result == 0 && builder->count > 0) {
+        result = spill_run(builder);
+    }
+    if (result != 0) {
+        if (!builder->failed) fprintf(stderr, "Error: Failed to load %s\n", filepath);
+        return -1;
+    }
+    return 0;
+}
+
+// Read the next record of a run: 1 if read, 0 at the end, -1 on error
+static int reader_next(run_reader_t *reader) {
+    unsigned char header[RUN_HEADER_SIZE];
+    size_t got = fread(header, 1, sizeof(header), reader->file);
+
+    if (got == 0 && feof(reader->file)) return 0;
+    if (got != sizeof(header)) return -1;
+
+    memcpy(reader->digest, header, DIGEST_SIZE);
+    reader->length = 0;
+    for (int i = 3; i >= 0; i--) reader->length = (reader->length << 8) | header[DIGEST_SIZE + i];
+    if (reader->length + 1 > reader->capacity) {
+        size_t capacity = reader->capacity ? reader->capacity : 256;
+        while (capacity < reader->length + 1) capacity *= 2;
+        char *path = realloc(reader->path, capacity);
+        if (!path) return -1;
+        reader->path = path;
+        reader->capacity = capacity;
+    }
+    if (fread(reader->path, 1, reader->length, reader->file) != reader->length) return -1;
+    reader->path[reader->length] = '\0';
+    return 1;
+}
+
+static int reader_before(const run_reader_t *a, const run_reader_t *b) {
+    int order = memcmp(a->digest, b->digest, DIGEST_SIZE);
+    return order < 0 || (order == 0 && a->index < b->index);
+}
+
+static void sift_down(run_merge_t *merge, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < merge->size && reader_before(merge->heap[left], merge->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < merge->size && reader_before(merge->heap[right], merge->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) return;
+        run_reader_t *swap = merge->heap[i];
+        merge->heap[i] = merge->heap[smallest];
+        merge->heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void merge_close(run_merge_t *merge) {
+    for (size_t i = 0; i < merge->count; i++) {
+        if (merge->readers[i].file) fclose(merge->readers[i].file);
+        free(merge->readers[i].buffer);
+        free(merge->readers[i].path);
+    }
+    free(merge->readers);
+    free(merge->heap);
+    memset(merge, 0, sizeof(*merge));
+}
+
+static int merge_open(run_merge_t *merge, char *const *names, size_t count, size_t buffer_size) {
+    memset(merge, 0, sizeof(*merge));
+    if (count == 0) return 0;
+    merge->readers = calloc(count, sizeof(run_reader_t));
+    merge->heap = calloc(count, sizeof(run_reader_t *));
+    if (!merge->readers || !merge->heap) {
+        free(merge->readers);
+        free(merge->heap);
+        merge->readers = NULL;
+        merge->heap = NULL;
+        return -1;
+    }
+    merge->count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        run_reader_t *reader = &merge->readers[i];
+        reader->name = names[i];
+        reader->index = i;
+        reader->buffer = malloc(buffer_size);
+        reader->file = reader->buffer ? fopen(names[i], "rb") : NULL;
+        if (!reader->file) {
+            fprintf(stderr, "Error: Cannot open run file %s\n", names[i]);
+            merge_close(merge);
+            return -1;
+        }
+        setvbuf(reader->file, reader->buffer, _IOFBF, buffer_size);
+
+        int status = reader_next(reader);
+        if (status < 0) {
+            fprintf(stderr, "Error: Failed to read run file %s\n", names[i]);
+            merge_close(merge);
+            return -1;
+        }
+        if (status > 0) merge->heap[merge->size++] = reader;
+    }
+    for (size_t i = merge->size / 2; i-- > 0;) sift_down(merge, i);
+    return 0;
+}
+
+// Reader holding the smallest record, NULL once every run is consumed
+static const run_reader_t *merge_top(const run_merge_t *merge) {
+    return merge->size > 0 ? merge->heap[0] : NULL;
+}
+
+// Move past the smallest record
+static int merge_advance(run_merge_t *merge) {
+    run_reader_t *reader = merge->heap[0];
+    int status = reader_next(reader);
+    if (status < 0) {
+        fprintf(stderr, "Error: Failed to read run file %s\n", reader->name);
+        return -1;
+    }
+    if (status == 0) merge->heap[0] = merge->heap[--merge->size];
+    sift_down(merge, 0);
+    return 0;
+}
+
+// Replace the first count runs of a side with one run merged from them
+static int merge_runs(spill_t *spill, run_list_t *runs, size_t count, uint64_t mem_limit) {
+    size_t buffer_size = read_buffer_size(mem_limit, count);
+    run_merge_t merge;
+    if (merge_open(&merge, runs->names, count, buffer_size) != 0) return -1;
+
+    char *name;
+    char *buffer;
+    FILE *file = create_run(spill, &name, &buffer, buffer_size);
+    if (!file) {
+        merge_close(&merge);
+        return -1;
+    }
+
+    int result = 0;
+    const run_reader_t *top;
+    while (result == 0 && (top = merge_top(&merge)) != NULL) {
+        result = write_record(file, top->digest, top->path, (uint32_t)top->length);
+        if (result == 0) result = merge_advance(&merge);
+    }
+    merge_close(&merge);
+    if (finish_run(file, name, buffer, result) != 0) {
+        free(name);
+        return -1;
+    }
+
+    // The merged run holds the oldest records, so it takes their place at the front
+    for (size_t i = 0; i < count; i++) {
+        unlink(runs->names[i]);
+        free(runs->names[i]);
+    }
+    runs->names[0] = name;
+    memmove(runs->names + 1, runs->names + count, (runs->count - count) * sizeof(char *));
+    runs->count -= count - 1;
+    spill->passes++;
+    return 0;
+}
+
+// Stream the paths of one digest from a side into the open group
+static int write_group_paths(run_merge_t *merge, compare_output_t *output,
+                             const unsigned char digest[DIGEST_SIZE], size_t *count) {
+    const run_reader_t *top;
+    while ((top = merge_top(merge)) != NULL && memcmp(top->digest, digest, DIGEST_SIZE) == 0) {
+        compare_output_group_path(output, top->path);
+        (*count)++;
+        if (merge_advance(merge) != 0) return -1;
+    }
+    return 0;
+}
+
+// Merge-join the runs of both sides into the outputs
+static int join_runs(run_list_t *runs1, run_list_t *runs2, uint64_t mem_limit,
+                     size_t digest_size, compare_output_t *diff, compare_output_t *same,
+                     size_t *same_files, size_t *diff_files) {
+    size_t buffer_size = read_buffer_size(mem_limit, runs1->count + runs2->count);
+    run_merge_t merge1;
+    run_merge_t merge2;
+    if (merge_open(&merge1, runs1->names, runs1->count, buffer_size) != 0) return -1;
+    if (merge_open(&merge2, runs2->names, runs2->count, buffer_size) != 0) {
+        merge_close(&merge1);
+        return -1;
+    }
+
+    int result = 0;
+    char hex[2 * DIGEST_SIZE + 1];
+    for (;;) {
+        const run_reader_t *top1 = merge_top(&merge1);
+        const run_reader_t *top2 = merge_top(&merge2);
+        if (!top1 && !top2) break;
+
+        int order = !top1 ? 1 : !top2 ? -1 : memcmp(top1->digest, top2->digest, DIGEST_SIZE);
+        // The readers advance while their paths are written, so keep a copy
+        unsigned char digest[DIGEST_SIZE];
+        memcpy(digest, order <= 0 ? top1->digest : top2->digest, DIGEST_SIZE);
+        digest_to_hex(digest, digest_size, hex);
+
+        compare_output_t *output = order == 0 ? same : diff;
+        size_t count1 = 0;
+        size_t count2 = 0;
+        compare_output_begin_group(output, hex);
+        if (order <= 0 && write_group_paths(&merge1, output, digest, &count1) != 0) {
+            result = -1;
+            break;
+        }
+        compare_output_group_side(output);
+        if (order >= 0 && write_group_paths(&merge2, output, digest, &count2) != 0) {
+            result = -1;
+            break;
+        }
+
+        if (order == 0) {
+            compare_output_end_group(output, "same");
+            *same_files += count1 + count2;
+        } else {
+            compare_output_end_group(output, order < 0 ? "only_in_file1" : "only_in_file2");
+            *diff_files += count1 + count2;
+        }
+    }
+
+    merge_close(&merge1);
+    merge_close(&merge2);
+    return result;
+}
+
+int compare_scan_digests_external(const char *file1_path, const char *file2_path,
+                                  const char *diff_output_path,
+                                  const char *same_output_path,
+                                  uint64_t mem_limit, const char *temp_dir) {
+    if (!file1_path || !file2_path || !diff_output_path || !same_output_path) {
+        fprintf(stderr, "Error: Invalid parameters\n");
+        return -1;
+    }
+    if (mem_limit < EXTERNAL_JOIN_MIN_MEM_LIMIT) mem_limit = EXTERNAL_JOIN_MIN_MEM_LIMIT;
+    if (mem_limit > SIZE_MAX / 2) mem_limit = SIZE_MAX / 2;
+
+    calc_hash_t hash;
+    if (scan_reader_check_hash(file1_path, file2_path, &hash) != 0) {
+        return -1;
+    }
+
+    compare_output_print_header("Comparing scans by external merge", file1_path, file2_path,
+                                diff_output_path, same_output_path);
+
+    spill_t spill = {NULL, 0, 0, 0};
+    spill.directory = create_spill_directory(temp_dir);
+    if (!spill.directory) return -1;
+
+    // Run generation: one side at a time through the same buffer
+    run_list_t runs1 = {NULL, 0, 0};
+    run_list_t runs2 = {NULL, 0, 0};
+    run_builder_t builder1;
+    run_builder_t builder2;
+    memset(&builder1, 0, sizeof(builder1));
+    memset(&builder2, 0, sizeof(builder2));
+    builder1.spill = &spill;
+    builder1.runs = &runs1;
+    builder1.hash = hash;
+    builder1.size = (size_t)mem_limit / sizeof(run_entry_t) * sizeof(run_entry_t);
+    builder1.buffer = malloc(builder1.size);
+    builder2 = builder1;
+    builder2.runs = &runs2;
+
+    int result = -1;
+    if (!builder1.buffer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+    } else if (build_runs(file1_path, &builder1) == 0 && build_runs(file2_path, &builder2) == 0) {
+        result = 0;
+    }
+    free(builder1.buffer);
+    size_t spilled = spill.spilled;
+
+    // Merge passes until both sides can be read at once
+    size_t limit = fan_in(mem_limit);
+    while (result == 0 && runs1.count + runs2.count > limit) {
+        run_list_t *runs = runs1.count >= runs2.count ? &runs1 : &runs2;
+        result = merge_runs(&spill, runs, runs->count < limit ? runs->count : limit, mem_limit);
+    }
+
+    compare_output_t *diff = NULL;
+    compare_output_t *same = NULL;
+    if (result == 0) {
+        result = compare_output_open_digest(diff_output_path, same_output_path, file1_path,
+                                            file2_path, "external", hash, &diff, &same);
+    }
+
+    size_t same_files = 0;
+    size_t diff_files = 0;
+    if (result == 0) {
+        result = join_runs(&runs1, &runs2, mem_limit, calc_hash_digest_size(hash), diff, same,
+                           &same_files, &diff_files);
+    }
+    result = compare_output_close_digest(diff, same, diff_output_path, same_output_path,
+                                         diff_files, same_files, result);
+
+    free_runs(&runs1);
+    free_runs(&runs2);
+    rmdir(spill.directory);
+    free(spill.directory);
+
+    if (result == 0) {
+        printf("External merge: %zu + %zu records in %zu runs, %zu merge pass%s, %llu byte limit\n",
+               builder1.records, builder2.records, spilled, spill.passes,
+               spill.passes == 1 ? "" : "es", (unsigned long long)mem_limit);
+    }
+    return result;
+}
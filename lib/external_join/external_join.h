@@ -0,0 +1,35 @@
+#ifndef EXTERNAL_JOIN_H
+#define EXTERNAL_JOIN_H
+
+#include <stdint.h>
+
+// Smallest memory budget the external join accepts
+#define EXTERNAL_JOIN_MIN_MEM_LIMIT (1024 * 1024)
+
+/**
+ * Compare two scans by digest with bounded memory
+ *
+ * Each scan is streamed once and cut into runs that fit in mem_limit
+ * bytes; every run is sorted by digest and spilled to a private directory
+ * under temp_dir. The runs of each side are then merged k ways, in extra
+ * passes when there are more runs than the merge can read at once, and
+ * the two merged streams are joined in one linear pass. The rows are the
+ * same as compare_json_files() writes ("same", "only_in_file1",
+ * "only_in_file2"), in digest order, with the paths of a digest in scan
+ * order. Paths are streamed into the output, so no group is held in memory.
+ *
+ * @param file1_path Path to the first scan file
+ * @param file2_path Path to the second scan file
+ * @param diff_output_path Output path for digests found on one side only
+ * @param same_output_path Output path for digests found on both sides
+ * @param mem_limit Memory budget in bytes for sorting and merging, at least
+ *                  EXTERNAL_JOIN_MIN_MEM_LIMIT
+ * @param temp_dir Directory for spilled runs, or NULL for $TMPDIR or /tmp
+ * @return 0 on success, -1 on error
+ */
+int compare_scan_digests_external(const char *file1_path, const char *file2_path,
+                                  const char *diff_output_path,
+                                  const char *same_output_path,
+                                  uint64_t mem_limit, const char *temp_dir);
+
+#endif // EXTERNAL_JOIN_H
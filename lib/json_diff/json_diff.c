@@ -1,89 +1,28 @@
 #define _GNU_SOURCE
 #include "json_diff.h"
+#include "../scan_reader/scan_reader.h"
+#include "../json_map/json_map.h"
+#include "../digest_table/digest_table.h"
+#include "../compare_output/compare_output.h"
+#include "../external_join/external_join.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
-#define HASH_MAP_SIZE 1024
+// A scan indexed by digest
+typedef struct {
+    digest_table_t *table;
+    digest_scan_t scan;     // Holds the mapping the table's paths point into, if any
+} digest_index_t;
 
-static unsigned int hash_function(const char *str) {
-    unsigned int hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c;
-    }
-    return hash % HASH_MAP_SIZE;
-}
-
-hash_map_t *create_hash_map(int size) {
-    hash_map_t *map = malloc(sizeof(hash_map_t));
-    if (!map) return NULL;
-    
-    map->size = size;
-    map->buckets = calloc(size, sizeof(hash_entry_t*));
-    if (!map->buckets) {
-        free(map);
-        return NULL;
-    }
-    
-    return map;
-}
-
-void free_hash_map(hash_map_t *map) {
-    if (!map) return;
-    
-    for (int i = 0; i < map->size; i++) {
-        hash_entry_t *entry = map->buckets[i];
-        while (entry) {
-            hash_entry_t *next = entry->next;
-            free(entry->md5);
-            free(entry->path);
-            free(entry);
-            entry = next;
-        }
-    }
-    
-    free(map->buckets);
-    free(map);
-}
+static json_diff_options_t diff_options = {0, NULL};
 
-int hash_map_insert(hash_map_t *map, const char *md5, const char *path) {
-    if (!map || !md5 || !path) return -1;
-    
-    unsigned int index = hash_function(md5);
-    hash_entry_t *entry = malloc(sizeof(hash_entry_t));
-    if (!entry) return -1;
-    
-    entry->md5 = strdup(md5);
-    entry->path = strdup(path);
-    if (!entry->md5 || !entry->path) {
-        free(entry->md5);
-        free(entry->path);
-        free(entry);
-        return -1;
-    }
-    
-    entry->next = map->buckets[index];
-    map->buckets[index] = entry;
-    
-    return 0;
+void json_diff_set_options(const json_diff_options_t *options) {
+    diff_options = *options;
 }
 
-hash_entry_t *hash_map_find(hash_map_t *map, const char *md5) {
-    if (!map || !md5) return NULL;
-    
-    unsigned int index = hash_function(md5);
-    hash_entry_t *entry = map->buckets[index];
-    
-    while (entry) {
-        if (strcmp(entry->md5, md5) == 0) {
-            return entry;
-        }
-        entry = entry->next;
-    }
-    
-    return NULL;
+void json_diff_get_options(json_diff_options_t *options) {
+    *options = diff_options;
 }
 
 cJSON *load_json_file(const char *filepath) {
@@ -132,236 +71,184 @@ cJSON *load_json_file(const char *filepath) {
     return json;
 }
 
-int compare_json_files(const char *file1_path, const char *file2_path, 
-                      const char *diff_output_path, const char *same_output_path) {
-    if (!file1_path || !file2_path || !diff_output_path || !same_output_path) {
-        fprintf(stderr, "Error: Invalid parameters\n");
+// Record callback: index a scan's files by digest
+static int index_path(const unsigned char digest[DIGEST_SIZE], const char *path, size_t length,
+                      void *user_data) {
+    digest_index_t *index = (digest_index_t *)user_data;
+    json_map_t *map = index->scan.map;
+    int result;
+    
+    if (map) {
+        // Mapped paths are indexed as views, never copied
+        result = digest_table_insert_view(index->table, digest,
+                                          (uint64_t)(path - json_map_data(map)), (uint32_t)length);
+    } else {
+        result = digest_table_insert(index->table, digest, path);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to index a record of %s\n", index->scan.filepath);
         return -1;
     }
-    
-    printf("Comparing JSON files:\n");
-    printf("  File 1: %s\n", file1_path);
-    printf("  File 2: %s\n", file2_path);
-    printf("  Diff output: %s\n", diff_output_path);
-    printf("  Same output: %s\n", same_output_path);
-    printf("\n");
-    
-    // Load both JSON files
-    cJSON *json1 = load_json_file(file1_path);
-    if (!json1) return -1;
-    
-    cJSON *json2 = load_json_file(file2_path);
-    if (!json2) {
-        cJSON_Delete(json1);
+    return 0;
+}
+
+static void free_index(digest_index_t *index) {
+    digest_table_free(index->table);
+    digest_scan_close(&index->scan);
+}
+
+// Map the scan if possible so paths stay in place; stream it otherwise
+static int load_index(const char *filepath, calc_hash_t hash, digest_index_t *index) {
+    if (digest_scan_open(&index->scan, filepath, hash, 1) != 0) return -1;
+    if (index->scan.map) {
+        index->table = digest_table_create_view(0, json_map_data(index->scan.map));
+    } else {
+        index->table = digest_table_create(digest_scan_count(&index->scan));
+    }
+    if (!index->table) {
+        fprintf(stderr, "Error: Failed to create digest index\n");
         return -1;
     }
+    return digest_scan_read(&index->scan, index_path, index);
+}
+
+// Collect a posting list into a reusable path array
+static const char *const *collect_paths(digest_table_t *table, const unsigned char *digest,
+                                        compare_paths_t *array, size_t *count) {
+    digest_cursor_t cursor;
+    *count = digest_table_lookup(table, digest, &cursor);
+    if (compare_paths_reserve(array, *count) != 0) return NULL;
     
-    // Get files arrays
-    cJSON *files1 = cJSON_GetObjectItem(json1, "files");
-    cJSON *files2 = cJSON_GetObjectItem(json2, "files");
-    
-    if (!cJSON_IsArray(files1) || !cJSON_IsArray(files2)) {
-        fprintf(stderr, "Error: Invalid JSON structure - 'files' array not found\n");
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
-        return -1;
+    for (size_t i = 0; i < *count; i++) {
+        array->paths[i] = digest_cursor_next_view(table, &cursor, &array->lengths[i]);
     }
-    
-    // Create hash map for file2 for quick lookup
-    hash_map_t *map2 = create_hash_map(HASH_MAP_SIZE);
-    if (!map2) {
-        fprintf(stderr, "Error: Failed to create hash map\n");
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
+    return array->paths;
+}
+
+static void print_index_stats(const char *name, const digest_table_t *table) {
+    digest_table_stats_t stats;
+    digest_table_get_stats(table, &stats);
+    printf("Digest index (%s): %zu digests / %zu paths in %zu slots, %.2f avg / %zu max probes\n",
+           name, stats.entries, stats.postings, stats.capacity,
+           stats.lookups ? (double)stats.probes / (double)stats.lookups : 0.0,
+           stats.max_probe);
+}
+
+int compare_json_files(const char *file1_path, const char *file2_path, 
+                      const char *diff_output_path, const char *same_output_path) {
+    if (!file1_path || !file2_path || !diff_output_path || !same_output_path) {
+        fprintf(stderr, "Error: Invalid parameters\n");
         return -1;
     }
-    
-    // Populate hash map with file2 data
-    cJSON *file_item = NULL;
-    cJSON_ArrayForEach(file_item, files2) {
-        cJSON *path_item = cJSON_GetObjectItem(file_item, "path");
-        cJSON *md5_item = cJSON_GetObjectItem(file_item, "md5");
-        
-        if (cJSON_IsString(path_item) && cJSON_IsString(md5_item)) {
-            hash_map_insert(map2, md5_item->valuestring, path_item->valuestring);
-        }
+    if (diff_options.mem_limit > 0) {
+        return compare_scan_digests_external(file1_path, file2_path, diff_output_path,
+                                             same_output_path, diff_options.mem_limit,
+                                             diff_options.temp_dir);
     }
     
-    // Create output JSON structures
-    cJSON *diff_root = cJSON_CreateObject();
-    cJSON *same_root = cJSON_CreateObject();
-    cJSON *diff_info = cJSON_CreateObject();
-    cJSON *same_info = cJSON_CreateObject();
-    cJSON *diff_files = cJSON_CreateArray();
-    cJSON *same_files = cJSON_CreateArray();
-    
-    // Add metadata
-    time_t now = time(NULL);
-    char *time_str = ctime(&now);
-    if (time_str && strlen(time_str) > 0) {
-        time_str[strlen(time_str) - 1] = '\0';
+    calc_hash_t hash;
+    if (scan_reader_check_hash(file1_path, file2_path, &hash) != 0) {
+        return -1;
     }
     
-    cJSON_AddStringToObject(diff_info, "comparison_time", time_str);
-    cJSON_AddStringToObject(diff_info, "file1", file1_path);
-    cJSON_AddStringToObject(diff_info, "file2", file2_path);
-    cJSON_AddStringToObject(diff_info, "description", "Files with different or unique MD5 hashes");
-    
-    cJSON_AddStringToObject(same_info, "comparison_time", time_str);
-    cJSON_AddStringToObject(same_info, "file1", file1_path);
-    cJSON_AddStringToObject(same_info, "file2", file2_path);
-    cJSON_AddStringToObject(same_info, "description", "Files with matching MD5 hashes");
-    
-    cJSON_AddItemToObject(diff_root, "comparison_info", diff_info);
-    cJSON_AddItemToObject(diff_root, "files", diff_files);
-    cJSON_AddItemToObject(same_root, "comparison_info", same_info);
-    cJSON_AddItemToObject(same_root, "files", same_files);
-    
-    int same_count = 0;
-    int diff_count = 0;
+    compare_output_print_header("Comparing JSON files", file1_path, file2_path,
+                                diff_output_path, same_output_path);
     
-    // Process files from file1
-    cJSON_ArrayForEach(file_item, files1) {
-        cJSON *path_item = cJSON_GetObjectItem(file_item, "path");
-        cJSON *md5_item = cJSON_GetObjectItem(file_item, "md5");
-        
-        if (cJSON_IsString(path_item) && cJSON_IsString(md5_item)) {
-            const char *path1 = path_item->valuestring;
-            const char *md5 = md5_item->valuestring;
-            
-            hash_entry_t *found = hash_map_find(map2, md5);
-            if (found) {
-                // Same hash found in both files
-                cJSON *same_obj = cJSON_CreateObject();
-                cJSON_AddStringToObject(same_obj, "md5", md5);
-                cJSON_AddStringToObject(same_obj, "file1_path", path1);
-                cJSON_AddStringToObject(same_obj, "file2_path", found->path);
-                cJSON_AddItemToArray(same_files, same_obj);
-                same_count++;
-            } else {
-                // Hash only exists in file1
-                cJSON *diff_obj = cJSON_CreateObject();
-                cJSON_AddStringToObject(diff_obj, "md5", md5);
-                cJSON_AddStringToObject(diff_obj, "file1_path", path1);
-                cJSON_AddStringToObject(diff_obj, "file2_path", "");
-                cJSON_AddStringToObject(diff_obj, "status", "only_in_file1");
-                cJSON_AddItemToArray(diff_files, diff_obj);
-                diff_count++;
-            }
-        }
+    // Index both scans: every digest maps to all of its paths
+    digest_index_t index1;
+    digest_index_t index2;
+    memset(&index1, 0, sizeof(index1));
+    memset(&index2, 0, sizeof(index2));
+    if (load_index(file1_path, hash, &index1) != 0 || load_index(file2_path, hash, &index2) != 0) {
+        free_index(&index1);
+        free_index(&index2);
+        return -1;
     }
+    digest_table_t *map1 = index1.table;
+    digest_table_t *map2 = index2.table;
     
-    // Create another hash map for file1 to find hashes only in file2
-    hash_map_t *map1 = create_hash_map(HASH_MAP_SIZE);
-    if (!map1) {
-        fprintf(stderr, "Error: Failed to create hash map for file1\n");
-        free_hash_map(map2);
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
-        cJSON_Delete(diff_root);
-        cJSON_Delete(same_root);
+    compare_output_t *diff;
+    compare_output_t *same;
+    if (compare_output_open_digest(diff_output_path, same_output_path, file1_path, file2_path,
+                                   "digest", hash, &diff, &same) != 0) {
+        free_index(&index1);
+        free_index(&index2);
         return -1;
     }
     
-    // Populate hash map with file1 data
-    cJSON_ArrayForEach(file_item, files1) {
-        cJSON *path_item = cJSON_GetObjectItem(file_item, "path");
-        cJSON *md5_item = cJSON_GetObjectItem(file_item, "md5");
+    // One row per digest, listing every path on each side
+    compare_paths_t paths1 = {NULL, NULL, 0};
+    compare_paths_t paths2 = {NULL, NULL, 0};
+    size_t same_files = 0;
+    size_t diff_files = 0;
+    int result = 0;
+    char hex[2 * DIGEST_SIZE + 1];
+    
+    // Digests of file1, in scan order: shared or only in file1
+    for (size_t i = 0; i < digest_table_size(map1) && result == 0; i++) {
+        const unsigned char *digest = digest_table_digest(map1, i);
+        compare_record_t record = {0};
+        record.grouped = 1;
+        record.digest = hex;
+        record.file1_paths = collect_paths(map1, digest, &paths1, &record.file1_count);
+        record.file2_paths = collect_paths(map2, digest, &paths2, &record.file2_count);
+        if (!record.file1_paths || !record.file2_paths) {
+            result = -1;
+            break;
+        }
+        // Mapped paths are still JSON-escaped and are written as they are
+        record.file1_lengths = index1.scan.map ? paths1.lengths : NULL;
+        record.file2_lengths = index2.scan.map ? paths2.lengths : NULL;
+        digest_to_hex(digest, index1.scan.digest_size, hex);
         
-        if (cJSON_IsString(path_item) && cJSON_IsString(md5_item)) {
-            hash_map_insert(map1, md5_item->valuestring, path_item->valuestring);
+        if (record.file2_count > 0) {
+            record.status = "same";
+            compare_output_write(same, &record);
+            same_files += record.file1_count + record.file2_count;
+        } else {
+            record.status = "only_in_file1";
+            compare_output_write(diff, &record);
+            diff_files += record.file1_count;
         }
     }
     
-    // Find hashes only in file2
-    cJSON_ArrayForEach(file_item, files2) {
-        cJSON *path_item = cJSON_GetObjectItem(file_item, "path");
-        cJSON *md5_item = cJSON_GetObjectItem(file_item, "md5");
+    // Digests only in file2
+    for (size_t i = 0; i < digest_table_size(map2) && result == 0; i++) {
+        const unsigned char *digest = digest_table_digest(map2, i);
+        if (digest_table_lookup(map1, digest, NULL) > 0) continue;
         
-        if (cJSON_IsString(path_item) && cJSON_IsString(md5_item)) {
-            const char *path2 = path_item->valuestring;
-            const char *md5 = md5_item->valuestring;
-            
-            hash_entry_t *found = hash_map_find(map1, md5);
-            if (!found) {
-                // Hash only exists in file2
-                cJSON *diff_obj = cJSON_CreateObject();
-                cJSON_AddStringToObject(diff_obj, "md5", md5);
-                cJSON_AddStringToObject(diff_obj, "file1_path", "");
-                cJSON_AddStringToObject(diff_obj, "file2_path", path2);
-                cJSON_AddStringToObject(diff_obj, "status", "only_in_file2");
-                cJSON_AddItemToArray(diff_files, diff_obj);
-                diff_count++;
-            }
+        compare_record_t record = {0};
+        record.grouped = 1;
+        record.digest = hex;
+        record.file2_paths = collect_paths(map2, digest, &paths2, &record.file2_count);
+        if (!record.file2_paths) {
+            result = -1;
+            break;
         }
+        record.file2_lengths = index2.scan.map ? paths2.lengths : NULL;
+        digest_to_hex(digest, index1.scan.digest_size, hex);
+        record.status = "only_in_file2";
+        compare_output_write(diff, &record);
+        diff_files += record.file2_count;
     }
+    compare_paths_free(&paths1);
+    compare_paths_free(&paths2);
     
-    // Add counts to metadata
-    cJSON_AddNumberToObject(diff_info, "total_differences", diff_count);
-    cJSON_AddNumberToObject(same_info, "total_matches", same_count);
-    
-    // Write output files
-    char *diff_json_string = cJSON_Print(diff_root);
-    char *same_json_string = cJSON_Print(same_root);
-    
-    if (!diff_json_string || !same_json_string) {
-        fprintf(stderr, "Error: Failed to generate JSON output\n");
-        free_hash_map(map1);
-        free_hash_map(map2);
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
-        cJSON_Delete(diff_root);
-        cJSON_Delete(same_root);
-        return -1;
-    }
-    
-    // Write diff file
-    FILE *diff_file = fopen(diff_output_path, "w");
-    if (!diff_file) {
-        fprintf(stderr, "Error: Cannot create diff output file %s\n", diff_output_path);
-        free(diff_json_string);
-        free(same_json_string);
-        free_hash_map(map1);
-        free_hash_map(map2);
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
-        cJSON_Delete(diff_root);
-        cJSON_Delete(same_root);
-        return -1;
+    if (result != 0) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
     }
-    fprintf(diff_file, "%s\n", diff_json_string);
-    fclose(diff_file);
-    
-    // Write same file
-    FILE *same_file = fopen(same_output_path, "w");
-    if (!same_file) {
-        fprintf(stderr, "Error: Cannot create same output file %s\n", same_output_path);
-        free(diff_json_string);
-        free(same_json_string);
-        free_hash_map(map1);
-        free_hash_map(map2);
-        cJSON_Delete(json1);
-        cJSON_Delete(json2);
-        cJSON_Delete(diff_root);
-        cJSON_Delete(same_root);
+    if (compare_output_close_digest(diff, same, diff_output_path, same_output_path,
+                                    diff_files, same_files, result) != 0) {
+        free_index(&index1);
+        free_index(&index2);
         return -1;
     }
-    fprintf(same_file, "%s\n", same_json_string);
-    fclose(same_file);
-    
-    printf("Comparison completed successfully!\n");
-    printf("Files with same MD5: %d (saved to %s)\n", same_count, same_output_path);
-    printf("Files with different/unique MD5: %d (saved to %s)\n", diff_count, diff_output_path);
+    print_index_stats("file1", map1);
+    print_index_stats("file2", map2);
     
     // Cleanup
-    free(diff_json_string);
-    free(same_json_string);
-    free_hash_map(map1);
-    free_hash_map(map2);
-    cJSON_Delete(json1);
-    cJSON_Delete(json2);
-    cJSON_Delete(diff_root);
-    cJSON_Delete(same_root);
+    free_index(&index1);
+    free_index(&index2);
     
     return 0;
 }
@@ -2,12 +2,24 @@
 #define JSON_DIFF_H
 
 #include "../cJSON/cJSON.h"
+#include <stdint.h>
+
+// Tuning for the digest joins; set once before comparing
+typedef struct {
+    uint64_t mem_limit;       // Join out of core within this many bytes (0 = in memory)
+    const char *temp_dir;     // Directory for spilled runs (NULL = $TMPDIR or /tmp)
+} json_diff_options_t;
 
 /**
- * Compare two JSON files containing MD5 hashes and generate diff/same files
+ * Compare two scan results containing MD5 hashes and generate diff/same files
+ * 
+ * Each scan may be a JSON document, NDJSON (one record per line) or a
+ * binary scan (scan_bin.h). With a mem_limit set (json_diff_set_options())
+ * the scans are joined out of core by external_join.h instead, which
+ * writes the same rows in digest order.
  * 
- * @param file1_path Path to the first JSON file
- * @param file2_path Path to the second JSON file
+ * @param file1_path Path to the first scan file
+ * @param file2_path Path to the second scan file
  * @param diff_output_path Output path for diff.json (files with different/unique hashes)
  * @param same_output_path Output path for same.json (files with same hashes)
  * @return 0 on success, -1 on error
@@ -15,6 +27,10 @@
 int compare_json_files(const char *file1_path, const char *file2_path, 
                       const char *diff_output_path, const char *same_output_path);
 
+// Set or query the options used by compare_json_files()/compare_scan_digests()
+void json_diff_set_options(const json_diff_options_t *options);
+void json_diff_get_options(json_diff_options_t *options);
+
 /**
  * Load and parse a JSON file
  * 
@@ -23,26 +39,4 @@ int compare_json_files(const char *file1_path, const char *file2_path,
  */
 cJSON *load_json_file(const char *filepath);
 
-/**
- * Create a hash map from JSON files array for quick lookup
- * 
- * @param files_array cJSON array containing file objects with path and md5
- * @return Hash map structure or NULL on error
- */
-typedef struct hash_entry {
-    char *md5;
-    char *path;
-    struct hash_entry *next;
-} hash_entry_t;
-
-typedef struct {
-    hash_entry_t **buckets;
-    int size;
-} hash_map_t;
-
-hash_map_t *create_hash_map(int size);
-void free_hash_map(hash_map_t *map);
-int hash_map_insert(hash_map_t *map, const char *md5, const char *path);
-hash_entry_t *hash_map_find(hash_map_t *map, const char *md5);
-
 #endif // JSON_DIFF_H
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#include "json_index.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JSON_INDEX_X86 1
+#include <immintrin.h>
+// PCMPESTRM mode: match bytes against a set, must be an immediate
+#define SSE42_SET_MODE (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)
+#endif
+
+#define BLOCK_SIZE 64
+
+// Character classes of one block, one bit per byte
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;        // { } [ ] : ,
+    uint64_t whitespace;
+    uint64_t control;           // Bytes below 0x20
+    uint64_t newline;
+} block_masks_t;
+
+typedef void (*classify_fn)(const unsigned char *block, block_masks_t *masks);
+
+static json_index_kernel_t active_kernel = JSON_INDEX_AUTO;
+static classify_fn active_classify = NULL;
+
+static void classify_scalar(const unsigned char *block, block_masks_t *masks) {
+    memset(masks, 0, sizeof(*masks));
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        unsigned char c = block[i];
+        switch (c) {
+            case '"':  masks->quote |= bit; break;
+            case '\\': masks->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                masks->structural |= bit;
+                break;
+            case '\n':
+                masks->newline |= bit;
+                masks->whitespace |= bit;
+                break;
+            case ' ': case '\t': case '\r':
+                masks->whitespace |= bit;
+                break;
+            default:
+                break;
+        }
+        if (c < 0x20) masks->control |= bit;
+    }
+}
+
+#ifdef JSON_INDEX_X86
+__attribute__((target("sse4.2")))
+static void classify_sse42(const unsigned char *block, block_masks_t *masks) {
+    const __m128i structural_set = _mm_setr_epi8('{', '}', '[', ']', ':', ',',
+                                                 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i whitespace_set = _mm_setr_epi8(' ', '\t', '\n', '\r',
+                                                 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+
+    memset(masks, 0, sizeof(*masks));
+    for (int i = 0; i < BLOCK_SIZE / 16; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        int shift = 16 * i;
+
+        // PCMPESTRM matches each byte against a small character set
+        masks->structural |= (uint64_t)(uint16_t)_mm_cvtsi128_si32(
+            _mm_cmpestrm(structural_set, 6, v, 16, SSE42_SET_MODE)) << shift;
+        masks->whitespace |= (uint64_t)(uint16_t)_mm_cvtsi128_si32(
+            _mm_cmpestrm(whitespace_set, 4, v, 16, SSE42_SET_MODE)) << shift;
+        masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+        masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(v, backslash)) << shift;
+        masks->newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(v, newline)) << shift;
+        masks->control |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_min_epu8(v, control_max), v)) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *block, block_masks_t *masks) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open_brace = _mm256_set1_epi8('{');
+    const __m256i close_brace = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    const __m256i control_max = _mm256_set1_epi8(0x1F);
+
+    memset(masks, 0, sizeof(*masks));
+    for (int i = 0; i < BLOCK_SIZE / 32; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + 32 * i));
+        int shift = 32 * i;
+
+        // '[' and ']' are '{' and '}' with bit 0x20 cleared
+        __m256i folded = _mm256_or_si256(v, case_bit);
+        __m256i structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open_brace),
+                            _mm256_cmpeq_epi8(folded, close_brace)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        __m256i line = _mm256_cmpeq_epi8(v, newline);
+        __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+            _mm256_or_si256(line, _mm256_cmpeq_epi8(v, carriage)));
+
+        masks->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(structural) << shift;
+        masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(whitespace) << shift;
+        masks->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(line) << shift;
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(v, quote)) << shift;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(v, backslash)) << shift;
+        masks->control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, control_max), v)) << shift;
+    }
+}
+#endif
+
+/**
+ * Split the backslashes of a block into escapes and escaped characters
+ *
+ * In a run of backslashes every other one starts an escape sequence; the
+ * character after each of those is escaped, whether it is a quote or
+ * another backslash.
+ *
+ * @param backslash Backslash bits of the block
+ * @param carry 1 if the first character is escaped; updated for the next block
+ * @param escape Set to the backslashes that start an escape sequence
+ * @return Bits of escaped characters
+ */
+static uint64_t find_escaped(uint64_t backslash, uint64_t *carry, uint64_t *escape) {
+    const uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAULL;
+
+    if (!backslash) {
+        uint64_t escaped = *carry;
+        *carry = 0;
+        *escape = 0;
+        return escaped;
+    }
+
+    // Subtracting each run from its shifted self leaves alternating bits from the run start
+    uint64_t potential_escape = backslash & ~*carry;
+    uint64_t maybe_escaped = potential_escape << 1;
+    uint64_t series = ((maybe_escaped | odd_bits) - potential_escape) ^ odd_bits;
+    uint64_t escaped = series ^ (backslash | *carry);
+
+    *escape = series & backslash;
+    *carry = *escape >> 63;
+    return escaped;
+}
+
+// Bit i set if an odd number of bits at or below i are set
+static uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/**
+ * Byte-at-a-time classification of a block holding a newline in a string
+ *
+ * The bitmap path cannot end a string at a newline, so such blocks (only
+ * found in invalid input) are replayed here with the same token rules.
+ */
+static uint64_t tokens_bytewise(json_index_t *index, const unsigned char *block) {
+    int in_string = index->in_string != 0;
+    int escaped = index->escaped != 0;
+    int scalar = index->scalar != 0;
+    uint64_t tokens = 0;
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        unsigned char c = block[i];
+
+        if (in_string) {
+            scalar = 0;
+            if (c < 0x20) {
+                tokens |= bit;
+                if (c == '\n') {
+                    in_string = 0;
+                    escaped = 0;
+                }
+            } else if (escaped) {
+                escaped = 0;
+            } else if (c == '\\') {
+                tokens |= bit;
+                escaped = 1;
+            } else if (c == '"') {
+                tokens |= bit;
+                in_string = 0;
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+                tokens |= bit;
+                in_string = 1;
+                scalar = 0;
+                break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                tokens |= bit;
+                scalar = 0;
+                break;
+            case ' ': case '\t': case '\n': case '\r':
+                scalar = 0;
+                break;
+            default:
+                if (!scalar) tokens |= bit;
+                scalar = 1;
+                break;
+        }
+    }
+
+    index->in_string = in_string ? ~(uint64_t)0 : 0;
+    index->escaped = (uint64_t)escaped;
+    index->scalar = (uint64_t)scalar;
+    return tokens;
+}
+
+// Reduce the masks of one block to its token bits
+static uint64_t tokens_from_masks(json_index_t *index, const unsigned char *block,
+                                  const block_masks_t *masks) {
+    uint64_t saved_escaped = index->escaped;
+    uint64_t escape;
+    uint64_t escaped = find_escaped(masks->backslash, &index->escaped, &escape);
+    uint64_t quote = masks->quote & ~escaped;
+
+    // Open quote up to (not including) the closing quote
+    uint64_t in_string = prefix_xor(quote) ^ index->in_string;
+    if (in_string & masks->newline) {
+        index->escaped = saved_escaped;
+        return tokens_bytewise(index, block);
+    }
+
+    uint64_t scalar = ~(masks->structural | masks->whitespace | masks->quote) & ~in_string;
+    uint64_t scalar_start = scalar & ~((scalar << 1) | index->scalar);
+
+    index->in_string = (uint64_t)((int64_t)in_string >> 63);
+    index->scalar = scalar >> 63;
+    return (masks->structural & ~in_string) | quote | scalar_start |
+           ((masks->control | escape) & in_string);
+}
+
+static void select_kernel(void) {
+    if (active_classify) return;
+    json_index_set_kernel(JSON_INDEX_AUTO);
+}
+
+int json_index_set_kernel(json_index_kernel_t kernel) {
+#ifdef JSON_INDEX_X86
+    __builtin_cpu_init();
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_sse42 = __builtin_cpu_supports("sse4.2");
+#else
+    int has_avx2 = 0;
+    int has_sse42 = 0;
+#endif
+
+    if (kernel == JSON_INDEX_AUTO) {
+        kernel = has_avx2 ? JSON_INDEX_AVX2 : has_sse42 ? JSON_INDEX_SSE42 : JSON_INDEX_SCALAR;
+    }
+
+    switch (kernel) {
+        case JSON_INDEX_SCALAR:
+            active_classify = classify_scalar;
+            break;
+#ifdef JSON_INDEX_X86
+        case JSON_INDEX_SSE42:
+            if (!has_sse42) return -1;
+            active_classify = classify_sse42;
+            break;
+        case JSON_INDEX_AVX2:
+            if (!has_avx2) return -1;
+            active_classify = classify_avx2;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+json_index_kernel_t json_index_kernel(void) {
+    select_kernel();
+    return active_kernel;
+}
+
+const char *json_index_kernel_name(json_index_kernel_t kernel) {
+    switch (kernel) {
+        case JSON_INDEX_AUTO:   return "auto";
+        case JSON_INDEX_SCALAR: return "scalar";
+        case JSON_INDEX_SSE42:  return "sse4.2";
+        case JSON_INDEX_AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+void json_index_init(json_index_t *index, const char *data, size_t size) {
+    select_kernel();
+    index->data = (const unsigned char *)data;
+    index->size = size;
+    json_index_restart(index, 0);
+}
+
+void json_index_restart(json_index_t *index, size_t position) {
+    index->next = position;
+    index->in_string = 0;
+    index->escaped = 0;
+    index->scalar = 0;
+}
+
+size_t json_index_next(json_index_t *index, uint64_t *tokens, size_t capacity) {
+    classify_fn classify = active_classify;
+    size_t count = 0;
+
+    while (index->next < index->size && capacity - count >= BLOCK_SIZE) {
+        const unsigned char *block = index->data + index->next;
+        unsigned char padded[BLOCK_SIZE];
+        block_masks_t masks;
+
+        // Pad the tail with whitespace, which produces no tokens
+        if (index->size - index->next < BLOCK_SIZE) {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, index->size - index->next);
+            block = padded;
+        }
+
+        classify(block, &masks);
+        uint64_t bits = tokens_from_masks(index, block, &masks);
+        while (bits) {
+            tokens[count++] = index->next + (uint64_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+        index->next += BLOCK_SIZE;
+    }
+    return count;
+}
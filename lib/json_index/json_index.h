@@ -0,0 +1,66 @@
+#ifndef JSON_INDEX_H
+#define JSON_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stage 1 classification kernels
+typedef enum {
+    JSON_INDEX_AUTO,        // Best kernel the CPU supports
+    JSON_INDEX_SCALAR,
+    JSON_INDEX_SSE42,
+    JSON_INDEX_AVX2
+} json_index_kernel_t;
+
+/**
+ * Structural indexer: stage 1 of the two-stage JSON parser
+ *
+ * Classifies the input 64 bytes at a time into bitmaps and reduces them
+ * to token positions: structural characters and quotes outside strings,
+ * closing quotes, the first byte of every number or literal, and inside
+ * strings the backslash starting each escape sequence and any control
+ * character (which stage 2 reports as an error). A raw newline always
+ * ends a string, so an indexer restarted at any line start is in a known
+ * state.
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t next;                // Offset of the next block to classify
+    uint64_t in_string;         // All ones if the previous block ended inside a string
+    uint64_t escaped;           // 1 if the previous block ended in an odd backslash run
+    uint64_t scalar;            // 1 if the previous block ended inside a number or literal
+} json_index_t;
+
+// Number of token slots json_index_next() needs to make progress
+#define JSON_INDEX_MIN_TOKENS 64
+
+void json_index_init(json_index_t *index, const char *data, size_t size);
+
+// Restart classification at position, which must be 0 or follow a newline
+void json_index_restart(json_index_t *index, size_t position);
+
+/**
+ * Index the next blocks of input
+ *
+ * @param index Indexer
+ * @param tokens Output token offsets, in increasing order
+ * @param capacity Size of tokens, at least JSON_INDEX_MIN_TOKENS
+ * @return Number of tokens written, 0 once the input is exhausted
+ */
+size_t json_index_next(json_index_t *index, uint64_t *tokens, size_t capacity);
+
+/**
+ * Select the classification kernel used by all indexers
+ *
+ * @param kernel Kernel, or JSON_INDEX_AUTO for the best supported one
+ * @return 0 on success, -1 if the CPU or build does not support it
+ */
+int json_index_set_kernel(json_index_kernel_t kernel);
+
+// Kernel currently in use (never JSON_INDEX_AUTO)
+json_index_kernel_t json_index_kernel(void);
+
+const char *json_index_kernel_name(json_index_kernel_t kernel);
+
+#endif // JSON_INDEX_H
@@ -0,0 +1,609 @@
+#define _GNU_SOURCE
+#include "json_map.h"
+#include "../json_index/json_index.h"
+#include "../calc_md5/calc_md5.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_DEPTH 512
+#define TOKEN_CAPACITY 16384
+
+// Growable array of members for the object being walked
+typedef struct {
+    json_member_t *items;
+    size_t count;
+    size_t capacity;
+} member_list_t;
+
+struct json_map {
+    const char *filepath;
+    const char *data;
+    size_t size;
+    size_t position;            // Offset of the current token
+    json_index_t index;         // Stage 1: structural token positions
+    uint64_t *tokens;
+    size_t token_count;
+    size_t token_index;
+    member_list_t root_members;
+    member_list_t record_members;
+    member_list_t info_members; // Members of the last scan_info/comparison_info
+    json_view_t *elements;
+    size_t element_count;
+    size_t element_capacity;
+    size_t line_position;       // Line numbers are counted lazily up to here
+    size_t line;
+    json_map_record_fn fn;
+    void *user_data;
+    int stopped;                // The callback asked to stop
+    int in_files;               // Inside a document's "files" array
+    int saw_files;
+    int saw_info;               // Root object with scan_info or comparison_info
+    int saw_digest;             // Top-level record with a digest member
+};
+
+json_map_t *json_map_open(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    madvise(data, (size_t)statbuf.st_size, MADV_SEQUENTIAL);
+
+    json_map_t *map = calloc(1, sizeof(json_map_t));
+    if (!map) {
+        munmap(data, (size_t)statbuf.st_size);
+        return NULL;
+    }
+    map->tokens = malloc(TOKEN_CAPACITY * sizeof(uint64_t));
+    if (!map->tokens) {
+        munmap(data, (size_t)statbuf.st_size);
+        free(map);
+        return NULL;
+    }
+    map->filepath = filepath;
+    map->data = data;
+    map->size = (size_t)statbuf.st_size;
+    json_index_init(&map->index, map->data, map->size);
+    return map;
+}
+
+void json_map_close(json_map_t *map) {
+    if (!map) return;
+    munmap((void *)map->data, map->size);
+    free(map->tokens);
+    free(map->root_members.items);
+    free(map->record_members.items);
+    free(map->info_members.items);
+    free(map->elements);
+    free(map);
+}
+
+const char *json_map_data(const json_map_t *map) {
+    return map->data;
+}
+
+// Line number of a position at or after the last one asked for
+static size_t line_at(json_map_t *map, size_t position) {
+    while (map->line_position < position) {
+        const char *newline = memchr(map->data + map->line_position, '\n',
+                                     position - map->line_position);
+        if (!newline) {
+            map->line_position = position;
+            break;
+        }
+        map->line++;
+        map->line_position = (size_t)(newline - map->data) + 1;
+    }
+    return map->line;
+}
+
+// Character of the current token, or EOF; position is set to its offset
+static int peek_token(json_map_t *map) {
+    if (map->token_index == map->token_count) {
+        map->token_count = json_index_next(&map->index, map->tokens, TOKEN_CAPACITY);
+        map->token_index = 0;
+        if (map->token_count == 0) {
+            map->position = map->size;
+            return EOF;
+        }
+    }
+    map->position = map->tokens[map->token_index];
+    return (unsigned char)map->data[map->position];
+}
+
+// Consume the token returned by the last peek_token()
+static void advance(json_map_t *map) {
+    map->token_index++;
+}
+
+// Restart stage 1 at a line start, dropping pending tokens
+static void seek_line(json_map_t *map, size_t position) {
+    json_index_restart(&map->index, position);
+    map->token_count = 0;
+    map->token_index = 0;
+}
+
+static int expect_char(json_map_t *map, int expected) {
+    if (peek_token(map) != expected) return -1;
+    advance(map);
+    return 0;
+}
+
+static int is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Bytes that end a number or literal
+static int is_delimiter(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n': case '\r': case '"':
+        case '{': case '}': case '[': case ']': case ':': case ',':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Check the escape sequence starting at a backslash token
+static int valid_escape(const json_map_t *map, size_t position) {
+    size_t remaining = map->size - position;
+
+    if (remaining < 2) return 0;
+    char c = map->data[position + 1];
+    if (c == 'u') {
+        if (remaining < 6) return 0;
+        for (int i = 2; i < 6; i++) {
+            if (!is_hex(map->data[position + i])) return 0;
+        }
+        return 1;
+    }
+    return c != '\0' && strchr("\"\\/bfnrt", c) != NULL;
+}
+
+// Return the view of a string's body; stage 1 marks its escapes and closing quote
+static int parse_string(json_map_t *map, json_view_t *view) {
+    if (peek_token(map) != '"') return -1;
+    size_t start = map->position + 1;
+    int escaped = 0;
+    int c;
+    advance(map);
+
+    while ((c = peek_token(map)) == '\\') {
+        if (!valid_escape(map, map->position)) return -1;
+        escaped = 1;
+        advance(map);
+    }
+    // Anything else is a control character inside the string or the end of input
+    if (c != '"') return -1;
+
+    size_t end = map->position;
+    if (end - start > UINT32_MAX) return -1;
+    view->offset = start;
+    view->length = (uint32_t)(end - start);
+    view->escaped = (uint32_t)escaped;
+    advance(map);
+    return 0;
+}
+
+static int is_number_char(int c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static int parse_number(json_map_t *map, json_view_t *view) {
+    int c = peek_token(map);
+    if (c != '-' && (c < '0' || c > '9')) return -1;
+
+    size_t end = map->position;
+    while (end < map->size && is_number_char(map->data[end])) end++;
+    if (end < map->size && !is_delimiter(map->data[end])) return -1;
+
+    view->offset = map->position;
+    view->length = (uint32_t)(end - map->position);
+    view->escaped = 0;
+    advance(map);
+    return 0;
+}
+
+static int parse_literal(json_map_t *map, json_view_t *view) {
+    static const char *const literals[] = {"true", "false", "null"};
+
+    peek_token(map);
+    for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+        size_t length = strlen(literals[i]);
+        size_t end = map->position + length;
+        if (map->size - map->position >= length &&
+            memcmp(map->data + map->position, literals[i], length) == 0 &&
+            (end == map->size || is_delimiter(map->data[end]))) {
+            view->offset = map->position;
+            view->length = (uint32_t)length;
+            view->escaped = 0;
+            advance(map);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Skip any value, returning the view of its raw text
+static int skip_value(json_map_t *map, int depth, json_view_t *view) {
+    json_view_t inner;
+    int c = peek_token(map);
+
+    if (depth > MAX_DEPTH) return -1;
+    if (c == '"') return parse_string(map, view);
+    if (c == 't' || c == 'f' || c == 'n') return parse_literal(map, view);
+    if (c != '{' && c != '[') return parse_number(map, view);
+
+    int close = c == '{' ? '}' : ']';
+    view->offset = map->position;
+    view->escaped = 0;
+    advance(map);
+    if (peek_token(map) != close) {
+        for (;;) {
+            if (close == '}') {
+                if (parse_string(map, &inner) != 0 || expect_char(map, ':') != 0) return -1;
+            }
+            if (skip_value(map, depth + 1, &inner) != 0) return -1;
+            c = peek_token(map);
+            if (c == close) break;
+            if (c != ',') return -1;
+            advance(map);
+        }
+    }
+    view->length = (uint32_t)(map->position + 1 - view->offset);
+    advance(map);
+    return 0;
+}
+
+static json_member_t *add_member(member_list_t *list) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        json_member_t *items = realloc(list->items, capacity * sizeof(json_member_t));
+        if (!items) return NULL;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    return &list->items[list->count++];
+}
+
+static int add_element(json_map_t *map, const json_view_t *view) {
+    if (map->element_count == map->element_capacity) {
+        size_t capacity = map->element_capacity ? map->element_capacity * 2 : 64;
+        json_view_t *elements = realloc(map->elements, capacity * sizeof(json_view_t));
+        if (!elements) return -1;
+        map->elements = elements;
+        map->element_capacity = capacity;
+    }
+    map->elements[map->element_count++] = *view;
+    return 0;
+}
+
+// Parse an array member, keeping its string elements
+static int parse_array(json_map_t *map, json_member_t *member, int depth) {
+    json_view_t element;
+
+    member->kind = JSON_MAP_ARRAY;
+    member->first = map->element_count;
+    member->count = 0;
+    member->value.offset = map->position;
+    member->value.escaped = 0;
+    advance(map);
+
+    if (peek_token(map) != ']') {
+        for (;;) {
+            if (peek_token(map) == '"') {
+                if (parse_string(map, &element) != 0 || add_element(map, &element) != 0) return -1;
+                member->count++;
+            } else if (skip_value(map, depth + 1, &element) != 0) {
+                return -1;
+            }
+            int c = peek_token(map);
+            if (c == ']') break;
+            if (c != ',') return -1;
+            advance(map);
+        }
+    }
+    member->value.length = (uint32_t)(map->position + 1 - member->value.offset);
+    advance(map);
+    return 0;
+}
+
+static int key_equals(const json_map_t *map, const json_view_t *key, const char *name) {
+    size_t length = strlen(name);
+    return !key->escaped && key->length == length &&
+           memcmp(map->data + key->offset, name, length) == 0;
+}
+
+// Kind of the value starting with c, arrays aside
+static json_map_kind_t value_kind(int c) {
+    return c == '"' ? JSON_MAP_STRING :
+           c == '{' ? JSON_MAP_OBJECT :
+           (c == 't' || c == 'f' || c == 'n') ? JSON_MAP_LITERAL :
+           JSON_MAP_NUMBER;
+}
+
+// Parse a scan_info/comparison_info object member, keeping its own members
+// in info_members; nested values are skipped
+static int parse_info(json_map_t *map, json_member_t *member, int depth) {
+    member_list_t *list = &map->info_members;
+
+    member->kind = JSON_MAP_OBJECT;
+    member->value.offset = map->position;
+    member->value.escaped = 0;
+    list->count = 0;
+    advance(map);
+
+    if (peek_token(map) != '}') {
+        for (;;) {
+            json_view_t key;
+            if (parse_string(map, &key) != 0 || expect_char(map, ':') != 0) return -1;
+
+            json_member_t *info = add_member(list);
+            if (!info) return -1;
+            int c = peek_token(map);
+            info->key = key;
+            info->kind = c == '[' ? JSON_MAP_ARRAY : value_kind(c);
+            info->first = 0;
+            info->count = 0;
+            if (skip_value(map, depth + 1, &info->value) != 0) return -1;
+
+            c = peek_token(map);
+            if (c == '}') break;
+            if (c != ',') return -1;
+            advance(map);
+        }
+    }
+    member->value.length = (uint32_t)(map->position + 1 - member->value.offset);
+    advance(map);
+    return 0;
+}
+
+static int parse_object(json_map_t *map, int root, int depth);
+
+// Walk a document's "files" array, emitting each record object
+static int parse_files(json_map_t *map, int depth) {
+    json_view_t skipped;
+
+    map->in_files = 1;
+    map->saw_files = 1;
+    advance(map);
+    if (peek_token(map) != ']') {
+        for (;;) {
+            int result = peek_token(map) == '{' ?
+                parse_object(map, 0, depth + 1) : skip_value(map, depth + 1, &skipped);
+            if (result != 0) return -1;
+
+            int c = peek_token(map);
+            if (c == ']') break;
+            if (c != ',') return -1;
+            advance(map);
+        }
+    }
+    advance(map);
+    map->in_files = 0;
+    return 0;
+}
+
+static int parse_object(json_map_t *map, int root, int depth) {
+    member_list_t *list = root ? &map->root_members : &map->record_members;
+    int document = 0;
+
+    if (depth > MAX_DEPTH) return -1;
+    list->count = 0;
+    map->element_count = 0;
+
+    advance(map);
+    if (peek_token(map) != '}') {
+        for (;;) {
+            json_view_t key;
+            if (parse_string(map, &key) != 0 || expect_char(map, ':') != 0) return -1;
+
+            int c = peek_token(map);
+            if (root && c == '[' && key_equals(map, &key, "files")) {
+                if (parse_files(map, depth) != 0) return -1;
+                document = 1;
+            } else {
+                int info = root && (key_equals(map, &key, "scan_info") ||
+                                    key_equals(map, &key, "comparison_info"));
+                if (info) {
+                    map->saw_info = 1;
+                }
+                json_member_t *member = add_member(list);
+                if (!member) return -1;
+                member->key = key;
+                member->first = 0;
+                member->count = 0;
+
+                int result;
+                if (c == '[') {
+                    result = parse_array(map, member, depth);
+                } else if (info && c == '{') {
+                    result = parse_info(map, member, depth + 1);
+                } else {
+                    member->kind = value_kind(c);
+                    result = skip_value(map, depth + 1, &member->value);
+                }
+                if (result != 0) return -1;
+            }
+
+            c = peek_token(map);
+            if (c == '}') break;
+            if (c != ',') return -1;
+            advance(map);
+        }
+    }
+    advance(map);
+    if (document) return 0;
+
+    json_map_record_t record = {list->items, list->count, map->elements};
+    for (int i = 0; root && !map->saw_digest && i < CALC_HASH_COUNT; i++) {
+        if (json_map_member(map, &record, calc_hash_name((calc_hash_t)i))) map->saw_digest = 1;
+    }
+    if (map->fn(map, &record, map->user_data) != 0) {
+        map->stopped = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int json_map_records(json_map_t *map, json_map_record_fn fn, void *user_data) {
+    seek_line(map, 0);
+    map->line_position = 0;
+    map->line = 1;
+    map->fn = fn;
+    map->user_data = user_data;
+    map->stopped = 0;
+    map->in_files = 0;
+    map->saw_files = 0;
+    map->saw_info = 0;
+    map->saw_digest = 0;
+    map->info_members.count = 0;
+
+    // A file is a sequence of top-level objects: one document, or NDJSON lines
+    size_t values = 0;
+    while (peek_token(map) != EOF) {
+        size_t start = map->position;
+        int parsed = peek_token(map) == '{' ? parse_object(map, 1, 0) : -1;
+        if (map->stopped) return -1;
+        if (parsed == 0) {
+            values++;
+            continue;
+        }
+
+        // A bad NDJSON line is skipped; a broken document is an error
+        size_t error = map->position < map->size ? map->position : map->size;
+        size_t start_line = line_at(map, start);
+        size_t error_line = line_at(map, error);
+        if (map->in_files || (values == 0 && error_line != start_line)) {
+            fprintf(stderr, "Error: Invalid JSON format in file %s near line %zu\n",
+                    map->filepath, error_line);
+            return -1;
+        }
+        fprintf(stderr, "Warning: Skipping invalid line %zu in %s\n", error_line, map->filepath);
+
+        // Resume on the next line, or retry the line the error ran into
+        const char *newline = memchr(map->data + error, '\n', map->size - error);
+        if (error_line != start_line) {
+            while (error > 0 && map->data[error - 1] != '\n') error--;
+            seek_line(map, error);
+        } else {
+            seek_line(map, newline ? (size_t)(newline - map->data) + 1 : map->size);
+        }
+    }
+
+    if (values == 0) {
+        fprintf(stderr, "Error: Empty or invalid file %s\n", map->filepath);
+        return -1;
+    }
+    if (values == 1 && !map->saw_files && !map->saw_info && !map->saw_digest) {
+        fprintf(stderr, "Error: Invalid JSON structure - 'files' array not found\n");
+        return -1;
+    }
+    return 0;
+}
+
+const json_member_t *json_map_member(const json_map_t *map, const json_map_record_t *record,
+                                     const char *key) {
+    for (size_t i = 0; i < record->member_count; i++) {
+        if (key_equals(map, &record->members[i].key, key)) return &record->members[i];
+    }
+    return NULL;
+}
+
+const json_member_t *json_map_info_member(const json_map_t *map, const char *key) {
+    json_map_record_t info = {map->info_members.items, map->info_members.count, NULL};
+    return json_map_member(map, &info, key);
+}
+
+size_t json_utf8_encode(unsigned int code, char *out) {
+    if (code < 0x80) {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+static unsigned int hex4(const char *text) {
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = text[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= (unsigned int)(c - '0');
+        else if (c >= 'a' && c <= 'f') value |= (unsigned int)(c - 'a' + 10);
+        else value |= (unsigned int)(c - 'A' + 10);
+    }
+    return value;
+}
+
+size_t json_map_decode(const json_map_t *map, const json_view_t *view, char *out) {
+    const char *text = map->data + view->offset;
+    const char *end = text + view->length;
+    char *start = out;
+
+    if (!view->escaped) {
+        memcpy(out, text, view->length);
+        out[view->length] = '\0';
+        return view->length;
+    }
+
+    // Strings were validated while walking, and no escape grows when decoded
+    while (text < end) {
+        if (*text != '\\') {
+            *out++ = *text++;
+            continue;
+        }
+        text++;
+        char c = *text++;
+        switch (c) {
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                unsigned int code = hex4(text);
+                text += 4;
+                if (code >= 0xD800 && code <= 0xDBFF && end - text >= 6 &&
+                    text[0] == '\\' && text[1] == 'u') {
+                    unsigned int low = hex4(text + 2);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        text += 6;
+                    }
+                }
+                out += json_utf8_encode(code, out);
+                break;
+            }
+            default: *out++ = c; break;
+        }
+    }
+    *out = '\0';
+    return (size_t)(out - start);
+}
@@ -0,0 +1,97 @@
+#ifndef JSON_MAP_H
+#define JSON_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kinds of member value a record exposes
+typedef enum {
+    JSON_MAP_STRING,
+    JSON_MAP_NUMBER,
+    JSON_MAP_LITERAL,       // true, false or null
+    JSON_MAP_ARRAY,         // String elements are exposed, others skipped
+    JSON_MAP_OBJECT         // Not descended into
+} json_map_kind_t;
+
+// A span of the mapped file; for strings, the body between the quotes
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t escaped;       // Non-zero if the body contains escape sequences
+} json_view_t;
+
+typedef struct {
+    json_view_t key;
+    json_map_kind_t kind;
+    json_view_t value;      // Raw text of the value (string body for strings)
+    size_t first;           // Arrays: index of the first element in elements
+    size_t count;           // Arrays: number of string elements
+} json_member_t;
+
+// One record object; only valid during the callback
+typedef struct {
+    const json_member_t *members;
+    size_t member_count;
+    const json_view_t *elements;    // String elements of the array members
+} json_map_record_t;
+
+typedef struct json_map json_map_t;
+
+// Called for every record in file order; return non-zero to stop
+typedef int (*json_map_record_fn)(const json_map_t *map, const json_map_record_t *record,
+                                  void *user_data);
+
+/**
+ * Map a JSON or NDJSON file read-only into memory
+ *
+ * Nothing is read up front: pages are faulted in as records are walked,
+ * and strings are handed out as views into the mapping instead of copies.
+ *
+ * @param filepath Regular, non-empty file
+ * @return Map, or NULL if the file cannot be mapped (callers fall back to
+ *         reading it as a stream)
+ */
+json_map_t *json_map_open(const char *filepath);
+
+void json_map_close(json_map_t *map);
+
+// Start of the mapping; views are offsets from here
+const char *json_map_data(const json_map_t *map);
+
+/**
+ * Walk the records of a mapped scan or comparison result
+ *
+ * Records are the objects of a document's "files" array, or each
+ * top-level object of an NDJSON file. Errors are reported like
+ * scan_reader_read(): an invalid NDJSON line is skipped with a warning,
+ * anything else fails the walk.
+ *
+ * @param map Mapped file
+ * @param fn Record callback
+ * @param user_data Passed to fn
+ * @return 0 on success, -1 on error or if fn stopped the walk
+ */
+int json_map_records(json_map_t *map, json_map_record_fn fn, void *user_data);
+
+// Member of a record by key, or NULL if absent
+const json_member_t *json_map_member(const json_map_t *map, const json_map_record_t *record,
+                                     const char *key);
+
+// Member of the file's scan_info or comparison_info object, or NULL; the
+// object may follow the records, so look once json_map_records() returns
+const json_member_t *json_map_info_member(const json_map_t *map, const char *key);
+
+/**
+ * Unescape a string view
+ *
+ * @param map Map the view points into
+ * @param view String view
+ * @param out Buffer of at least view->length + 1 bytes
+ * @return Length of the NUL-terminated result
+ */
+size_t json_map_decode(const json_map_t *map, const json_view_t *view, char *out);
+
+// Write a code point as UTF-8 to out (up to 4 bytes); returns the bytes written
+size_t json_utf8_encode(unsigned int code, char *out);
+
+#endif // JSON_MAP_H
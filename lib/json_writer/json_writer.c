@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include "json_writer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WRITER_BUFFER_SIZE (64 * 1024)
+
+struct json_writer {
+    int fd;
+    int seekable;
+    int error;
+    off_t offset;               // Stream offset of buffer[0]
+    size_t used;
+    char buffer[WRITER_BUFFER_SIZE];
+};
+
+static void write_all(json_writer_t *writer, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(writer->fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            writer->error = 1;
+            return;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+static void flush_buffer(json_writer_t *writer) {
+    if (writer->used == 0) return;
+    write_all(writer, writer->buffer, writer->used);
+    writer->offset += (off_t)writer->used;
+    writer->used = 0;
+}
+
+static void append(json_writer_t *writer, const char *data, size_t length) {
+    if (length > WRITER_BUFFER_SIZE - writer->used) {
+        flush_buffer(writer);
+        if (length > WRITER_BUFFER_SIZE) {
+            write_all(writer, data, length);
+            writer->offset += (off_t)length;
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->used, data, length);
+    writer->used += length;
+}
+
+json_writer_t *json_writer_create(FILE *out) {
+    if (fflush(out) != 0) return NULL;
+
+    json_writer_t *writer = malloc(sizeof(json_writer_t));
+    if (!writer) return NULL;
+
+    writer->fd = fileno(out);
+    writer->error = 0;
+    writer->used = 0;
+    writer->seekable = 0;
+    writer->offset = 0;
+
+    // pwrite() on an O_APPEND descriptor appends, so patching needs a plain file
+    struct stat statbuf;
+    int flags = fcntl(writer->fd, F_GETFL);
+    if (fstat(writer->fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode) &&
+        flags != -1 && !(flags & O_APPEND)) {
+        off_t offset = lseek(writer->fd, 0, SEEK_CUR);
+        if (offset >= 0) {
+            writer->offset = offset;
+            writer->seekable = 1;
+        }
+    }
+    return writer;
+}
+
+int json_writer_seekable(const json_writer_t *writer) {
+    return writer->seekable;
+}
+
+void json_writer_raw(json_writer_t *writer, const char *text) {
+    append(writer, text, strlen(text));
+}
+
+void json_writer_string(json_writer_t *writer, const char *text) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (!text) {
+        append(writer, "null", 4);
+        return;
+    }
+
+    append(writer, "\"", 1);
+    const char *run = text;
+    for (const char *p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        // Copy the unescaped run, then the escape sequence
+        append(writer, run, (size_t)(p - run));
+        run = p + 1;
+
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t length = 2;
+        switch (c) {
+            case '"':  escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0xf];
+                length = 6;
+                break;
+        }
+        append(writer, escape, length);
+    }
+    append(writer, run, strlen(run));
+    append(writer, "\"", 1);
+}
+
+void json_writer_string_body(json_writer_t *writer, const char *body, size_t length) {
+    append(writer, "\"", 1);
+    append(writer, body, length);
+    append(writer, "\"", 1);
+}
+
+void json_writer_key(json_writer_t *writer, const char *key) {
+    json_writer_string(writer, key);
+    append(writer, ":", 1);
+}
+
+void json_writer_uint(json_writer_t *writer, uint64_t value) {
+    char digits[24];
+    int length = snprintf(digits, sizeof(digits), "%" PRIu64, value);
+    append(writer, digits, (size_t)length);
+}
+
+off_t json_writer_reserve_number(json_writer_t *writer) {
+    if (!writer->seekable) return -1;
+
+    char slot[JSON_WRITER_NUMBER_WIDTH];
+    memset(slot, ' ', sizeof(slot));
+    slot[0] = '0';
+
+    off_t offset = writer->offset + (off_t)writer->used;
+    append(writer, slot, sizeof(slot));
+    return offset;
+}
+
+int json_writer_patch_number(json_writer_t *writer, off_t offset, uint64_t value) {
+    if (!writer->seekable || offset < 0) return -1;
+
+    char slot[JSON_WRITER_NUMBER_WIDTH + 1];
+    int length = snprintf(slot, sizeof(slot), "%" PRIu64, value);
+    memset(slot + length, ' ', JSON_WRITER_NUMBER_WIDTH - (size_t)length);
+
+    // The slot may still be sitting in the buffer
+    flush_buffer(writer);
+    if (pwrite(writer->fd, slot, JSON_WRITER_NUMBER_WIDTH, offset) != JSON_WRITER_NUMBER_WIDTH) {
+        writer->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int json_writer_finish(json_writer_t *writer) {
+    flush_buffer(writer);
+    int result = writer->error ? -1 : 0;
+    free(writer);
+    return result;
+}
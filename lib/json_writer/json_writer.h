@@ -0,0 +1,74 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// Width of a number slot reserved for later patching (fits any uint64_t)
+#define JSON_WRITER_NUMBER_WIDTH 20
+
+typedef struct json_writer json_writer_t;
+
+/**
+ * Create a streaming JSON emitter on top of an output stream
+ *
+ * The stream is flushed first; from then on output is buffered by the
+ * writer and written straight to the stream's descriptor, so nothing is
+ * kept in memory beyond one buffer regardless of document size.
+ *
+ * @param out Output stream (file or stdout)
+ * @return Writer or NULL on error
+ */
+json_writer_t *json_writer_create(FILE *out);
+
+// Non-zero if earlier output can be patched in place (regular file, no O_APPEND)
+int json_writer_seekable(const json_writer_t *writer);
+
+// Emit literal JSON text (structure, whitespace) without escaping
+void json_writer_raw(json_writer_t *writer, const char *text);
+
+// Emit a quoted, escaped JSON string; NULL is written as null
+void json_writer_string(json_writer_t *writer, const char *text);
+
+// Emit a string whose body is already escaped JSON text, such as a view of an input file
+void json_writer_string_body(json_writer_t *writer, const char *body, size_t length);
+
+// Emit an object key followed by ':'
+void json_writer_key(json_writer_t *writer, const char *key);
+
+// Emit an unsigned integer
+void json_writer_uint(json_writer_t *writer, uint64_t value);
+
+/**
+ * Reserve a fixed-width number that is filled in later
+ *
+ * Writes 0 padded with trailing whitespace to JSON_WRITER_NUMBER_WIDTH
+ * bytes, so the document stays valid even if the slot is never patched.
+ *
+ * @param writer Seekable writer
+ * @return Offset of the slot, or -1 if the output is not seekable
+ */
+off_t json_writer_reserve_number(json_writer_t *writer);
+
+/**
+ * Overwrite a reserved number slot
+ *
+ * @param writer Writer that returned the slot
+ * @param offset Offset from json_writer_reserve_number()
+ * @param value Final value
+ * @return 0 on success, -1 on error
+ */
+int json_writer_patch_number(json_writer_t *writer, off_t offset, uint64_t value);
+
+/**
+ * Flush pending output and free the writer
+ *
+ * The underlying stream is left open.
+ *
+ * @param writer Writer to finish
+ * @return 0 if every write succeeded, -1 otherwise
+ */
+int json_writer_finish(json_writer_t *writer);
+
+#endif // JSON_WRITER_H
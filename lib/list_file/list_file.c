@@ -1,16 +1,31 @@
+#define _GNU_SOURCE
 #include "list_file.h"
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
 #endif
 
+#define DIRENT_BUFFER_SIZE (64 * 1024)
+
+// Record layout returned by getdents64(2)
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
 int is_regular_file(const char *path) {
     struct stat statbuf;
     if (stat(path, &statbuf) != 0) {
@@ -32,6 +47,21 @@ char *get_absolute_path(const char *path) {
     return absolute_path;
 }
 
+// Order entry names as their full paths would sort: a directory name
+// compares as if it carried its trailing '/', so "a.txt" comes before "a/b".
+static int compare_entry_names(const char *a, int a_is_dir, const char *b, int b_is_dir) {
+    const unsigned char *pa = (const unsigned char *)a;
+    const unsigned char *pb = (const unsigned char *)b;
+    
+    while (*pa && *pa == *pb) {
+        pa++;
+        pb++;
+    }
+    int ca = *pa ? *pa : (a_is_dir ? '/' : 0);
+    int cb = *pb ? *pb : (b_is_dir ? '/' : 0);
+    return ca - cb;
+}
+
 int traverse_directory(const char *dir_path, file_callback_t callback, void *user_data) {
     DIR *dir;
     struct dirent *entry;
@@ -68,3 +98,272 @@ int traverse_directory(const char *dir_path, file_callback_t callback, void *use
     closedir(dir);
     return 0;
 }
+
+// Entry of a directory being walked; name points into the frame's arena
+typedef struct {
+    const char *name;
+    size_t name_off;
+    size_t name_len;
+    int is_dir;
+} walk_dirent_t;
+
+// One level of the explicit directory stack
+typedef struct {
+    int fd;
+    size_t path_len;        // Length of this directory's relative path
+    walk_dirent_t *entries;
+    size_t count;
+    size_t capacity;
+    size_t next;
+    char *names;            // Arena holding all entry names
+    size_t names_len;
+    size_t names_capacity;
+} walk_frame_t;
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t capacity;
+} path_buffer_t;
+
+static int path_reserve(path_buffer_t *path, size_t needed) {
+    if (needed <= path->capacity) return 0;
+    
+    size_t new_capacity = path->capacity ? path->capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char *buf = realloc(path->buf, new_capacity);
+    if (!buf) return -1;
+    path->buf = buf;
+    path->capacity = new_capacity;
+    return 0;
+}
+
+// Append "/name" (or just "name" at the root) to the path buffer
+static int path_push(path_buffer_t *path, size_t base_len, const char *name, size_t name_len) {
+    size_t sep = base_len ? 1 : 0;
+    if (path_reserve(path, base_len + sep + name_len + 1) != 0) return -1;
+    if (sep) {
+        path->buf[base_len] = '/';
+    }
+    memcpy(path->buf + base_len + sep, name, name_len + 1);
+    path->len = base_len + sep + name_len;
+    return 0;
+}
+
+// Resolve the type of an entry; returns 1 for directories, 0 for regular
+// files and -1 for anything that should be skipped
+static int resolve_entry_type(int dir_fd, const char *name, unsigned char d_type) {
+    struct stat statbuf;
+    
+    switch (d_type) {
+        case DT_REG:
+            return 0;
+        case DT_DIR:
+            return 1;
+        case DT_UNKNOWN:
+        case DT_LNK:
+            // Symbolic links are followed, like stat() in is_regular_file()
+            if (fstatat(dir_fd, name, &statbuf, 0) != 0) {
+                return -1;
+            }
+            if (S_ISREG(statbuf.st_mode)) return 0;
+            if (S_ISDIR(statbuf.st_mode)) return 1;
+            return -1;
+        default:
+            return -1;
+    }
+}
+
+static int frame_add_entry(walk_frame_t *frame, const char *name, size_t name_len, int is_dir) {
+    if (frame->count == frame->capacity) {
+        size_t new_capacity = frame->capacity ? frame->capacity * 2 : 64;
+        walk_dirent_t *entries = realloc(frame->entries, new_capacity * sizeof(walk_dirent_t));
+        if (!entries) return -1;
+        frame->entries = entries;
+        frame->capacity = new_capacity;
+    }
+    if (frame->names_len + name_len + 1 > frame->names_capacity) {
+        size_t new_capacity = frame->names_capacity ? frame->names_capacity : 1024;
+        while (new_capacity < frame->names_len + name_len + 1) {
+            new_capacity *= 2;
+        }
+        char *names = realloc(frame->names, new_capacity);
+        if (!names) return -1;
+        frame->names = names;
+        frame->names_capacity = new_capacity;
+    }
+    
+    memcpy(frame->names + frame->names_len, name, name_len + 1);
+    walk_dirent_t *entry = &frame->entries[frame->count++];
+    entry->name_off = frame->names_len;
+    entry->name_len = name_len;
+    entry->is_dir = is_dir;
+    frame->names_len += name_len + 1;
+    return 0;
+}
+
+static int compare_walk_dirents(const void *a, const void *b) {
+    const walk_dirent_t *ea = (const walk_dirent_t *)a;
+    const walk_dirent_t *eb = (const walk_dirent_t *)b;
+    return compare_entry_names(ea->name, ea->is_dir, eb->name, eb->is_dir);
+}
+
+// Read every entry of frame->fd into the frame and sort them
+static int frame_load(walk_frame_t *frame, char *dirent_buf, const char *display_path) {
+    frame->count = 0;
+    frame->next = 0;
+    frame->names_len = 0;
+    
+    for (;;) {
+        long nread = syscall(SYS_getdents64, frame->fd, dirent_buf, DIRENT_BUFFER_SIZE);
+        if (nread < 0) {
+            fprintf(stderr, "Error reading directory %s: %s\n", display_path, strerror(errno));
+            return -1;
+        }
+        if (nread == 0) {
+            break;
+        }
+        
+        for (long off = 0; off < nread;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(dirent_buf + off);
+            off += d->d_reclen;
+            
+            // Skip current and parent directory entries
+            if (d->d_name[0] == '.' &&
+                (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0'))) {
+                continue;
+            }
+            
+            int type = resolve_entry_type(frame->fd, d->d_name, d->d_type);
+            if (type < 0) {
+                continue;
+            }
+            if (frame_add_entry(frame, d->d_name, strlen(d->d_name), type) != 0) {
+                fprintf(stderr, "Error: Memory allocation failed in %s\n", display_path);
+                return -1;
+            }
+        }
+    }
+    
+    // The arena no longer moves, so names can be resolved and sorted
+    for (size_t i = 0; i < frame->count; i++) {
+        frame->entries[i].name = frame->names + frame->entries[i].name_off;
+    }
+    if (frame->count > 1) {
+        qsort(frame->entries, frame->count, sizeof(walk_dirent_t), compare_walk_dirents);
+    }
+    return 0;
+}
+
+int walk_directory(const char *root_path, walk_callback_t callback, void *user_data) {
+    int root_fd = open(root_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        fprintf(stderr, "Error opening directory %s: %s\n", root_path, strerror(errno));
+        return -1;
+    }
+    
+    char *dirent_buf = malloc(DIRENT_BUFFER_SIZE);
+    path_buffer_t path = { NULL, 0, 0 };
+    walk_frame_t *frames = NULL;
+    size_t depth = 0, frames_capacity = 0;
+    int ret = 0;
+    
+    if (!dirent_buf || path_reserve(&path, 256) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        close(root_fd);
+        free(dirent_buf);
+        free(path.buf);
+        return -1;
+    }
+    path.buf[0] = '\0';
+    
+    // Frames are kept after popping so their buffers are reused by siblings
+    frames = calloc(16, sizeof(walk_frame_t));
+    if (!frames) {
+        close(root_fd);
+        free(dirent_buf);
+        free(path.buf);
+        return -1;
+    }
+    frames_capacity = 16;
+    
+    frames[0].fd = root_fd;
+    frames[0].path_len = 0;
+    if (frame_load(&frames[0], dirent_buf, root_path) != 0) {
+        ret = -1;
+        close(root_fd);
+    } else {
+        depth = 1;
+    }
+    
+    while (depth > 0) {
+        walk_frame_t *frame = &frames[depth - 1];
+        
+        if (frame->next == frame->count) {
+            close(frame->fd);
+            depth--;
+            continue;
+        }
+        
+        walk_dirent_t *entry = &frame->entries[frame->next++];
+        if (path_push(&path, frame->path_len, entry->name, entry->name_len) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            continue;
+        }
+        
+        if (!entry->is_dir) {
+            walk_entry_t file = {
+                .path = path.buf,
+                .name = entry->name,
+                .dir_fd = frame->fd
+            };
+            callback(&file, user_data);
+            continue;
+        }
+        
+        // Guard against symlink cycles growing the path forever
+        if (path.len >= PATH_MAX) {
+            fprintf(stderr, "Error: Path too long, skipping %s\n", path.buf);
+            continue;
+        }
+        
+        int child_fd = openat(frame->fd, entry->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (child_fd < 0) {
+            fprintf(stderr, "Error opening directory %s/%s: %s\n", root_path, path.buf, strerror(errno));
+            continue;
+        }
+        
+        if (depth == frames_capacity) {
+            walk_frame_t *grown = realloc(frames, frames_capacity * 2 * sizeof(walk_frame_t));
+            if (!grown) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                close(child_fd);
+                continue;
+            }
+            memset(grown + frames_capacity, 0, frames_capacity * sizeof(walk_frame_t));
+            frames = grown;
+            frames_capacity *= 2;
+        }
+        
+        walk_frame_t *child = &frames[depth];
+        child->fd = child_fd;
+        child->path_len = path.len;
+        if (frame_load(child, dirent_buf, path.buf) != 0) {
+            close(child_fd);
+            continue;
+        }
+        depth++;
+    }
+    
+    for (size_t i = 0; i < frames_capacity; i++) {
+        free(frames[i].entries);
+        free(frames[i].names);
+    }
+    free(frames);
+    free(path.buf);
+    free(dirent_buf);
+    
+    return ret;
+}
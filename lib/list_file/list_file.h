@@ -6,9 +6,35 @@
 // Callback function type for processing each file
 typedef void (*file_callback_t)(const char *filepath, void *user_data);
 
+// Regular file found by walk_directory()
+typedef struct {
+    const char *path;  // Path relative to the walk root
+    const char *name;  // Final path component
+    int dir_fd;        // Open descriptor of the containing directory
+} walk_entry_t;
+
+// Callback for walk_directory(); entry is only valid during the call
+typedef void (*walk_callback_t)(const walk_entry_t *entry, void *user_data);
+
 // Function to recursively traverse directory and call callback for each file
 int traverse_directory(const char *dir_path, file_callback_t callback, void *user_data);
 
+/**
+ * Walk a directory tree and call callback for every regular file
+ *
+ * Directories are opened relative to their parent with openat() and read
+ * with getdents64(); the entry type comes from d_type and fstatat() is only
+ * issued for DT_UNKNOWN entries and symbolic links. Relative paths are built
+ * in one reusable buffer and subdirectories are tracked on an explicit stack
+ * instead of recursion. Entries are visited in sorted path order.
+ *
+ * @param root_path Directory to walk
+ * @param callback Called for each regular file
+ * @param user_data Passed through to the callback
+ * @return 0 on success, -1 if the root directory cannot be opened
+ */
+int walk_directory(const char *root_path, walk_callback_t callback, void *user_data);
+
 // Check if a path is a regular file
 int is_regular_file(const char *path);
 
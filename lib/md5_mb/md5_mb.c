@@ -0,0 +1,511 @@
+#define _GNU_SOURCE
+#include "md5_mb.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MD5_MB_X86 1
+#include <immintrin.h>
+#endif
+
+// Transform of blocks whole blocks per lane; idle lanes have a NULL context
+typedef void (*transform_fn)(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks);
+
+static md5_mb_kernel_t active_kernel = MD5_MB_AUTO;
+static transform_fn active_transform = NULL;
+static int active_lanes = 1;
+
+// The 64 steps of one block: step(f, a, b, c, d, message word, shift, constant)
+#define MD5_STEPS(FF, GG, HH, II) \
+    FF(a, b, c, d, 0, 7, 0xd76aa478); FF(d, a, b, c, 1, 12, 0xe8c7b756); \
+    FF(c, d, a, b, 2, 17, 0x242070db); FF(b, c, d, a, 3, 22, 0xc1bdceee); \
+    FF(a, b, c, d, 4, 7, 0xf57c0faf); FF(d, a, b, c, 5, 12, 0x4787c62a); \
+    FF(c, d, a, b, 6, 17, 0xa8304613); FF(b, c, d, a, 7, 22, 0xfd469501); \
+    FF(a, b, c, d, 8, 7, 0x698098d8); FF(d, a, b, c, 9, 12, 0x8b44f7af); \
+    FF(c, d, a, b, 10, 17, 0xffff5bb1); FF(b, c, d, a, 11, 22, 0x895cd7be); \
+    FF(a, b, c, d, 12, 7, 0x6b901122); FF(d, a, b, c, 13, 12, 0xfd987193); \
+    FF(c, d, a, b, 14, 17, 0xa679438e); FF(b, c, d, a, 15, 22, 0x49b40821); \
+    GG(a, b, c, d, 1, 5, 0xf61e2562); GG(d, a, b, c, 6, 9, 0xc040b340); \
+    GG(c, d, a, b, 11, 14, 0x265e5a51); GG(b, c, d, a, 0, 20, 0xe9b6c7aa); \
+    GG(a, b, c, d, 5, 5, 0xd62f105d); GG(d, a, b, c, 10, 9, 0x02441453); \
+    GG(c, d, a, b, 15, 14, 0xd8a1e681); GG(b, c, d, a, 4, 20, 0xe7d3fbc8); \
+    GG(a, b, c, d, 9, 5, 0x21e1cde6); GG(d, a, b, c, 14, 9, 0xc33707d6); \
+    GG(c, d, a, b, 3, 14, 0xf4d50d87); GG(b, c, d, a, 8, 20, 0x455a14ed); \
+    GG(a, b, c, d, 13, 5, 0xa9e3e905); GG(d, a, b, c, 2, 9, 0xfcefa3f8); \
+    GG(c, d, a, b, 7, 14, 0x676f02d9); GG(b, c, d, a, 12, 20, 0x8d2a4c8a); \
+    HH(a, b, c, d, 5, 4, 0xfffa3942); HH(d, a, b, c, 8, 11, 0x8771f681); \
+    HH(c, d, a, b, 11, 16, 0x6d9d6122); HH(b, c, d, a, 14, 23, 0xfde5380c); \
+    HH(a, b, c, d, 1, 4, 0xa4beea44); HH(d, a, b, c, 4, 11, 0x4bdecfa9); \
+    HH(c, d, a, b, 7, 16, 0xf6bb4b60); HH(b, c, d, a, 10, 23, 0xbebfbc70); \
+    HH(a, b, c, d, 13, 4, 0x289b7ec6); HH(d, a, b, c, 0, 11, 0xeaa127fa); \
+    HH(c, d, a, b, 3, 16, 0xd4ef3085); HH(b, c, d, a, 6, 23, 0x04881d05); \
+    HH(a, b, c, d, 9, 4, 0xd9d4d039); HH(d, a, b, c, 12, 11, 0xe6db99e5); \
+    HH(c, d, a, b, 15, 16, 0x1fa27cf8); HH(b, c, d, a, 2, 23, 0xc4ac5665); \
+    II(a, b, c, d, 0, 6, 0xf4292244); II(d, a, b, c, 7, 10, 0x432aff97); \
+    II(c, d, a, b, 14, 15, 0xab9423a7); II(b, c, d, a, 5, 21, 0xfc93a039); \
+    II(a, b, c, d, 12, 6, 0x655b59c3); II(d, a, b, c, 3, 10, 0x8f0ccc92); \
+    II(c, d, a, b, 10, 15, 0xffeff47d); II(b, c, d, a, 1, 21, 0x85845dd1); \
+    II(a, b, c, d, 8, 6, 0x6fa87e4f); II(d, a, b, c, 15, 10, 0xfe2ce6e0); \
+    II(c, d, a, b, 6, 15, 0xa3014314); II(b, c, d, a, 13, 21, 0x4e0811a1); \
+    II(a, b, c, d, 4, 6, 0xf7537e82); II(d, a, b, c, 11, 10, 0xbd3af235); \
+    II(c, d, a, b, 2, 15, 0x2ad7d2bb); II(b, c, d, a, 9, 21, 0xeb86d391)
+
+static void transform_scalar(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks) {
+    md5_update(ctx[0], data[0], blocks * 64);
+}
+
+#ifdef MD5_MB_X86
+// Idle lanes hash this block over and over into a scratch state
+static const uint8_t idle_block[64] __attribute__((aligned(64)));
+
+// Lane pointers and strides, with idle lanes parked on idle_block
+static void prepare_lanes(MD5_CTX *const ctx[], const uint8_t *const data[], int lanes,
+                          const uint8_t **ptr, size_t *stride, uint32_t state[4][MD5_MB_MAX_LANES]) {
+    for (int i = 0; i < lanes; i++) {
+        ptr[i] = ctx[i] ? data[i] : idle_block;
+        stride[i] = ctx[i] ? 64 : 0;
+        for (int j = 0; j < 4; j++) state[j][i] = ctx[i] ? ctx[i]->state[j] : 0;
+    }
+}
+
+static void store_lanes(MD5_CTX *const ctx[], int lanes, uint32_t state[4][MD5_MB_MAX_LANES]) {
+    for (int i = 0; i < lanes; i++) {
+        if (!ctx[i]) continue;
+        for (int j = 0; j < 4; j++) ctx[i]->state[j] = state[j][i];
+    }
+}
+
+#define SSE2_F(x, y, z) _mm_xor_si128((z), _mm_and_si128((x), _mm_xor_si128((y), (z))))
+#define SSE2_G(x, y, z) _mm_or_si128(_mm_and_si128((x), (z)), _mm_andnot_si128((z), (y)))
+#define SSE2_H(x, y, z) _mm_xor_si128(_mm_xor_si128((x), (y)), (z))
+#define SSE2_I(x, y, z) _mm_xor_si128((y), _mm_or_si128((x), _mm_xor_si128((z), ones)))
+#define SSE2_STEP(f, a, b, c, d, k, s, ac) { \
+    (a) = _mm_add_epi32((a), _mm_add_epi32(w[k], _mm_set1_epi32((int)(ac)))); \
+    (a) = _mm_add_epi32((a), f((b), (c), (d))); \
+    (a) = _mm_or_si128(_mm_slli_epi32((a), (s)), _mm_srli_epi32((a), 32 - (s))); \
+    (a) = _mm_add_epi32((a), (b)); \
+}
+#define SSE2_FF(a, b, c, d, k, s, ac) SSE2_STEP(SSE2_F, a, b, c, d, k, s, ac)
+#define SSE2_GG(a, b, c, d, k, s, ac) SSE2_STEP(SSE2_G, a, b, c, d, k, s, ac)
+#define SSE2_HH(a, b, c, d, k, s, ac) SSE2_STEP(SSE2_H, a, b, c, d, k, s, ac)
+#define SSE2_II(a, b, c, d, k, s, ac) SSE2_STEP(SSE2_I, a, b, c, d, k, s, ac)
+
+// Words 4g..4g+3 of four lanes, transposed to one vector per word
+__attribute__((target("sse2")))
+static inline void transpose_sse2(const uint8_t *const ptr[4], int g, __m128i *w) {
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(ptr[0] + 16 * g));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(ptr[1] + 16 * g));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(ptr[2] + 16 * g));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(ptr[3] + 16 * g));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    w[4 * g] = _mm_unpacklo_epi64(t0, t1);
+    w[4 * g + 1] = _mm_unpackhi_epi64(t0, t1);
+    w[4 * g + 2] = _mm_unpacklo_epi64(t2, t3);
+    w[4 * g + 3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+__attribute__((target("sse2")))
+static void transform_sse2(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks) {
+    const uint8_t *ptr[4];
+    size_t stride[4];
+    uint32_t state[4][MD5_MB_MAX_LANES];
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i w[16];
+
+    prepare_lanes(ctx, data, 4, ptr, stride, state);
+    __m128i a = _mm_loadu_si128((const __m128i *)state[0]);
+    __m128i b = _mm_loadu_si128((const __m128i *)state[1]);
+    __m128i c = _mm_loadu_si128((const __m128i *)state[2]);
+    __m128i d = _mm_loadu_si128((const __m128i *)state[3]);
+
+    for (; blocks > 0; blocks--) {
+        __m128i aa = a, bb = b, cc = c, dd = d;
+        for (int g = 0; g < 4; g++) transpose_sse2(ptr, g, w);
+        MD5_STEPS(SSE2_FF, SSE2_GG, SSE2_HH, SSE2_II);
+        a = _mm_add_epi32(a, aa);
+        b = _mm_add_epi32(b, bb);
+        c = _mm_add_epi32(c, cc);
+        d = _mm_add_epi32(d, dd);
+        for (int i = 0; i < 4; i++) ptr[i] += stride[i];
+    }
+
+    _mm_storeu_si128((__m128i *)state[0], a);
+    _mm_storeu_si128((__m128i *)state[1], b);
+    _mm_storeu_si128((__m128i *)state[2], c);
+    _mm_storeu_si128((__m128i *)state[3], d);
+    store_lanes(ctx, 4, state);
+}
+
+#define AVX2_F(x, y, z) _mm256_xor_si256((z), _mm256_and_si256((x), _mm256_xor_si256((y), (z))))
+#define AVX2_G(x, y, z) _mm256_or_si256(_mm256_and_si256((x), (z)), _mm256_andnot_si256((z), (y)))
+#define AVX2_H(x, y, z) _mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+#define AVX2_I(x, y, z) _mm256_xor_si256((y), _mm256_or_si256((x), _mm256_xor_si256((z), ones)))
+#define AVX2_STEP(f, a, b, c, d, k, s, ac) { \
+    (a) = _mm256_add_epi32((a), _mm256_add_epi32(w[k], _mm256_set1_epi32((int)(ac)))); \
+    (a) = _mm256_add_epi32((a), f((b), (c), (d))); \
+    (a) = _mm256_or_si256(_mm256_slli_epi32((a), (s)), _mm256_srli_epi32((a), 32 - (s))); \
+    (a) = _mm256_add_epi32((a), (b)); \
+}
+#define AVX2_FF(a, b, c, d, k, s, ac) AVX2_STEP(AVX2_F, a, b, c, d, k, s, ac)
+#define AVX2_GG(a, b, c, d, k, s, ac) AVX2_STEP(AVX2_G, a, b, c, d, k, s, ac)
+#define AVX2_HH(a, b, c, d, k, s, ac) AVX2_STEP(AVX2_H, a, b, c, d, k, s, ac)
+#define AVX2_II(a, b, c, d, k, s, ac) AVX2_STEP(AVX2_I, a, b, c, d, k, s, ac)
+
+// Words 8h..8h+7 of eight lanes, transposed to one vector per word
+__attribute__((target("avx2")))
+static inline void transpose_avx2(const uint8_t *const ptr[8], int h, __m256i *w) {
+    __m256i r[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm256_loadu_si256((const __m256i *)(ptr[i] + 32 * h));
+
+    // Pairs of lanes interleaved, then quads, within each 128-bit half
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    // Low halves hold words 0-3 of the group, high halves words 4-7
+    w[8 * h] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    w[8 * h + 1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    w[8 * h + 2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    w[8 * h + 3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    w[8 * h + 4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    w[8 * h + 5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    w[8 * h + 6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    w[8 * h + 7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void transform_avx2(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks) {
+    const uint8_t *ptr[8];
+    size_t stride[8];
+    uint32_t state[4][MD5_MB_MAX_LANES];
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i w[16];
+
+    prepare_lanes(ctx, data, 8, ptr, stride, state);
+    __m256i a = _mm256_loadu_si256((const __m256i *)state[0]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)state[1]);
+    __m256i c = _mm256_loadu_si256((const __m256i *)state[2]);
+    __m256i d = _mm256_loadu_si256((const __m256i *)state[3]);
+
+    for (; blocks > 0; blocks--) {
+        __m256i aa = a, bb = b, cc = c, dd = d;
+        transpose_avx2(ptr, 0, w);
+        transpose_avx2(ptr, 1, w);
+        MD5_STEPS(AVX2_FF, AVX2_GG, AVX2_HH, AVX2_II);
+        a = _mm256_add_epi32(a, aa);
+        b = _mm256_add_epi32(b, bb);
+        c = _mm256_add_epi32(c, cc);
+        d = _mm256_add_epi32(d, dd);
+        for (int i = 0; i < 8; i++) ptr[i] += stride[i];
+    }
+
+    _mm256_storeu_si256((__m256i *)state[0], a);
+    _mm256_storeu_si256((__m256i *)state[1], b);
+    _mm256_storeu_si256((__m256i *)state[2], c);
+    _mm256_storeu_si256((__m256i *)state[3], d);
+    store_lanes(ctx, 8, state);
+}
+
+// AVX-512 does each round function in one ternary-logic op and rotates natively
+#define AVX512_F(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0xca)
+#define AVX512_G(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0xe4)
+#define AVX512_H(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0x96)
+#define AVX512_I(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0x39)
+#define AVX512_STEP(f, a, b, c, d, k, s, ac) { \
+    (a) = _mm512_add_epi32((a), _mm512_add_epi32(w[k], _mm512_set1_epi32((int)(ac)))); \
+    (a) = _mm512_add_epi32((a), f((b), (c), (d))); \
+    (a) = _mm512_rol_epi32((a), (s)); \
+    (a) = _mm512_add_epi32((a), (b)); \
+}
+#define AVX512_FF(a, b, c, d, k, s, ac) AVX512_STEP(AVX512_F, a, b, c, d, k, s, ac)
+#define AVX512_GG(a, b, c, d, k, s, ac) AVX512_STEP(AVX512_G, a, b, c, d, k, s, ac)
+#define AVX512_HH(a, b, c, d, k, s, ac) AVX512_STEP(AVX512_H, a, b, c, d, k, s, ac)
+#define AVX512_II(a, b, c, d, k, s, ac) AVX512_STEP(AVX512_I, a, b, c, d, k, s, ac)
+
+__attribute__((target("avx512f")))
+static void transform_avx512(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks) {
+    const uint8_t *ptr[16];
+    size_t stride[16];
+    uint32_t state[4][MD5_MB_MAX_LANES];
+    __m256i low[16];
+    __m256i high[16];
+    __m512i w[16];
+
+    prepare_lanes(ctx, data, 16, ptr, stride, state);
+    __m512i a = _mm512_loadu_si512(state[0]);
+    __m512i b = _mm512_loadu_si512(state[1]);
+    __m512i c = _mm512_loadu_si512(state[2]);
+    __m512i d = _mm512_loadu_si512(state[3]);
+
+    for (; blocks > 0; blocks--) {
+        __m512i aa = a, bb = b, cc = c, dd = d;
+
+        // Lanes 0-7 and 8-15 are transposed separately and joined per word
+        transpose_avx2(ptr, 0, low);
+        transpose_avx2(ptr, 1, low);
+        transpose_avx2(ptr + 8, 0, high);
+        transpose_avx2(ptr + 8, 1, high);
+        for (int i = 0; i < 16; i++) {
+            w[i] = _mm512_inserti64x4(_mm512_castsi256_si512(low[i]), high[i], 1);
+        }
+
+        MD5_STEPS(AVX512_FF, AVX512_GG, AVX512_HH, AVX512_II);
+        a = _mm512_add_epi32(a, aa);
+        b = _mm512_add_epi32(b, bb);
+        c = _mm512_add_epi32(c, cc);
+        d = _mm512_add_epi32(d, dd);
+        for (int i = 0; i < 16; i++) ptr[i] += stride[i];
+    }
+
+    _mm512_storeu_si512(state[0], a);
+    _mm512_storeu_si512(state[1], b);
+    _mm512_storeu_si512(state[2], c);
+    _mm512_storeu_si512(state[3], d);
+    store_lanes(ctx, 16, state);
+}
+#endif
+
+static void select_kernel(void) {
+    if (active_transform) return;
+    md5_mb_set_kernel(MD5_MB_AUTO);
+}
+
+int md5_mb_set_kernel(md5_mb_kernel_t kernel) {
+#ifdef MD5_MB_X86
+    __builtin_cpu_init();
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_sse2 = __builtin_cpu_supports("sse2");
+#else
+    int has_avx512 = 0;
+    int has_avx2 = 0;
+    int has_sse2 = 0;
+#endif
+
+    if (kernel == MD5_MB_AUTO) {
+        kernel = has_avx512 ? MD5_MB_AVX512 : has_avx2 ? MD5_MB_AVX2 :
+                 has_sse2 ? MD5_MB_SSE2 : MD5_MB_SCALAR;
+    }
+
+    switch (kernel) {
+        case MD5_MB_SCALAR:
+            active_transform = transform_scalar;
+            active_lanes = 1;
+            break;
+#ifdef MD5_MB_X86
+        case MD5_MB_SSE2:
+            if (!has_sse2) return -1;
+            active_transform = transform_sse2;
+            active_lanes = 4;
+            break;
+        case MD5_MB_AVX2:
+            if (!has_avx2) return -1;
+            active_transform = transform_avx2;
+            active_lanes = 8;
+            break;
+        case MD5_MB_AVX512:
+            if (!has_avx512) return -1;
+            active_transform = transform_avx512;
+            active_lanes = 16;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+md5_mb_kernel_t md5_mb_kernel(void) {
+    select_kernel();
+    return active_kernel;
+}
+
+const char *md5_mb_kernel_name(md5_mb_kernel_t kernel) {
+    switch (kernel) {
+        case MD5_MB_AUTO:   return "auto";
+        case MD5_MB_SCALAR: return "scalar";
+        case MD5_MB_SSE2:   return "sse2";
+        case MD5_MB_AVX2:   return "avx2";
+        case MD5_MB_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+int md5_mb_lanes(void) {
+    select_kernel();
+    return active_lanes;
+}
+
+void md5_mb_update(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks) {
+    select_kernel();
+    if (blocks == 0) return;
+    active_transform(ctx, data, blocks);
+    if (active_kernel == MD5_MB_SCALAR) return;
+
+    // The SIMD kernels only move the state; account for the bits here
+    uint32_t bits = (uint32_t)(blocks << 9);
+    for (int i = 0; i < active_lanes; i++) {
+        if (!ctx[i]) continue;
+        if ((ctx[i]->count[0] += bits) < bits) ctx[i]->count[1]++;
+        ctx[i]->count[1] += (uint32_t)(blocks >> 23);
+    }
+}
+
+// A file occupying one lane
+typedef struct {
+    int fd;                 // -1 when the lane is idle
+    void *cookie;
+    MD5_CTX md5;
+    uint8_t *buffer;
+    size_t start;           // Unhashed bytes are buffer[start, end)
+    size_t end;
+    int eof;
+} lane_t;
+
+// Read more of a lane's file behind its unhashed tail; -1 on error
+static int fill_lane(lane_t *lane) {
+    size_t rest = lane->end - lane->start;
+    if (rest > 0 && lane->start > 0) memmove(lane->buffer, lane->buffer + lane->start, rest);
+    lane->start = 0;
+    lane->end = rest;
+
+    for (;;) {
+        ssize_t bytes_read = read(lane->fd, lane->buffer + lane->end, MD5_MB_BUFFER_SIZE - lane->end);
+        if (bytes_read > 0) {
+            lane->end += (size_t)bytes_read;
+            return 0;
+        } else if (bytes_read == 0) {
+            lane->eof = 1;
+            return 0;
+        } else if (errno == EINVAL) {
+            // O_DIRECT refused the read (unaligned tail): continue buffered
+            int flags = fcntl(lane->fd, F_GETFL);
+            if (flags < 0 || !(flags & O_DIRECT) || fcntl(lane->fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+                return -1;
+            }
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+static void finish_lane(lane_t *lane, int status, md5_mb_done_fn done, void *user_data) {
+    char md5_string[33];
+
+    close(lane->fd);
+    lane->fd = -1;
+    if (status == 0) {
+        uint8_t digest[16];
+        md5_update(&lane->md5, lane->buffer + lane->start, lane->end - lane->start);
+        md5_final(&lane->md5, digest);
+        md5_to_string(digest, md5_string);
+    }
+    done(user_data, lane->cookie, status, status == 0 ? md5_string : NULL);
+}
+
+int md5_mb_run(int dir_fd, md5_mb_next_fn next, md5_mb_done_fn done, void *user_data) {
+    int lanes = md5_mb_lanes();
+    lane_t lane[MD5_MB_MAX_LANES];
+    void *buffers;
+
+    // Aligned for O_DIRECT reads
+    if (posix_memalign(&buffers, CALC_MD5_DIRECT_ALIGNMENT, (size_t)lanes * MD5_MB_BUFFER_SIZE) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < lanes; i++) {
+        lane[i].fd = -1;
+        lane[i].buffer = (uint8_t *)buffers + (size_t)i * MD5_MB_BUFFER_SIZE;
+    }
+
+    int busy = 0;
+    int source_done = 0;
+    for (;;) {
+        // Give idle lanes new files; block only when there is nothing to hash
+        for (int i = 0; i < lanes && !source_done; i++) {
+            while (lane[i].fd < 0) {
+                md5_mb_file_t file;
+                int got = next(user_data, busy == 0, &file);
+                if (got < 0) source_done = 1;
+                if (got <= 0) break;
+
+                lane[i].fd = calc_md5_open_at(dir_fd, file.path);
+                if (lane[i].fd < 0) {
+                    done(user_data, file.ctx, -1, NULL);
+                    continue;
+                }
+                lane[i].cookie = file.ctx;
+                lane[i].start = 0;
+                lane[i].end = 0;
+                lane[i].eof = 0;
+                md5_init(&lane[i].md5);
+                busy++;
+            }
+        }
+        if (busy == 0) {
+            if (source_done) break;
+            continue;
+        }
+
+        // Every busy lane needs a whole block, or its file is complete
+        MD5_CTX *ctx[MD5_MB_MAX_LANES];
+        const uint8_t *data[MD5_MB_MAX_LANES];
+        size_t blocks = SIZE_MAX;
+        int ready = 0;
+        int last = 0;
+        for (int i = 0; i < lanes; i++) {
+            ctx[i] = NULL;
+            data[i] = NULL;
+            if (lane[i].fd < 0) continue;
+
+            int status = 0;
+            while (status == 0 && lane[i].end - lane[i].start < 64 && !lane[i].eof) {
+                status = fill_lane(&lane[i]);
+            }
+            if (status != 0 || lane[i].end - lane[i].start < 64) {
+                finish_lane(&lane[i], status, done, user_data);
+                busy--;
+                continue;
+            }
+
+            ctx[i] = &lane[i].md5;
+            data[i] = lane[i].buffer + lane[i].start;
+            size_t available = (lane[i].end - lane[i].start) / 64;
+            if (available < blocks) blocks = available;
+            ready++;
+            last = i;
+        }
+        if (ready == 0) continue;
+
+        if (ready == 1) {
+            md5_update(ctx[last], data[last], blocks * 64);
+        } else {
+            md5_mb_update(ctx, data, blocks);
+        }
+        for (int i = 0; i < lanes; i++) {
+            if (ctx[i]) lane[i].start += blocks * 64;
+        }
+    }
+
+    free(buffers);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef MD5_MB_H
+#define MD5_MB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../calc_md5/calc_md5.h"
+
+#define MD5_MB_MAX_LANES 16
+#define MD5_MB_BUFFER_SIZE (64 * 1024)
+
+// Multi-buffer transform kernels
+typedef enum {
+    MD5_MB_AUTO,            // Widest kernel the CPU supports
+    MD5_MB_SCALAR,          // One lane, the scalar transform
+    MD5_MB_SSE2,            // 4 lanes
+    MD5_MB_AVX2,            // 8 lanes
+    MD5_MB_AVX512           // 16 lanes
+} md5_mb_kernel_t;
+
+/**
+ * Select the kernel used by md5_mb_update() and md5_mb_run()
+ *
+ * @param kernel Kernel, or MD5_MB_AUTO for the widest supported one
+ * @return 0 on success, -1 if the CPU or build does not support it
+ */
+int md5_mb_set_kernel(md5_mb_kernel_t kernel);
+
+// Kernel currently in use (never MD5_MB_AUTO)
+md5_mb_kernel_t md5_mb_kernel(void);
+
+const char *md5_mb_kernel_name(md5_mb_kernel_t kernel);
+
+// Number of lanes of the kernel in use
+int md5_mb_lanes(void);
+
+/**
+ * Hash the same number of whole blocks into several independent contexts
+ *
+ * Lane i feeds blocks * 64 bytes from data[i] into ctx[i], interleaved in
+ * the SIMD lanes of the kernel. Every context must be on a block boundary
+ * (only whole blocks fed since md5_init()); a NULL context marks an idle
+ * lane whose data pointer is ignored.
+ *
+ * @param ctx md5_mb_lanes() contexts, NULL for idle lanes
+ * @param data md5_mb_lanes() data pointers
+ * @param blocks Number of 64-byte blocks per lane
+ */
+void md5_mb_update(MD5_CTX *const ctx[], const uint8_t *const data[], size_t blocks);
+
+// File handed to the multi-buffer engine
+typedef struct {
+    const char *path;  // Path relative to the engine's directory descriptor
+    void *ctx;         // Caller cookie returned in the completion callback
+} md5_mb_file_t;
+
+/**
+ * Fetch the next file to hash
+ *
+ * @param user_data Engine user data
+ * @param wait Non-zero when every lane is idle and the call may block
+ * @param file Filled with the next file
+ * @return 1 if a file was returned, 0 if none is ready yet, -1 when done
+ */
+typedef int (*md5_mb_next_fn)(void *user_data, int wait, md5_mb_file_t *file);
+
+// Completion callback; md5_string is NULL when status is non-zero
+typedef void (*md5_mb_done_fn)(void *user_data, void *ctx, int status, const char *md5_string);
+
+/**
+ * Hash files several at a time, one per SIMD lane
+ *
+ * Every lane owns a read buffer of MD5_MB_BUFFER_SIZE bytes and an open
+ * file. Each round hashes the whole blocks that all busy lanes have
+ * buffered with one md5_mb_update() call; a lane whose buffer runs dry
+ * reads its file again, and a lane whose file ends finishes the digest
+ * and is refilled from next() without waiting for the other lanes. When
+ * only one lane is busy its blocks go through the scalar transform.
+ * Files are opened with O_DIRECT when calc_md5_options_t.direct_io is set.
+ *
+ * @param dir_fd Directory that file paths are relative to
+ * @param next Source of files
+ * @param done Called once per file
+ * @param user_data Passed through to the callbacks
+ * @return 0 on success, -1 if the buffers could not be allocated
+ */
+int md5_mb_run(int dir_fd, md5_mb_next_fn next, md5_mb_done_fn done, void *user_data);
+
+#endif // MD5_MB_H
@@ -0,0 +1,391 @@
+#define _GNU_SOURCE
+#include "path_join.h"
+#include "../scan_reader/scan_reader.h"
+#include "../digest_table/digest_table.h"
+#include "../compare_output/compare_output.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_ENTRIES 1024
+#define MIN_POOL_SIZE (64 * 1024)
+
+typedef struct {
+    uint64_t path;          // Offset into the string pool
+    size_t seq;             // Position in the scan, keeps the sort stable
+    unsigned char digest[DIGEST_SIZE];
+} path_entry_t;
+
+// One scan reduced to what the join needs
+typedef struct {
+    path_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    char *pool;
+    size_t pool_used;
+    size_t pool_size;
+    size_t skipped;         // Records with a malformed digest
+    int sorted;             // Records arrived in strictly increasing path order
+    calc_hash_t hash;       // Algorithm the scans are compared by
+} path_list_t;
+
+// Paths left unmatched by the merge, as positions into one list in path order
+typedef struct {
+    const path_list_t *list;
+    size_t *positions;
+    size_t count;
+    size_t capacity;
+} residue_t;
+
+static const char *const diff_statuses[] = {"added", "removed", "modified", "moved", NULL};
+
+static const char *entry_path(const path_list_t *list, const path_entry_t *entry) {
+    return list->pool + entry->path;
+}
+
+// Record callback: append one record to the list
+static int add_record(const scan_record_t *record, void *user_data) {
+    path_list_t *list = (path_list_t *)user_data;
+    unsigned char digest[DIGEST_SIZE];
+
+    const char *hex = record->digests[list->hash];
+    if (!hex || digest_from_hex(hex, calc_hash_digest_size(list->hash), digest) != 0) {
+        list->skipped++;
+        return 0;
+    }
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : MIN_ENTRIES;
+        path_entry_t *entries = realloc(list->entries, capacity * sizeof(path_entry_t));
+        if (!entries) return -1;
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+
+    size_t length = strlen(record->path) + 1;
+    if (length > list->pool_size - list->pool_used) {
+        size_t size = list->pool_size ? list->pool_size * 2 : MIN_POOL_SIZE;
+        while (length > size - list->pool_used) size *= 2;
+        char *pool = realloc(list->pool, size);
+        if (!pool) return -1;
+        list->pool = pool;
+        list->pool_size = size;
+    }
+
+    if (list->sorted && list->count > 0 &&
+        strcmp(entry_path(list, &list->entries[list->count - 1]), record->path) >= 0) {
+        list->sorted = 0;
+    }
+
+    path_entry_t *entry = &list->entries[list->count];
+    entry->path = list->pool_used;
+    entry->seq = list->count;
+    memcpy(entry->digest, digest, DIGEST_SIZE);
+    memcpy(list->pool + list->pool_used, record->path, length);
+    list->pool_used += length;
+    list->count++;
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b, void *arg) {
+    const path_list_t *list = (const path_list_t *)arg;
+    const path_entry_t *entry_a = (const path_entry_t *)a;
+    const path_entry_t *entry_b = (const path_entry_t *)b;
+
+    int result = strcmp(entry_path(list, entry_a), entry_path(list, entry_b));
+    if (result != 0) return result;
+    return entry_a->seq < entry_b->seq ? -1 : entry_a->seq > entry_b->seq;
+}
+
+// Bring the list into path order and keep only the last record of each path
+static void sort_list(path_list_t *list) {
+    if (list->sorted) return;
+
+    qsort_r(list->entries, list->count, sizeof(path_entry_t), compare_entries, list);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (i + 1 < list->count &&
+            strcmp(entry_path(list, &list->entries[i]),
+                   entry_path(list, &list->entries[i + 1])) == 0) {
+            continue;
+        }
+        list->entries[kept++] = list->entries[i];
+    }
+    list->count = kept;
+    list->sorted = 1;
+}
+
+static int load_list(const char *filepath, calc_hash_t hash, path_list_t *list) {
+    memset(list, 0, sizeof(path_list_t));
+    list->sorted = 1;
+    list->hash = hash;
+
+    if (scan_reader_read(filepath, add_record, list) != 0) {
+        fprintf(stderr, "Error: Failed to load %s\n", filepath);
+        return -1;
+    }
+    if (list->skipped > 0) {
+        fprintf(stderr, "Warning: Skipped %zu records with invalid %s in %s\n",
+                list->skipped, calc_hash_name(hash), filepath);
+    }
+    sort_list(list);
+    return 0;
+}
+
+static void free_list(path_list_t *list) {
+    free(list->entries);
+    free(list->pool);
+}
+
+static int residue_add(residue_t *residue, size_t position) {
+    if (residue->count == residue->capacity) {
+        size_t capacity = residue->capacity ? residue->capacity * 2 : MIN_ENTRIES;
+        size_t *positions = realloc(residue->positions, capacity * sizeof(size_t));
+        if (!positions) return -1;
+        residue->positions = positions;
+        residue->capacity = capacity;
+    }
+    residue->positions[residue->count++] = position;
+    return 0;
+}
+
+// Order residue slots by digest, then by path so pairing follows path order
+static int compare_residue_digests(const void *a, const void *b, void *arg) {
+    const residue_t *residue = (const residue_t *)arg;
+    size_t position_a = residue->positions[*(const size_t *)a];
+    size_t position_b = residue->positions[*(const size_t *)b];
+
+    int result = memcmp(residue->list->entries[position_a].digest,
+                        residue->list->entries[position_b].digest, DIGEST_SIZE);
+    if (result != 0) return result;
+    return position_a < position_b ? -1 : position_a > position_b;
+}
+
+// Slots 0..count-1 of a residue sorted by digest
+static size_t *sort_residue(const residue_t *residue) {
+    size_t *order = malloc((residue->count ? residue->count : 1) * sizeof(size_t));
+    if (!order) return NULL;
+    for (size_t i = 0; i < residue->count; i++) order[i] = i;
+    qsort_r(order, residue->count, sizeof(size_t), compare_residue_digests, (void *)residue);
+    return order;
+}
+
+/**
+ * Pair removed and added paths that share a digest
+ *
+ * Only the residue of the path merge takes part, so the cost follows the
+ * number of changes rather than the tree size. Within one digest the n-th
+ * removed path pairs with the n-th added path.
+ *
+ * @param removed Paths only in file1
+ * @param added Paths only in file2
+ * @param moved_from Per added slot, the list1 position it moved from or SIZE_MAX
+ * @param moved_away Per removed slot, non-zero if it was paired
+ * @return Number of moves, or -1 on allocation failure
+ */
+static long pair_moves(const residue_t *removed, const residue_t *added,
+                       size_t *moved_from, char *moved_away) {
+    size_t *order1 = sort_residue(removed);
+    size_t *order2 = sort_residue(added);
+    if (!order1 || !order2) {
+        free(order1);
+        free(order2);
+        return -1;
+    }
+
+    long moves = 0;
+    size_t i = 0, j = 0;
+    while (i < removed->count && j < added->count) {
+        size_t position1 = removed->positions[order1[i]];
+        size_t position2 = added->positions[order2[j]];
+        int result = memcmp(removed->list->entries[position1].digest,
+                            added->list->entries[position2].digest, DIGEST_SIZE);
+        if (result < 0) {
+            i++;
+        } else if (result > 0) {
+            j++;
+        } else {
+            moved_from[order2[j]] = position1;
+            moved_away[order1[i]] = 1;
+            moves++;
+            i++;
+            j++;
+        }
+    }
+
+    free(order1);
+    free(order2);
+    return moves;
+}
+
+int compare_scan_paths(const char *file1_path, const char *file2_path,
+                       const char *diff_output_path, const char *same_output_path) {
+    if (!file1_path || !file2_path || !diff_output_path || !same_output_path) {
+        fprintf(stderr, "Error: Invalid parameters\n");
+        return -1;
+    }
+
+    calc_hash_t hash;
+    if (scan_reader_check_hash(file1_path, file2_path, &hash) != 0) {
+        return -1;
+    }
+
+    printf("Comparing JSON files by path:\n");
+    printf("  File 1: %s\n", file1_path);
+    printf("  File 2: %s\n", file2_path);
+    printf("  Diff output: %s\n", diff_output_path);
+    printf("  Same output: %s\n", same_output_path);
+    printf("\n");
+
+    path_list_t list1, list2;
+    if (load_list(file1_path, hash, &list1) != 0) {
+        free_list(&list1);
+        return -1;
+    }
+    if (load_list(file2_path, hash, &list2) != 0) {
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    compare_output_t *diff = compare_output_open(diff_output_path, file1_path, file2_path,
+                                                 "Files added, removed, modified or moved by path",
+                                                 "path", hash, "total_differences", diff_statuses);
+    compare_output_t *same = compare_output_open(same_output_path, file1_path, file2_path,
+                                                 "Files unchanged at the same path",
+                                                 "path", hash, "total_matches", NULL);
+    if (!diff || !same) {
+        if (diff) compare_output_close(diff);
+        if (same) compare_output_close(same);
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    // Merge the two path-ordered lists; paths on one side only are held back
+    residue_t removed = {&list1, NULL, 0, 0};
+    residue_t added = {&list2, NULL, 0, 0};
+    size_t modified = 0;
+    size_t i = 0, j = 0;
+    int result = 0;
+    size_t digest_size = calc_hash_digest_size(hash);
+    char hex1[2 * DIGEST_SIZE + 1];
+    char hex2[2 * DIGEST_SIZE + 1];
+    while (result == 0 && (i < list1.count || j < list2.count)) {
+        const path_entry_t *entry1 = i < list1.count ? &list1.entries[i] : NULL;
+        const path_entry_t *entry2 = j < list2.count ? &list2.entries[j] : NULL;
+        int order;
+        if (!entry2) order = -1;
+        else if (!entry1) order = 1;
+        else order = strcmp(entry_path(&list1, entry1), entry_path(&list2, entry2));
+
+        if (order < 0) {
+            result = residue_add(&removed, i++);
+        } else if (order > 0) {
+            result = residue_add(&added, j++);
+        } else {
+            compare_record_t record = {0};
+            digest_to_hex(entry1->digest, digest_size, hex1);
+            record.digest = hex1;
+            record.file1_path = entry_path(&list1, entry1);
+            record.file2_path = entry_path(&list2, entry2);
+            if (memcmp(entry1->digest, entry2->digest, DIGEST_SIZE) == 0) {
+                record.status = "unchanged";
+                compare_output_write(same, &record);
+            } else {
+                digest_to_hex(entry2->digest, digest_size, hex2);
+                record.file2_digest = hex2;
+                record.status = "modified";
+                compare_output_write(diff, &record);
+                modified++;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    // Second join over the residue only: same content at a new path is a move
+    size_t *moved_from = malloc((added.count ? added.count : 1) * sizeof(size_t));
+    char *moved_away = calloc(removed.count ? removed.count : 1, 1);
+    long moves = -1;
+    if (result == 0 && moved_from && moved_away) {
+        for (size_t k = 0; k < added.count; k++) moved_from[k] = SIZE_MAX;
+        moves = pair_moves(&removed, &added, moved_from, moved_away);
+    }
+    if (moves < 0) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(moved_from);
+        free(moved_away);
+        free(removed.positions);
+        free(added.positions);
+        compare_output_close(diff);
+        compare_output_close(same);
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    // Emit the residue in path order; a move is reported at its new path
+    i = 0;
+    j = 0;
+    while (i < removed.count || j < added.count) {
+        const path_entry_t *entry1 = i < removed.count ? &list1.entries[removed.positions[i]] : NULL;
+        const path_entry_t *entry2 = j < added.count ? &list2.entries[added.positions[j]] : NULL;
+        int take_removed;
+        if (!entry2) take_removed = 1;
+        else if (!entry1) take_removed = 0;
+        else take_removed = strcmp(entry_path(&list1, entry1), entry_path(&list2, entry2)) < 0;
+
+        compare_record_t record = {0};
+        if (take_removed) {
+            if (!moved_away[i]) {
+                digest_to_hex(entry1->digest, digest_size, hex1);
+                record.digest = hex1;
+                record.file1_path = entry_path(&list1, entry1);
+                record.status = "removed";
+                compare_output_write(diff, &record);
+            }
+            i++;
+        } else {
+            digest_to_hex(entry2->digest, digest_size, hex2);
+            record.digest = hex2;
+            record.file2_path = entry_path(&list2, entry2);
+            if (moved_from[j] != SIZE_MAX) {
+                record.file1_path = entry_path(&list1, &list1.entries[moved_from[j]]);
+                record.status = "moved";
+            } else {
+                record.status = "added";
+            }
+            compare_output_write(diff, &record);
+            j++;
+        }
+    }
+
+    size_t removed_count = removed.count - (size_t)moves;
+    size_t added_count = added.count - (size_t)moves;
+    free(moved_from);
+    free(moved_away);
+    free(removed.positions);
+    free(added.positions);
+
+    size_t unchanged = compare_output_count(same);
+    if (compare_output_close(diff) != 0) {
+        fprintf(stderr, "Error: Failed to write diff output file %s\n", diff_output_path);
+        result = -1;
+    }
+    if (compare_output_close(same) != 0) {
+        fprintf(stderr, "Error: Failed to write same output file %s\n", same_output_path);
+        result = -1;
+    }
+    free_list(&list1);
+    free_list(&list2);
+    if (result != 0) return -1;
+
+    printf("Comparison completed successfully!\n");
+    printf("Unchanged files: %zu (saved to %s)\n", unchanged, same_output_path);
+    printf("Added: %zu, removed: %zu, modified: %zu, moved: %ld (saved to %s)\n",
+           added_count, removed_count, modified, moves, diff_output_path);
+    return 0;
+}
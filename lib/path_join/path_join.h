@@ -0,0 +1,25 @@
+#ifndef PATH_JOIN_H
+#define PATH_JOIN_H
+
+/**
+ * Compare two scans by relative path in a single merge pass
+ *
+ * Both scans are loaded into compact (path, digest) arrays, sorted by path
+ * unless they are already in order, and merged once. Paths only in file1
+ * are reported as "removed", paths only in file2 as "added", and paths in
+ * both with different digests as "modified"; these go to the diff output.
+ * Paths whose digest is unchanged go to the same output as "unchanged".
+ * A second join by digest over just the removed and added paths turns
+ * pairs with the same content into a single "moved" record.
+ * If a scan lists a path more than once, its last record wins.
+ *
+ * @param file1_path Path to the first (older) scan file
+ * @param file2_path Path to the second (newer) scan file
+ * @param diff_output_path Output path for added/removed/modified/moved records
+ * @param same_output_path Output path for unchanged records
+ * @return 0 on success, -1 on error
+ */
+int compare_scan_paths(const char *file1_path, const char *file2_path,
+                       const char *diff_output_path, const char *same_output_path);
+
+#endif // PATH_JOIN_H
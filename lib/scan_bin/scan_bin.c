@@ -0,0 +1,508 @@
+#define _GNU_SOURCE
+#include "scan_bin.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC_SIZE 8
+#define HEADER_SIZE 16
+#define FOOTER_SIZE 56
+#define MAX_VARINT 10
+#define MIN_ENTRIES 1024
+#define MIN_POOL_SIZE (64 * 1024)
+
+static const char header_magic[MAGIC_SIZE] = {'M', 'D', '5', 'S', 'C', 'A', 'N', 'B'};
+static const char footer_magic[MAGIC_SIZE] = {'M', 'D', '5', 'S', 'C', 'A', 'N', 'F'};
+
+// A record waiting for the sort
+typedef struct {
+    uint64_t path;          // Offset into the string pool
+    uint32_t length;
+    int has_stamp;
+    unsigned char digest[SCAN_BIN_DIGEST_SIZE];
+    scan_stamp_t stamp;
+} bin_record_t;
+
+struct scan_bin_writer {
+    FILE *out;
+    bin_record_t *records;
+    size_t count;
+    size_t capacity;
+    char *pool;
+    size_t pool_used;
+    size_t pool_size;
+    uint64_t offset;        // Bytes written so far
+    int failed;
+};
+
+struct scan_bin {
+    const unsigned char *data;
+    size_t size;
+    size_t count;
+    uint64_t info_offset;
+    uint64_t digests_offset;
+    uint64_t paths_offset;
+    uint64_t stamps_offset;
+    uint64_t stamps_end;
+    scan_info_t info;
+    char *info_strings;     // Backing store of info's strings
+};
+
+// Delta-coded stamp fields of the previous stamped record
+typedef struct {
+    int64_t mtime_ns;
+    uint64_t inode;
+    uint64_t dev;
+} stamp_base_t;
+
+// Bounded reader over one column
+typedef struct {
+    const unsigned char *data;
+    size_t position;
+    size_t end;
+} column_t;
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static void put_u64(unsigned char *out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | in[i];
+    return value;
+}
+
+static uint64_t get_u64(const unsigned char *in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | in[i];
+    return value;
+}
+
+static void write_bytes(scan_bin_writer_t *writer, const void *data, size_t length) {
+    if (length > 0 && fwrite(data, 1, length, writer->out) != length) writer->failed = 1;
+    writer->offset += length;
+}
+
+static void write_varint(scan_bin_writer_t *writer, uint64_t value) {
+    unsigned char buffer[MAX_VARINT];
+    size_t length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (unsigned char)value;
+    write_bytes(writer, buffer, length);
+}
+
+// Strings are stored as varint length + 1 (0 for NULL) followed by the bytes
+static void write_text(scan_bin_writer_t *writer, const char *text) {
+    if (!text) {
+        write_varint(writer, 0);
+        return;
+    }
+    size_t length = strlen(text);
+    write_varint(writer, (uint64_t)length + 1);
+    write_bytes(writer, text, length);
+}
+
+scan_bin_writer_t *scan_bin_writer_create(FILE *out) {
+    scan_bin_writer_t *writer = calloc(1, sizeof(scan_bin_writer_t));
+    if (!writer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    writer->out = out;
+    return writer;
+}
+
+int scan_bin_writer_add(scan_bin_writer_t *writer, const char *path,
+                        const unsigned char digest[SCAN_BIN_DIGEST_SIZE],
+                        const scan_stamp_t *stamp) {
+    size_t length = strlen(path);
+    if (length > UINT32_MAX) return -1;
+
+    if (writer->count == writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity * 2 : MIN_ENTRIES;
+        bin_record_t *records = realloc(writer->records, capacity * sizeof(bin_record_t));
+        if (!records) return -1;
+        writer->records = records;
+        writer->capacity = capacity;
+    }
+    if (length + 1 > writer->pool_size - writer->pool_used) {
+        size_t size = writer->pool_size ? writer->pool_size * 2 : MIN_POOL_SIZE;
+        while (length + 1 > size - writer->pool_used) size *= 2;
+        char *pool = realloc(writer->pool, size);
+        if (!pool) return -1;
+        writer->pool = pool;
+        writer->pool_size = size;
+    }
+
+    bin_record_t *record = &writer->records[writer->count++];
+    record->path = writer->pool_used;
+    record->length = (uint32_t)length;
+    memcpy(record->digest, digest, SCAN_BIN_DIGEST_SIZE);
+    record->has_stamp = stamp != NULL;
+    if (stamp) record->stamp = *stamp;
+    memcpy(writer->pool + writer->pool_used, path, length + 1);
+    writer->pool_used += length + 1;
+    return 0;
+}
+
+static int compare_records(const void *a, const void *b, void *arg) {
+    const char *pool = (const char *)arg;
+    const bin_record_t *record_a = (const bin_record_t *)a;
+    const bin_record_t *record_b = (const bin_record_t *)b;
+
+    int result = strcmp(pool + record_a->path, pool + record_b->path);
+    if (result != 0) return result;
+    // Equal paths keep scan order, as the pool offsets grow with it
+    return record_a->path < record_b->path ? -1 : record_a->path > record_b->path;
+}
+
+static void write_stamp(scan_bin_writer_t *writer, const bin_record_t *record,
+                        stamp_base_t *base) {
+    unsigned char flag = record->has_stamp ? 1 : 0;
+    write_bytes(writer, &flag, 1);
+    if (!record->has_stamp) return;
+
+    const scan_stamp_t *stamp = &record->stamp;
+    write_varint(writer, stamp->size);
+    write_varint(writer, zigzag((int64_t)((uint64_t)stamp->mtime_ns - (uint64_t)base->mtime_ns)));
+    write_varint(writer, zigzag((int64_t)((uint64_t)stamp->ctime_ns - (uint64_t)stamp->mtime_ns)));
+    write_varint(writer, zigzag((int64_t)(stamp->inode - base->inode)));
+    write_varint(writer, zigzag((int64_t)(stamp->dev - base->dev)));
+    base->mtime_ns = stamp->mtime_ns;
+    base->inode = stamp->inode;
+    base->dev = stamp->dev;
+}
+
+int scan_bin_writer_finish(scan_bin_writer_t *writer, const scan_info_t *info) {
+    unsigned char header[HEADER_SIZE];
+    unsigned char footer[FOOTER_SIZE];
+    uint64_t info_offset, digests_offset, paths_offset, stamps_offset;
+
+    if (writer->count > 1) {
+        qsort_r(writer->records, writer->count, sizeof(bin_record_t), compare_records,
+                writer->pool);
+    }
+
+    memcpy(header, header_magic, MAGIC_SIZE);
+    put_u32(header + 8, SCAN_BIN_VERSION);
+    put_u32(header + 12, (uint32_t)info->hashes[0]);
+    write_bytes(writer, header, HEADER_SIZE);
+
+    info_offset = writer->offset;
+    write_text(writer, info->scanned_directory);
+    write_text(writer, info->scan_time);
+    write_varint(writer, info->total_files);
+    write_varint(writer, info->errors);
+    write_varint(writer, info->has_cached_files ? info->cached_files + 1 : 0);
+
+    digests_offset = writer->offset;
+    for (size_t i = 0; i < writer->count; i++) {
+        write_bytes(writer, writer->records[i].digest, SCAN_BIN_DIGEST_SIZE);
+    }
+
+    // Front coding: each path shares a prefix with the one before it
+    paths_offset = writer->offset;
+    const char *previous = "";
+    uint32_t previous_length = 0;
+    for (size_t i = 0; i < writer->count; i++) {
+        const bin_record_t *record = &writer->records[i];
+        const char *path = writer->pool + record->path;
+        uint32_t shared = 0;
+        uint32_t limit = record->length < previous_length ? record->length : previous_length;
+        while (shared < limit && path[shared] == previous[shared]) shared++;
+
+        write_varint(writer, shared);
+        write_varint(writer, record->length - shared);
+        write_bytes(writer, path + shared, record->length - shared);
+        previous = path;
+        previous_length = record->length;
+    }
+
+    stamps_offset = writer->offset;
+    stamp_base_t base = {0, 0, 0};
+    for (size_t i = 0; i < writer->count; i++) {
+        write_stamp(writer, &writer->records[i], &base);
+    }
+
+    put_u64(footer, writer->count);
+    put_u64(footer + 8, info_offset);
+    put_u64(footer + 16, digests_offset);
+    put_u64(footer + 24, paths_offset);
+    put_u64(footer + 32, stamps_offset);
+    put_u32(footer + 40, SCAN_BIN_VERSION);
+    put_u32(footer + 44, (uint32_t)info->hashes[0]);
+    memcpy(footer + 48, footer_magic, MAGIC_SIZE);
+    write_bytes(writer, footer, FOOTER_SIZE);
+
+    int result = writer->failed || fflush(writer->out) != 0 ? -1 : 0;
+    free(writer->records);
+    free(writer->pool);
+    free(writer);
+    return result;
+}
+
+int scan_bin_probe(const char *filepath) {
+    struct stat statbuf;
+    char magic[MAGIC_SIZE];
+
+    // Never read from pipes: the bytes would be lost to the real reader
+    if (stat(filepath, &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) return 0;
+
+    FILE *file = fopen(filepath, "rb");
+    if (!file) return 0;
+    int match = fread(magic, 1, MAGIC_SIZE, file) == MAGIC_SIZE &&
+                memcmp(magic, header_magic, MAGIC_SIZE) == 0;
+    fclose(file);
+    return match;
+}
+
+static int read_varint(column_t *column, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT; shift += 7) {
+        if (column->position == column->end) return -1;
+        unsigned char byte = column->data[column->position++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Decode a string written by write_text() into storage
+static int read_text(column_t *column, char **storage, const char **text) {
+    uint64_t length;
+    if (read_varint(column, &length) != 0) return -1;
+    if (length == 0) {
+        *text = NULL;
+        return 0;
+    }
+    length--;
+    if (length > column->end - column->position ||
+        memchr(column->data + column->position, '\0', length)) {
+        return -1;
+    }
+    memcpy(*storage, column->data + column->position, length);
+    (*storage)[length] = '\0';
+    *text = *storage;
+    *storage += length + 1;
+    column->position += length;
+    return 0;
+}
+
+static int read_info(scan_bin_t *bin) {
+    column_t column = {bin->data, bin->info_offset, bin->digests_offset};
+    uint64_t cached;
+
+    // Both strings fit in the section size plus their terminators
+    bin->info_strings = malloc(bin->digests_offset - bin->info_offset + 2);
+    if (!bin->info_strings) return -1;
+
+    char *storage = bin->info_strings;
+    if (read_text(&column, &storage, &bin->info.scanned_directory) != 0 ||
+        read_text(&column, &storage, &bin->info.scan_time) != 0 ||
+        read_varint(&column, &bin->info.total_files) != 0 ||
+        read_varint(&column, &bin->info.errors) != 0 ||
+        read_varint(&column, &cached) != 0) {
+        return -1;
+    }
+    bin->info.has_cached_files = cached != 0;
+    bin->info.cached_files = cached ? cached - 1 : 0;
+    return 0;
+}
+
+scan_bin_t *scan_bin_open(const char *filepath) {
+    struct stat statbuf;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filepath);
+        return NULL;
+    }
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) ||
+        (uint64_t)statbuf.st_size < HEADER_SIZE + FOOTER_SIZE) {
+        fprintf(stderr, "Error: Invalid binary scan %s\n", filepath);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)statbuf.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map file %s\n", filepath);
+        return NULL;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    scan_bin_t *bin = calloc(1, sizeof(scan_bin_t));
+    if (!bin) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        munmap(data, size);
+        return NULL;
+    }
+    bin->data = (const unsigned char *)data;
+    bin->size = size;
+
+    const unsigned char *header = bin->data;
+    const unsigned char *footer = bin->data + size - FOOTER_SIZE;
+    if (memcmp(header, header_magic, MAGIC_SIZE) != 0 ||
+        memcmp(footer + 48, footer_magic, MAGIC_SIZE) != 0) {
+        fprintf(stderr, "Error: Invalid binary scan %s\n", filepath);
+        scan_bin_close(bin);
+        return NULL;
+    }
+    if (get_u32(header + 8) != SCAN_BIN_VERSION || get_u32(footer + 40) != SCAN_BIN_VERSION) {
+        fprintf(stderr, "Error: Unsupported binary scan version %u in %s\n",
+                get_u32(header + 8), filepath);
+        scan_bin_close(bin);
+        return NULL;
+    }
+
+    // The flags name the digest algorithm, which must fill the 16-byte column
+    uint32_t flags = get_u32(header + 12);
+    if (flags != get_u32(footer + 44) || flags >= CALC_HASH_COUNT ||
+        calc_hash_digest_size((calc_hash_t)flags) != SCAN_BIN_DIGEST_SIZE) {
+        fprintf(stderr, "Error: Unsupported digest algorithm in binary scan %s\n", filepath);
+        scan_bin_close(bin);
+        return NULL;
+    }
+    bin->info.hashes[0] = (calc_hash_t)flags;
+    bin->info.hash_count = 1;
+
+    uint64_t count = get_u64(footer);
+    bin->info_offset = get_u64(footer + 8);
+    bin->digests_offset = get_u64(footer + 16);
+    bin->paths_offset = get_u64(footer + 24);
+    bin->stamps_offset = get_u64(footer + 32);
+    bin->stamps_end = size - FOOTER_SIZE;
+
+    // Sections must be in order and the digest column exactly count digests wide
+    if (bin->info_offset != HEADER_SIZE || bin->digests_offset < bin->info_offset ||
+        bin->paths_offset < bin->digests_offset || bin->stamps_offset < bin->paths_offset ||
+        bin->stamps_end < bin->stamps_offset ||
+        count != (bin->paths_offset - bin->digests_offset) / SCAN_BIN_DIGEST_SIZE ||
+        (bin->paths_offset - bin->digests_offset) % SCAN_BIN_DIGEST_SIZE != 0 ||
+        read_info(bin) != 0) {
+        fprintf(stderr, "Error: Corrupt binary scan %s\n", filepath);
+        scan_bin_close(bin);
+        return NULL;
+    }
+    bin->count = (size_t)count;
+    return bin;
+}
+
+void scan_bin_close(scan_bin_t *bin) {
+    if (!bin) return;
+    munmap((void *)bin->data, bin->size);
+    free(bin->info_strings);
+    free(bin);
+}
+
+size_t scan_bin_count(const scan_bin_t *bin) {
+    return bin->count;
+}
+
+const scan_info_t *scan_bin_info(const scan_bin_t *bin) {
+    return &bin->info;
+}
+
+static int read_stamp(column_t *column, scan_bin_entry_t *entry, stamp_base_t *base) {
+    uint64_t size, mtime_delta, ctime_delta, inode_delta, dev_delta;
+
+    if (column->position == column->end) return -1;
+    unsigned char flag = column->data[column->position++];
+    if (flag > 1) return -1;
+    entry->has_stamp = flag;
+    if (!flag) return 0;
+
+    if (read_varint(column, &size) != 0 || read_varint(column, &mtime_delta) != 0 ||
+        read_varint(column, &ctime_delta) != 0 || read_varint(column, &inode_delta) != 0 ||
+        read_varint(column, &dev_delta) != 0) {
+        return -1;
+    }
+    scan_stamp_t *stamp = &entry->stamp;
+    stamp->size = size;
+    stamp->mtime_ns = (int64_t)((uint64_t)base->mtime_ns + (uint64_t)unzigzag(mtime_delta));
+    stamp->ctime_ns = (int64_t)((uint64_t)stamp->mtime_ns + (uint64_t)unzigzag(ctime_delta));
+    stamp->inode = base->inode + (uint64_t)unzigzag(inode_delta);
+    stamp->dev = base->dev + (uint64_t)unzigzag(dev_delta);
+    base->mtime_ns = stamp->mtime_ns;
+    base->inode = stamp->inode;
+    base->dev = stamp->dev;
+    return 0;
+}
+
+int scan_bin_read(const scan_bin_t *bin, scan_bin_entry_fn fn, void *user_data) {
+    column_t paths = {bin->data, bin->paths_offset, bin->stamps_offset};
+    column_t stamps = {bin->data, bin->stamps_offset, bin->stamps_end};
+    stamp_base_t base = {0, 0, 0};
+    char *path = NULL;
+    size_t path_length = 0;
+    size_t path_capacity = 0;
+    int result = 0;
+
+    for (size_t i = 0; i < bin->count; i++) {
+        uint64_t shared, suffix;
+        if (read_varint(&paths, &shared) != 0 || read_varint(&paths, &suffix) != 0 ||
+            shared > path_length || suffix > paths.end - paths.position ||
+            memchr(paths.data + paths.position, '\0', suffix)) {
+            result = -1;
+            break;
+        }
+        size_t length = (size_t)(shared + suffix);
+        if (length + 1 > path_capacity) {
+            size_t capacity = path_capacity ? path_capacity : 256;
+            while (length + 1 > capacity) capacity *= 2;
+            char *grown = realloc(path, capacity);
+            if (!grown) {
+                result = -1;
+                break;
+            }
+            path = grown;
+            path_capacity = capacity;
+        }
+        memcpy(path + shared, paths.data + paths.position, suffix);
+        path[length] = '\0';
+        paths.position += suffix;
+        path_length = length;
+
+        scan_bin_entry_t entry;
+        entry.path = path;
+        entry.path_length = length;
+        entry.digest = bin->data + bin->digests_offset + i * SCAN_BIN_DIGEST_SIZE;
+        if (read_stamp(&stamps, &entry, &base) != 0) {
+            result = -1;
+            break;
+        }
+        if (fn(&entry, user_data) != 0) {
+            free(path);
+            return -1;
+        }
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "Error: Corrupt binary scan record\n");
+    }
+    free(path);
+    return result;
+}
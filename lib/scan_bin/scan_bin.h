@@ -0,0 +1,108 @@
+#ifndef SCAN_BIN_H
+#define SCAN_BIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../scan_reader/scan_reader.h"
+
+#define SCAN_BIN_VERSION 1
+#define SCAN_BIN_DIGEST_SIZE 16
+
+/**
+ * Binary scan format (version 1, little-endian)
+ *
+ *   header   "MD5SCANB", u32 version, u32 flags (the calc_hash_t of the
+ *            digests, 0 for MD5; only 128-bit algorithms fit the column)
+ *   info     scan_info: two strings and three counts as varints
+ *   digests  16-byte raw digests, one per record, in path order
+ *   paths    front-coded paths in sorted order: varint shared prefix
+ *            length, varint suffix length, suffix bytes
+ *   stamps   per record a flag byte, then size, mtime, ctime, inode and
+ *            dev as varints, each time/number delta-coded
+ *   footer   u64 record count, u64 offsets of info, digests, paths and
+ *            stamps, u32 version, u32 flags, "MD5SCANF"
+ *
+ * The footer is the index of the file: a reader maps the file, reads the
+ * fixed-size footer from its end and addresses every column from there.
+ */
+
+typedef struct scan_bin_writer scan_bin_writer_t;
+typedef struct scan_bin scan_bin_t;
+
+// One record of a binary scan; path and digest are only valid during the callback
+typedef struct {
+    const char *path;           // NUL-terminated
+    size_t path_length;
+    const unsigned char *digest;
+    int has_stamp;
+    scan_stamp_t stamp;
+} scan_bin_entry_t;
+
+// Called for every record in path order; return non-zero to stop reading
+typedef int (*scan_bin_entry_fn)(const scan_bin_entry_t *entry, void *user_data);
+
+/**
+ * Create a writer for a binary scan
+ *
+ * Paths must be sorted before they can be front-coded, so records are
+ * kept in memory (digest, stamp and one copy of the path each) until
+ * scan_bin_writer_finish() writes the whole file.
+ *
+ * @param out Output stream, left open
+ * @return Writer or NULL on error
+ */
+scan_bin_writer_t *scan_bin_writer_create(FILE *out);
+
+/**
+ * Add one record
+ *
+ * @param writer Writer
+ * @param path Path relative to the scanned directory
+ * @param digest Binary digest
+ * @param stamp File metadata, NULL if unknown
+ * @return 0 on success, -1 on allocation failure
+ */
+int scan_bin_writer_add(scan_bin_writer_t *writer, const char *path,
+                        const unsigned char digest[SCAN_BIN_DIGEST_SIZE],
+                        const scan_stamp_t *stamp);
+
+/**
+ * Sort the records by path, write the file and free the writer
+ *
+ * @param writer Writer to finish
+ * @param info scan_info stored with the records
+ * @return 0 if every write succeeded, -1 otherwise
+ */
+int scan_bin_writer_finish(scan_bin_writer_t *writer, const scan_info_t *info);
+
+// Non-zero if filepath is a regular file starting with the binary scan magic
+int scan_bin_probe(const char *filepath);
+
+/**
+ * Map a binary scan read-only and validate its footer
+ *
+ * @param filepath Path to a binary scan
+ * @return Scan or NULL on error (reported on stderr)
+ */
+scan_bin_t *scan_bin_open(const char *filepath);
+
+void scan_bin_close(scan_bin_t *bin);
+
+// Number of records
+size_t scan_bin_count(const scan_bin_t *bin);
+
+// scan_info of the scan; strings stay valid until scan_bin_close()
+const scan_info_t *scan_bin_info(const scan_bin_t *bin);
+
+/**
+ * Decode the records in path order
+ *
+ * @param bin Open scan
+ * @param fn Record callback
+ * @param user_data Passed to fn
+ * @return 0 on success, -1 if a column is corrupt or fn stopped the read
+ */
+int scan_bin_read(const scan_bin_t *bin, scan_bin_entry_fn fn, void *user_data);
+
+#endif // SCAN_BIN_H
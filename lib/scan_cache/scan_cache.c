@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include "scan_cache.h"
+#include "../scan_reader/scan_reader.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CAPACITY 1024
+#define MIN_ENTRIES 1024
+#define MIN_POOL_SIZE (64 * 1024)
+
+// Paths and digests live in one string pool: an entry's path is followed by
+// its hex digests back to back, in the cache's order, each NUL-terminated
+typedef struct {
+    uint64_t path;              // Offset into the string pool
+    uint64_t hash;              // hash_path() of the path
+    scan_stamp_t stamp;
+} cache_entry_t;
+
+struct scan_cache {
+    uint32_t *slots;            // Entry index + 1, 0 if empty
+    size_t capacity;            // Power of two
+    cache_entry_t *entries;
+    size_t size;
+    size_t entry_capacity;
+    char *pool;
+    size_t pool_used;
+    size_t pool_size;
+    calc_hash_t hashes[CALC_HASH_COUNT];
+    int hash_count;
+    size_t digests_size;        // Bytes of an entry's digests, terminators included
+};
+
+// FNV-1a over the relative path
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void scan_stamp_from_stat(scan_stamp_t *stamp, const struct stat *statbuf) {
+    stamp->dev = (uint64_t)statbuf->st_dev;
+    stamp->inode = (uint64_t)statbuf->st_ino;
+    stamp->size = (uint64_t)statbuf->st_size;
+    stamp->mtime_ns = (int64_t)statbuf->st_mtim.tv_sec * 1000000000LL + statbuf->st_mtim.tv_nsec;
+    stamp->ctime_ns = (int64_t)statbuf->st_ctim.tv_sec * 1000000000LL + statbuf->st_ctim.tv_nsec;
+}
+
+void scan_format_time_ns(int64_t time_ns, char *buffer, size_t size) {
+    int64_t sec = time_ns / 1000000000LL;
+    int64_t nsec = time_ns % 1000000000LL;
+    if (nsec < 0) {
+        sec--;
+        nsec += 1000000000LL;
+    }
+    snprintf(buffer, size, "%" PRId64 ".%09" PRId64, sec, nsec);
+}
+
+int scan_parse_time_ns(const char *text, int64_t *time_ns) {
+    char *end = NULL;
+    long long sec = strtoll(text, &end, 10);
+    if (end == text || *end != '.') return -1;
+
+    const char *frac = end + 1;
+    long long nsec = strtoll(frac, &end, 10);
+    if (end - frac != 9 || *end != '\0' || nsec < 0) return -1;
+
+    *time_ns = (int64_t)sec * 1000000000LL + nsec;
+    return 0;
+}
+
+// Linear probe for a path; returns its slot or the empty slot ending the run
+static uint32_t *probe(const scan_cache_t *cache, const char *path, uint64_t hash) {
+    size_t mask = cache->capacity - 1;
+    size_t index = (size_t)hash & mask;
+
+    while (cache->slots[index] != 0) {
+        const cache_entry_t *entry = &cache->entries[cache->slots[index] - 1];
+        if (entry->hash == hash && strcmp(cache->pool + entry->path, path) == 0) break;
+        index = (index + 1) & mask;
+    }
+    return &cache->slots[index];
+}
+
+static int grow_slots(scan_cache_t *cache) {
+    size_t capacity = cache->capacity * 2;
+    uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->slots[i] == 0) continue;
+        size_t index = (size_t)cache->entries[cache->slots[i] - 1].hash & mask;
+        while (slots[index] != 0) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = cache->slots[i];
+    }
+
+    free(cache->slots);
+    cache->slots = slots;
+    cache->capacity = capacity;
+    return 0;
+}
+
+// Reserve length bytes of the string pool, returning the offset or 0 on failure
+static uint64_t pool_reserve(scan_cache_t *cache, size_t length) {
+    if (length > cache->pool_size - cache->pool_used) {
+        size_t size = cache->pool_size * 2;
+        while (length > size - cache->pool_used) size *= 2;
+        char *pool = realloc(cache->pool, size);
+        if (!pool) return 0;
+        cache->pool = pool;
+        cache->pool_size = size;
+    }
+
+    uint64_t offset = cache->pool_used;
+    cache->pool_used += length;
+    return offset;
+}
+
+static int cache_insert(scan_cache_t *cache, const scan_record_t *record) {
+    for (int i = 0; i < cache->hash_count; i++) {
+        calc_hash_t hash = cache->hashes[i];
+        if (strlen(record->digests[hash]) != 2 * calc_hash_digest_size(hash)) return -1;
+    }
+    if (cache->size >= UINT32_MAX - 1) return -1;
+
+    // Keep the load factor at or below 70%
+    if ((cache->size + 1) * 10 > cache->capacity * 7 && grow_slots(cache) != 0) return -1;
+    if (cache->size == cache->entry_capacity) {
+        size_t capacity = cache->entry_capacity * 2;
+        cache_entry_t *entries = realloc(cache->entries, capacity * sizeof(cache_entry_t));
+        if (!entries) return -1;
+        cache->entries = entries;
+        cache->entry_capacity = capacity;
+    }
+
+    size_t path_length = strlen(record->path) + 1;
+    uint64_t offset = pool_reserve(cache, path_length + cache->digests_size);
+    if (offset == 0) return -1;
+    char *text = cache->pool + offset;
+    memcpy(text, record->path, path_length);
+    text += path_length;
+    for (int i = 0; i < cache->hash_count; i++) {
+        size_t length = 2 * calc_hash_digest_size(cache->hashes[i]) + 1;
+        memcpy(text, record->digests[cache->hashes[i]], length);
+        text += length;
+    }
+
+    // A path listed twice keeps its last record
+    uint64_t hash = hash_path(record->path);
+    uint32_t *slot = probe(cache, record->path, hash);
+    cache_entry_t *entry;
+    if (*slot != 0) {
+        entry = &cache->entries[*slot - 1];
+    } else {
+        entry = &cache->entries[cache->size++];
+        *slot = (uint32_t)cache->size;
+    }
+    entry->path = offset;
+    entry->hash = hash;
+    entry->stamp = record->stamp;
+    return 0;
+}
+
+// Record callback: keep the entries that carry a full stamp and a digest
+// of every algorithm being scanned with
+static int cache_add_record(const scan_record_t *record, void *user_data) {
+    scan_cache_t *cache = (scan_cache_t *)user_data;
+
+    if (!record->has_stamp) return 0;
+    for (int i = 0; i < cache->hash_count; i++) {
+        if (!record->digests[cache->hashes[i]]) return 0;
+    }
+    if (cache_insert(cache, record) != 0) {
+        fprintf(stderr, "Warning: Skipping cache entry for %s\n", record->path);
+    }
+    return 0;
+}
+
+scan_cache_t *scan_cache_load(const char *filepath, const calc_hash_t *hashes, int hash_count) {
+    scan_cache_t *cache = calloc(1, sizeof(scan_cache_t));
+    if (!cache) return NULL;
+
+    for (int i = 0; i < hash_count; i++) {
+        cache->hashes[i] = hashes[i];
+        cache->digests_size += 2 * calc_hash_digest_size(hashes[i]) + 1;
+    }
+    cache->hash_count = hash_count;
+    cache->capacity = MIN_CAPACITY;
+    cache->entry_capacity = MIN_ENTRIES;
+    cache->pool_size = MIN_POOL_SIZE;
+    cache->slots = calloc(cache->capacity, sizeof(uint32_t));
+    cache->entries = malloc(cache->entry_capacity * sizeof(cache_entry_t));
+    cache->pool = malloc(cache->pool_size);
+    if (!cache->slots || !cache->entries || !cache->pool) {
+        scan_cache_free(cache);
+        return NULL;
+    }
+    // Offset 0 is reserved so pool_reserve() can report failure with it
+    cache->pool[0] = '\0';
+    cache->pool_used = 1;
+
+    if (scan_reader_read(filepath, cache_add_record, cache) != 0) {
+        scan_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+int scan_cache_lookup(const scan_cache_t *cache, const char *relative_path,
+                      const scan_stamp_t *stamp, calc_hash_digests_t *digests) {
+    if (!cache || !relative_path || !stamp) return -1;
+
+    uint32_t slot = *probe(cache, relative_path, hash_path(relative_path));
+    if (slot == 0) return -1;
+
+    const cache_entry_t *entry = &cache->entries[slot - 1];
+    if (entry->stamp.dev != stamp->dev ||
+        entry->stamp.inode != stamp->inode ||
+        entry->stamp.size != stamp->size ||
+        entry->stamp.mtime_ns != stamp->mtime_ns ||
+        entry->stamp.ctime_ns != stamp->ctime_ns) {
+        return -1;
+    }
+
+    const char *digest = cache->pool + entry->path;
+    digest += strlen(digest) + 1;
+    for (int i = 0; i < cache->hash_count; i++) {
+        size_t length = 2 * calc_hash_digest_size(cache->hashes[i]) + 1;
+        memcpy(digests->hex[i], digest, length);
+        digest += length;
+    }
+    return 0;
+}
+
+size_t scan_cache_size(const scan_cache_t *cache) {
+    return cache ? cache->size : 0;
+}
+
+void scan_cache_free(scan_cache_t *cache) {
+    if (!cache) return;
+
+    free(cache->slots);
+    free(cache->entries);
+    free(cache->pool);
+    free(cache);
+}
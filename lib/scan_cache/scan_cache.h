@@ -0,0 +1,64 @@
+#ifndef SCAN_CACHE_H
+#define SCAN_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "../calc_md5/calc_md5.h"
+
+// Identity of a file's contents as far as the cache is concerned
+typedef struct {
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+} scan_stamp_t;
+
+typedef struct scan_cache scan_cache_t;
+
+// Fill a stamp from stat() results
+void scan_stamp_from_stat(scan_stamp_t *stamp, const struct stat *statbuf);
+
+// Format a nanosecond timestamp as "seconds.nanoseconds" (buffer >= 32 bytes)
+void scan_format_time_ns(int64_t time_ns, char *buffer, size_t size);
+
+// Parse a timestamp written by scan_format_time_ns()
+int scan_parse_time_ns(const char *text, int64_t *time_ns);
+
+/**
+ * Load a previous scan as an incremental cache
+ *
+ * Only entries that carry the full stamp (dev, inode, size, mtime, ctime)
+ * and a digest of every requested algorithm are kept; older scans without
+ * metadata, or scans hashed differently, simply produce an empty cache.
+ *
+ * Entries are kept in an open-addressing table keyed on the relative path,
+ * with paths and digests copied into one string pool rather than allocated
+ * per entry.
+ *
+ * @param filepath Path to a scan result (JSON, NDJSON or binary)
+ * @param hashes Algorithms of the scan being made, in output order
+ * @param hash_count Number of algorithms
+ * @return Cache or NULL on error
+ */
+scan_cache_t *scan_cache_load(const char *filepath, const calc_hash_t *hashes, int hash_count);
+
+/**
+ * Look up a file's digests from the previous scan
+ *
+ * @param cache Loaded cache
+ * @param relative_path Path relative to the scanned directory
+ * @param stamp Current stamp of the file
+ * @param digests Output digests in the order given to scan_cache_load()
+ * @return 0 if the stamp is unchanged and digests were filled, -1 otherwise
+ */
+int scan_cache_lookup(const scan_cache_t *cache, const char *relative_path,
+                      const scan_stamp_t *stamp, calc_hash_digests_t *digests);
+
+// Number of entries in the cache
+size_t scan_cache_size(const scan_cache_t *cache);
+
+void scan_cache_free(scan_cache_t *cache);
+
+#endif // SCAN_CACHE_H
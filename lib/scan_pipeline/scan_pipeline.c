@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include "scan_pipeline.h"
+#include "../calc_md5/calc_md5.h"
+#include "../list_file/list_file.h"
+#include "../thread_pool/thread_pool.h"
+#include "../uring_md5/uring_md5.h"
+#include "../md5_mb/md5_mb.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct scan_pipeline scan_pipeline_t;
+
+// A file travelling through the pipeline
+typedef struct scan_item {
+    scan_pipeline_t *pipeline;
+    struct scan_item *next;  // Pending queue link (io_uring and multi-buffer engines)
+    size_t seq;
+    char *relative_path;
+    calc_hash_digests_t digests;
+    int status;
+    int has_stamp;
+    int cached;
+    scan_stamp_t stamp;
+} scan_item_t;
+
+struct scan_pipeline {
+    int root_fd;
+    scan_sink_fn sink;
+    void *user_data;
+    scan_io_engine_t io_engine;
+    int queued;    // Hashing threads pull files from the pending queue
+    int prefetch;  // Start readahead for files as they are queued
+    const scan_cache_t *cache;
+    thread_pool_t *pool;
+
+    // Files waiting for an io_uring or multi-buffer thread
+    scan_item_t *pending_head;
+    scan_item_t *pending_tail;
+    pthread_t *queue_threads;
+    int queue_thread_count;
+
+    // Reorder ring between hashers and writer, indexed by seq % depth
+    scan_item_t **ring;
+    size_t depth;
+
+    pthread_mutex_t lock;
+    pthread_cond_t slot_cond;   // walker waits for a free slot
+    pthread_cond_t ready_cond;  // writer waits for the next item
+    pthread_cond_t work_cond;   // queue threads wait for pending files
+    size_t next_seq;            // next sequence number handed out by walker
+    size_t next_write;          // next sequence number the writer emits
+    int walk_done;
+
+    scan_pipeline_stats_t stats;
+};
+
+static void free_item(scan_item_t *item) {
+    if (!item) return;
+    free(item->relative_path);
+    free(item);
+}
+
+// Publish a finished item to the writer
+static void complete_item(scan_item_t *item) {
+    scan_pipeline_t *p = item->pipeline;
+
+    pthread_mutex_lock(&p->lock);
+    p->ring[item->seq % p->depth] = item;
+    if (item->seq == p->next_write) {
+        pthread_cond_signal(&p->ready_cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Hashing stage
+static void hash_item_task(void *arg) {
+    scan_item_t *item = (scan_item_t *)arg;
+    item->status = calculate_file_digests_at(item->pipeline->root_fd, item->relative_path,
+                                             &item->digests);
+    complete_item(item);
+}
+
+// Pop the next pending file: 1 if one was taken, 0 if none is ready, -1 when done
+static int next_pending(scan_pipeline_t *p, int wait, scan_item_t **next) {
+    pthread_mutex_lock(&p->lock);
+    while (wait && !p->pending_head && !p->walk_done) {
+        pthread_cond_wait(&p->work_cond, &p->lock);
+    }
+
+    scan_item_t *item = p->pending_head;
+    if (!item) {
+        int ret = p->walk_done ? -1 : 0;
+        pthread_mutex_unlock(&p->lock);
+        return ret;
+    }
+    p->pending_head = item->next;
+    if (!p->pending_head) {
+        p->pending_tail = NULL;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    *next = item;
+    return 1;
+}
+
+// io_uring engine source
+static int uring_next_item(void *user_data, int wait, uring_md5_file_t *file) {
+    scan_item_t *item;
+    int ret = next_pending((scan_pipeline_t *)user_data, wait, &item);
+    if (ret > 0) {
+        file->path = item->relative_path;
+        file->ctx = item;
+    }
+    return ret;
+}
+
+// Multi-buffer engine source
+static int mb_next_item(void *user_data, int wait, md5_mb_file_t *file) {
+    scan_item_t *item;
+    int ret = next_pending((scan_pipeline_t *)user_data, wait, &item);
+    if (ret > 0) {
+        file->path = item->relative_path;
+        file->ctx = item;
+    }
+    return ret;
+}
+
+// Completion callback of the io_uring engine
+static void uring_item_done(void *user_data, void *ctx, int status,
+                            const calc_hash_digests_t *digests) {
+    (void)user_data;
+    scan_item_t *item = (scan_item_t *)ctx;
+
+    item->status = status;
+    if (status == 0) {
+        item->digests = *digests;
+    }
+    complete_item(item);
+}
+
+// Completion callback of the multi-buffer engine, which only computes MD5
+static void mb_item_done(void *user_data, void *ctx, int status, const char *md5_string) {
+    (void)user_data;
+    scan_item_t *item = (scan_item_t *)ctx;
+
+    item->status = status;
+    if (status == 0) {
+        snprintf(item->digests.hex[0], sizeof(item->digests.hex[0]), "%s", md5_string);
+    }
+    complete_item(item);
+}
+
+// Hash pending files one at a time when an engine cannot start
+static void hash_pending(scan_pipeline_t *p) {
+    scan_item_t *item;
+    int got;
+    while ((got = next_pending(p, 1, &item)) >= 0) {
+        if (got > 0) {
+            hash_item_task(item);
+        }
+    }
+}
+
+// Hashing stage with the io_uring engine
+static void *uring_thread_main(void *arg) {
+    scan_pipeline_t *p = (scan_pipeline_t *)arg;
+
+    if (uring_md5_run(p->root_fd, URING_MD5_DEFAULT_DEPTH, uring_next_item, uring_item_done, p) != 0) {
+        // Ring setup failed on this thread: hash synchronously instead
+        hash_pending(p);
+    }
+
+    return NULL;
+}
+
+// Hashing stage with the multi-buffer engine
+static void *mb_thread_main(void *arg) {
+    scan_pipeline_t *p = (scan_pipeline_t *)arg;
+
+    if (md5_mb_run(p->root_fd, mb_next_item, mb_item_done, p) != 0) {
+        hash_pending(p);
+    }
+
+    return NULL;
+}
+
+// Hand a walked file to the hashing stage
+static void dispatch_item(scan_pipeline_t *p, scan_item_t *item) {
+    if (p->queued) {
+        pthread_mutex_lock(&p->lock);
+        if (p->pending_tail) {
+            p->pending_tail->next = item;
+        } else {
+            p->pending_head = item;
+        }
+        p->pending_tail = item;
+        pthread_cond_signal(&p->work_cond);
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+
+    if (thread_pool_submit(p->pool, hash_item_task, item) != 0) {
+        item->status = -1;
+        complete_item(item);
+    }
+}
+
+// Walking stage: runs on the caller's thread via walk_directory()
+static void walk_file(const walk_entry_t *file, void *user_data) {
+    scan_pipeline_t *p = (scan_pipeline_t *)user_data;
+
+    scan_item_t *item = calloc(1, sizeof(scan_item_t));
+    if (item) {
+        item->pipeline = p;
+        item->relative_path = strdup(file->path);
+    }
+    if (!item || !item->relative_path) {
+        fprintf(stderr, "Error: Memory allocation failed for: %s\n", file->path);
+        free_item(item);
+        pthread_mutex_lock(&p->lock);
+        p->stats.errors++;
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+
+    // Backpressure: wait until the writer has room for another item
+    pthread_mutex_lock(&p->lock);
+    while (p->next_seq - p->next_write >= p->depth) {
+        pthread_cond_wait(&p->slot_cond, &p->lock);
+    }
+    item->seq = p->next_seq++;
+    pthread_mutex_unlock(&p->lock);
+
+    // Stat before hashing so a change during the read invalidates the stamp
+    struct stat statbuf;
+    if (fstatat(file->dir_fd, file->name, &statbuf, 0) == 0) {
+        scan_stamp_from_stat(&item->stamp, &statbuf);
+        item->has_stamp = 1;
+
+        if (scan_cache_lookup(p->cache, item->relative_path, &item->stamp, &item->digests) == 0) {
+            item->cached = 1;
+            complete_item(item);
+            return;
+        }
+    }
+
+    // Readahead runs while the hashers are still busy with earlier files
+    if (p->prefetch) {
+        calc_md5_prefetch_at(file->dir_fd, file->name);
+    }
+
+    dispatch_item(p, item);
+}
+
+// Writing stage: emits items strictly in walk order
+static void *writer_main(void *arg) {
+    scan_pipeline_t *p = (scan_pipeline_t *)arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        scan_item_t *item;
+        while (!(item = p->ring[p->next_write % p->depth]) &&
+               !(p->walk_done && p->next_write == p->next_seq)) {
+            pthread_cond_wait(&p->ready_cond, &p->lock);
+        }
+        if (!item) {
+            break;
+        }
+        p->ring[p->next_write % p->depth] = NULL;
+        pthread_mutex_unlock(&p->lock);
+
+        const char *digests[CALC_HASH_COUNT];
+        for (int i = 0; i < CALC_HASH_COUNT; i++) {
+            digests[i] = item->digests.hex[i];
+        }
+        scan_entry_t entry = {
+            .relative_path = item->relative_path,
+            .md5 = item->status == 0 ? item->digests.hex[0] : NULL,
+            .stamp = item->has_stamp ? &item->stamp : NULL,
+            .cached = item->cached,
+            .digests = item->status == 0 ? digests : NULL
+        };
+        p->sink(&entry, p->user_data);
+
+        pthread_mutex_lock(&p->lock);
+        if (item->status == 0) {
+            p->stats.files++;
+            if (item->cached) {
+                p->stats.cached++;
+            }
+        } else {
+            p->stats.errors++;
+        }
+        p->next_write++;
+        pthread_cond_signal(&p->slot_cond);
+        free_item(item);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static int start_hashers(scan_pipeline_t *p, int jobs) {
+    if (p->queued) {
+        void *(*thread_main)(void *) = p->io_engine == SCAN_IO_URING ? uring_thread_main : mb_thread_main;
+        p->queue_threads = calloc(jobs, sizeof(pthread_t));
+        if (!p->queue_threads) return -1;
+        for (int i = 0; i < jobs; i++) {
+            if (pthread_create(&p->queue_threads[i], NULL, thread_main, p) != 0) {
+                break;
+            }
+            p->queue_thread_count++;
+        }
+        return p->queue_thread_count > 0 ? 0 : -1;
+    }
+
+    p->pool = thread_pool_create(jobs);
+    return p->pool ? 0 : -1;
+}
+
+// Wait for the hashing stage to drain; walk_done must already be set
+static void stop_hashers(scan_pipeline_t *p) {
+    for (int i = 0; i < p->queue_thread_count; i++) {
+        pthread_join(p->queue_threads[i], NULL);
+    }
+    free(p->queue_threads);
+    p->queue_threads = NULL;
+    p->queue_thread_count = 0;
+
+    if (p->pool) {
+        thread_pool_destroy(p->pool);
+        p->pool = NULL;
+    }
+}
+
+int scan_pipeline_run(const char *directory, const scan_pipeline_config_t *config,
+                      scan_sink_fn sink, void *user_data,
+                      scan_pipeline_stats_t *stats) {
+    if (!directory || !config || !sink) return -1;
+
+    scan_pipeline_t p;
+    memset(&p, 0, sizeof(p));
+    p.sink = sink;
+    p.user_data = user_data;
+    p.depth = config->queue_depth ? config->queue_depth : SCAN_PIPELINE_DEFAULT_DEPTH;
+    p.io_engine = config->io_engine;
+    p.cache = config->cache;
+
+    calc_md5_options_t hash_options;
+    calc_md5_get_options(&hash_options);
+    p.prefetch = hash_options.fadvise && !hash_options.direct_io;
+
+    if (p.io_engine == SCAN_IO_URING && !uring_md5_available()) {
+        fprintf(stderr, "Warning: io_uring is not supported by this kernel, using synchronous reads\n");
+        p.io_engine = SCAN_IO_SYNC;
+    }
+    p.queued = p.io_engine == SCAN_IO_URING || config->multi_buffer;
+
+    // Hash workers open files relative to the scanned directory
+    p.root_fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (p.root_fd < 0) {
+        fprintf(stderr, "Error opening directory %s\n", directory);
+        return -1;
+    }
+
+    p.ring = calloc(p.depth, sizeof(scan_item_t *));
+    if (!p.ring) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        close(p.root_fd);
+        return -1;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.slot_cond, NULL);
+    pthread_cond_init(&p.ready_cond, NULL);
+    pthread_cond_init(&p.work_cond, NULL);
+
+    int ret = -1;
+    pthread_t writer;
+    if (start_hashers(&p, config->jobs > 0 ? config->jobs : 1) != 0) {
+        fprintf(stderr, "Error: Failed to start hash workers\n");
+        p.walk_done = 1;
+        stop_hashers(&p);
+    } else if (pthread_create(&writer, NULL, writer_main, &p) != 0) {
+        fprintf(stderr, "Error: Failed to start writer thread\n");
+        pthread_mutex_lock(&p.lock);
+        p.walk_done = 1;
+        pthread_cond_broadcast(&p.work_cond);
+        pthread_mutex_unlock(&p.lock);
+        stop_hashers(&p);
+    } else {
+        ret = walk_directory(directory, walk_file, &p);
+
+        pthread_mutex_lock(&p.lock);
+        p.walk_done = 1;
+        pthread_cond_signal(&p.ready_cond);
+        pthread_cond_broadcast(&p.work_cond);
+        pthread_mutex_unlock(&p.lock);
+
+        stop_hashers(&p);
+        pthread_join(writer, NULL);
+
+        if (stats) {
+            *stats = p.stats;
+        }
+    }
+
+    pthread_mutex_destroy(&p.lock);
+    pthread_cond_destroy(&p.slot_cond);
+    pthread_cond_destroy(&p.ready_cond);
+    pthread_cond_destroy(&p.work_cond);
+    free(p.ring);
+    close(p.root_fd);
+
+    return ret;
+}
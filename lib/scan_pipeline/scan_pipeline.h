@@ -0,0 +1,71 @@
+#ifndef SCAN_PIPELINE_H
+#define SCAN_PIPELINE_H
+
+#include <stddef.h>
+#include "../scan_cache/scan_cache.h"
+
+#define SCAN_PIPELINE_DEFAULT_DEPTH 256
+
+// One hashed file handed to the writer stage
+typedef struct {
+    const char *relative_path;  // Path relative to the scanned directory
+    const char *md5;            // Primary hex digest, NULL if hashing failed
+    const scan_stamp_t *stamp;  // Metadata taken before hashing, NULL if stat failed
+    int cached;                 // Digest was reused from the scan cache
+    const char *const *digests; // Every configured digest, md5 first; NULL if hashing failed
+} scan_entry_t;
+
+// Writer stage callback, invoked from a single thread in walk order
+typedef void (*scan_sink_fn)(const scan_entry_t *entry, void *user_data);
+
+// How the hashing stage reads file data
+typedef enum {
+    SCAN_IO_SYNC = 0,  // Blocking reads on a pool of hash workers
+    SCAN_IO_URING      // io_uring rings with many files in flight per thread
+} scan_io_engine_t;
+
+typedef struct {
+    int jobs;                    // Number of hash workers (or io_uring threads)
+    size_t queue_depth;          // Max files between walker and writer (0 = default)
+    scan_io_engine_t io_engine;  // Falls back to SCAN_IO_SYNC if unsupported
+    const scan_cache_t *cache;   // Previous scan; unchanged files skip hashing
+    int multi_buffer;            // Hash several files per thread in SIMD lanes (SCAN_IO_SYNC)
+} scan_pipeline_config_t;
+
+typedef struct {
+    size_t files;   // Entries delivered to the sink
+    size_t errors;  // Entries whose digest could not be computed
+    size_t cached;  // Entries whose digest came from the cache
+} scan_pipeline_stats_t;
+
+/**
+ * Scan a directory tree with a walker -> hashers -> writer pipeline
+ *
+ * The walker (walk_directory()) runs on the calling thread and feeds files
+ * to a pool of hash workers, which open them relative to the scanned
+ * directory's descriptor. With SCAN_IO_URING the hashing stage is instead
+ * a set of io_uring threads that pull files from a queue; with
+ * multi_buffer the threads run md5_mb_run() on the same queue, hashing
+ * one file per SIMD lane and refilling lanes as files finish. A dedicated
+ * writer thread receives the results in walk order through a bounded
+ * reorder ring; once queue_depth files are in flight the walker blocks
+ * until the writer catches up, so memory stays flat no matter how large
+ * the tree is.
+ *
+ * The walker stats every file relative to its directory descriptor. When a
+ * cache is configured and the file's (dev, inode, size, mtime, ctime) stamp
+ * matches the previous scan, the cached digest is used and the file never
+ * reaches the hashers.
+ *
+ * @param directory Directory to scan
+ * @param config Pipeline configuration
+ * @param sink Writer stage callback
+ * @param user_data Passed through to the sink
+ * @param stats Optional counters filled on return
+ * @return 0 on success, -1 on error
+ */
+int scan_pipeline_run(const char *directory, const scan_pipeline_config_t *config,
+                      scan_sink_fn sink, void *user_data,
+                      scan_pipeline_stats_t *stats);
+
+#endif // SCAN_PIPELINE_H
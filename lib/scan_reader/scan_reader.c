@@ -0,0 +1,716 @@
+#define _GNU_SOURCE
+#include "scan_reader.h"
+#include "../scan_bin/scan_bin.h"
+#include "../json_map/json_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READ_BUFFER_SIZE (64 * 1024)
+#define MAX_DEPTH 512
+
+// Growable NUL-terminated text for keys and string values
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} text_t;
+
+// Fields of the object being parsed that make up a record
+typedef struct {
+    text_t path;
+    text_t digests[CALC_HASH_COUNT];
+    text_t mtime;
+    text_t ctime;
+    calc_hash_t hash;           // Algorithm of the first digest member
+    uint64_t size;
+    uint64_t inode;
+    uint64_t dev;
+    int has_path;
+    int has_digest[CALC_HASH_COUNT];
+    int digest_count;
+    int has_mtime;
+    int has_ctime;
+    int has_size;
+    int has_inode;
+    int has_dev;
+} fields_t;
+
+// Streaming parser state: a pushdown recursive descent over a read buffer
+typedef struct {
+    FILE *file;
+    unsigned char buffer[READ_BUFFER_SIZE];
+    size_t position;
+    size_t length;
+    int eof;
+    size_t line;
+    text_t key;
+    text_t scratch;             // Values that are parsed only to be skipped
+    fields_t fields;
+    scan_record_fn fn;
+    void *user_data;
+    int stopped;                // The callback asked to stop
+    int in_files;               // Inside a document's "files" array
+    int saw_files;
+    int saw_scan_info;
+    size_t records;
+    scan_info_t *info;          // Filled from scan_info objects, may be NULL
+} reader_t;
+
+static int peek_char(reader_t *reader) {
+    if (reader->position == reader->length) {
+        if (reader->eof) return EOF;
+        reader->length = fread(reader->buffer, 1, sizeof(reader->buffer), reader->file);
+        reader->position = 0;
+        if (reader->length == 0) {
+            reader->eof = 1;
+            return EOF;
+        }
+    }
+    return reader->buffer[reader->position];
+}
+
+static int next_char(reader_t *reader) {
+    int c = peek_char(reader);
+    if (c != EOF) {
+        reader->position++;
+        if (c == '\n') reader->line++;
+    }
+    return c;
+}
+
+static int skip_whitespace(reader_t *reader) {
+    int c = peek_char(reader);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        next_char(reader);
+        c = peek_char(reader);
+    }
+    return c;
+}
+
+// Consume an expected character after optional whitespace
+static int expect_char(reader_t *reader, int expected) {
+    if (skip_whitespace(reader) != expected) return -1;
+    next_char(reader);
+    return 0;
+}
+
+static int text_append(text_t *text, const char *data, size_t length) {
+    if (text->length + length + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity : 64;
+        while (text->length + length + 1 > capacity) capacity *= 2;
+        char *grown = realloc(text->data, capacity);
+        if (!grown) return -1;
+        text->data = grown;
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->length, data, length);
+    text->length += length;
+    text->data[text->length] = '\0';
+    return 0;
+}
+
+static void text_clear(text_t *text) {
+    text->length = 0;
+    if (text->data) text->data[0] = '\0';
+}
+
+static int parse_hex4(reader_t *reader, unsigned int *value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = peek_char(reader);
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return -1;
+        next_char(reader);
+        *value = (*value << 4) | (unsigned int)digit;
+    }
+    return 0;
+}
+
+// Decode a \uXXXX escape (with its surrogate pair) to UTF-8
+static int parse_unicode_escape(reader_t *reader, text_t *out) {
+    unsigned int code;
+    if (parse_hex4(reader, &code) != 0) return -1;
+
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        unsigned int low;
+        if (next_char(reader) != '\\' || next_char(reader) != 'u' ||
+            parse_hex4(reader, &low) != 0 || low < 0xDC00 || low > 0xDFFF) {
+            return -1;
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        return -1;
+    }
+
+    char utf8[4];
+    return text_append(out, utf8, json_utf8_encode(code, utf8));
+}
+
+// Parse a string value into out, unescaped
+static int parse_string(reader_t *reader, text_t *out) {
+    text_clear(out);
+    if (expect_char(reader, '"') != 0) return -1;
+    if (text_append(out, "", 0) != 0) return -1;
+
+    for (;;) {
+        // Copy runs of plain bytes straight from the read buffer
+        size_t start = reader->position;
+        while (reader->position < reader->length) {
+            unsigned char c = reader->buffer[reader->position];
+            if (c == '"' || c == '\\' || c < 0x20) break;
+            reader->position++;
+        }
+        if (reader->position > start &&
+            text_append(out, (const char *)reader->buffer + start, reader->position - start) != 0) {
+            return -1;
+        }
+
+        int c = peek_char(reader);
+        if (c == EOF || c < 0x20) return -1;
+        if (c != '"' && c != '\\') continue;   // Buffer refilled mid-run
+        next_char(reader);
+        if (c == '"') return 0;
+
+        char escaped;
+        switch (next_char(reader)) {
+            case '"':  escaped = '"'; break;
+            case '\\': escaped = '\\'; break;
+            case '/':  escaped = '/'; break;
+            case 'b':  escaped = '\b'; break;
+            case 'f':  escaped = '\f'; break;
+            case 'n':  escaped = '\n'; break;
+            case 'r':  escaped = '\r'; break;
+            case 't':  escaped = '\t'; break;
+            case 'u':
+                if (parse_unicode_escape(reader, out) != 0) return -1;
+                continue;
+            default:
+                return -1;
+        }
+        if (text_append(out, &escaped, 1) != 0) return -1;
+    }
+}
+
+static int is_number_char(int c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// Collect the characters of a number into out
+static int parse_number(reader_t *reader, text_t *out) {
+    text_clear(out);
+    skip_whitespace(reader);
+    while (is_number_char(peek_char(reader))) {
+        char c = (char)next_char(reader);
+        if (text_append(out, &c, 1) != 0) return -1;
+    }
+    if (out->length == 0) return -1;
+
+    char *end = NULL;
+    strtod(out->data, &end);
+    return *end == '\0' ? 0 : -1;
+}
+
+// Convert a parsed number to a non-negative integer field
+static int number_to_uint(const text_t *number, uint64_t *value) {
+    char *end = NULL;
+    if (strspn(number->data, "0123456789") == number->length) {
+        *value = strtoull(number->data, &end, 10);
+        return 0;
+    }
+    double real = strtod(number->data, &end);
+    if (real < 0) return -1;
+    *value = (uint64_t)real;
+    return 0;
+}
+
+static int parse_literal(reader_t *reader, const char *literal) {
+    skip_whitespace(reader);
+    for (const char *p = literal; *p; p++) {
+        if (next_char(reader) != *p) return -1;
+    }
+    return 0;
+}
+
+static int skip_value(reader_t *reader, int depth);
+
+// Parse "key": value members up to the closing brace or bracket
+static int skip_container(reader_t *reader, int object, int depth) {
+    int close = object ? '}' : ']';
+
+    next_char(reader);
+    if (skip_whitespace(reader) == close) {
+        next_char(reader);
+        return 0;
+    }
+    for (;;) {
+        if (object) {
+            if (parse_string(reader, &reader->scratch) != 0) return -1;
+            if (expect_char(reader, ':') != 0) return -1;
+        }
+        if (skip_value(reader, depth + 1) != 0) return -1;
+
+        int c = skip_whitespace(reader);
+        if (c == close) {
+            next_char(reader);
+            return 0;
+        }
+        if (c != ',') return -1;
+        next_char(reader);
+    }
+}
+
+static int skip_value(reader_t *reader, int depth) {
+    if (depth > MAX_DEPTH) return -1;
+
+    switch (skip_whitespace(reader)) {
+        case '{': return skip_container(reader, 1, depth);
+        case '[': return skip_container(reader, 0, depth);
+        case '"': return parse_string(reader, &reader->scratch);
+        case 't': return parse_literal(reader, "true");
+        case 'f': return parse_literal(reader, "false");
+        case 'n': return parse_literal(reader, "null");
+        default:  return parse_number(reader, &reader->scratch);
+    }
+}
+
+static void reset_fields(fields_t *fields) {
+    fields->has_path = 0;
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        fields->has_digest[i] = 0;
+    }
+    fields->digest_count = 0;
+    fields->has_mtime = 0;
+    fields->has_ctime = 0;
+    fields->has_size = 0;
+    fields->has_inode = 0;
+    fields->has_dev = 0;
+}
+
+// Hand the collected fields to the callback if they form a record
+static int emit_fields(reader_t *reader) {
+    fields_t *fields = &reader->fields;
+    if (!fields->has_path || fields->digest_count == 0) return 0;
+
+    scan_record_t record;
+    record.path = fields->path.data;
+    record.md5 = fields->digests[fields->hash].data;
+    record.hash = fields->hash;
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        record.digests[i] = fields->has_digest[i] ? fields->digests[i].data : NULL;
+    }
+    record.stamp.size = fields->size;
+    record.stamp.inode = fields->inode;
+    record.stamp.dev = fields->dev;
+    record.has_stamp =
+        fields->has_size && fields->has_inode && fields->has_dev &&
+        fields->has_mtime && fields->has_ctime &&
+        scan_parse_time_ns(fields->mtime.data, &record.stamp.mtime_ns) == 0 &&
+        scan_parse_time_ns(fields->ctime.data, &record.stamp.ctime_ns) == 0;
+
+    reader->records++;
+    if (reader->fn(&record, reader->user_data) != 0) {
+        reader->stopped = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// Parse one record field if key names one and the value has the right type
+static int parse_field(reader_t *reader, const char *key, int *handled) {
+    fields_t *fields = &reader->fields;
+    int c = skip_whitespace(reader);
+    text_t *text = NULL;
+    int *has_text = NULL;
+    uint64_t *number = NULL;
+    int *has_number = NULL;
+    calc_hash_t hash;
+
+    *handled = 1;
+    if (strcmp(key, "path") == 0) {
+        text = &fields->path;
+        has_text = &fields->has_path;
+    } else if (calc_hash_from_name(key, &hash) == 0) {
+        if (c == '"' && !fields->has_digest[hash] && fields->digest_count++ == 0) {
+            fields->hash = hash;
+        }
+        text = &fields->digests[hash];
+        has_text = &fields->has_digest[hash];
+    } else if (strcmp(key, "mtime") == 0) {
+        text = &fields->mtime;
+        has_text = &fields->has_mtime;
+    } else if (strcmp(key, "ctime") == 0) {
+        text = &fields->ctime;
+        has_text = &fields->has_ctime;
+    } else if (strcmp(key, "size") == 0) {
+        number = &fields->size;
+        has_number = &fields->has_size;
+    } else if (strcmp(key, "inode") == 0) {
+        number = &fields->inode;
+        has_number = &fields->has_inode;
+    } else if (strcmp(key, "dev") == 0) {
+        number = &fields->dev;
+        has_number = &fields->has_dev;
+    }
+
+    if (text && c == '"') {
+        if (parse_string(reader, text) != 0) return -1;
+        *has_text = 1;
+        return 0;
+    }
+    if (number && (c == '-' || (c >= '0' && c <= '9'))) {
+        if (parse_number(reader, &reader->scratch) != 0) return -1;
+        *has_number = number_to_uint(&reader->scratch, number) == 0;
+        return 0;
+    }
+    *handled = 0;
+    return 0;
+}
+
+static int parse_object(reader_t *reader, int root, int depth);
+
+// Replace an owned scan_info string with the text just parsed
+static int set_info_text(const char **field, const text_t *text) {
+    char *copy = strdup(text->data);
+    if (!copy) return -1;
+    free((char *)*field);
+    *field = copy;
+    return 0;
+}
+
+// Parse a scan_info object into reader->info
+static int parse_scan_info(reader_t *reader, int depth) {
+    scan_info_t *info = reader->info;
+
+    next_char(reader);
+    if (skip_whitespace(reader) == '}') {
+        next_char(reader);
+        return 0;
+    }
+    for (;;) {
+        if (parse_string(reader, &reader->key) != 0) return -1;
+        if (expect_char(reader, ':') != 0) return -1;
+
+        const char *key = reader->key.data;
+        const char **text = NULL;
+        uint64_t *number = NULL;
+        int c = skip_whitespace(reader);
+        if (strcmp(key, "scanned_directory") == 0) text = &info->scanned_directory;
+        else if (strcmp(key, "scan_time") == 0) text = &info->scan_time;
+        else if (strcmp(key, "total_files") == 0) number = &info->total_files;
+        else if (strcmp(key, "errors") == 0) number = &info->errors;
+        else if (strcmp(key, "cached_files") == 0) number = &info->cached_files;
+
+        if (strcmp(key, "hash") == 0 && c == '"') {
+            if (parse_string(reader, &reader->scratch) != 0) return -1;
+            if (calc_hash_parse_list(reader->scratch.data, info->hashes, &info->hash_count) != 0) {
+                fprintf(stderr, "Warning: Unknown hash algorithm %s in scan_info\n",
+                        reader->scratch.data);
+            }
+        } else if (text && c == '"') {
+            if (parse_string(reader, &reader->scratch) != 0) return -1;
+            if (set_info_text(text, &reader->scratch) != 0) return -1;
+        } else if (number && (c == '-' || (c >= '0' && c <= '9'))) {
+            if (parse_number(reader, &reader->scratch) != 0) return -1;
+            if (number_to_uint(&reader->scratch, number) == 0 &&
+                number == &info->cached_files) {
+                info->has_cached_files = 1;
+            }
+        } else if (skip_value(reader, depth + 1) != 0) {
+            return -1;
+        }
+
+        c = skip_whitespace(reader);
+        if (c == '}') {
+            next_char(reader);
+            return 0;
+        }
+        if (c != ',') return -1;
+        next_char(reader);
+    }
+}
+
+// Parse a document's "files" array, emitting each record object
+static int parse_files(reader_t *reader, int depth) {
+    reader->in_files = 1;
+    reader->saw_files = 1;
+
+    next_char(reader);
+    if (skip_whitespace(reader) == ']') {
+        next_char(reader);
+        reader->in_files = 0;
+        return 0;
+    }
+    for (;;) {
+        int result = skip_whitespace(reader) == '{' ?
+            parse_object(reader, 0, depth + 1) : skip_value(reader, depth + 1);
+        if (result != 0) return -1;
+
+        int c = skip_whitespace(reader);
+        if (c == ']') {
+            next_char(reader);
+            reader->in_files = 0;
+            return 0;
+        }
+        if (c != ',') return -1;
+        next_char(reader);
+    }
+}
+
+/**
+ * Parse an object, picking out the record fields and skipping the rest
+ *
+ * A root object is either a whole scan document, whose "files" array is
+ * walked record by record, or a single NDJSON record.
+ */
+static int parse_object(reader_t *reader, int root, int depth) {
+    int document = 0;
+
+    if (depth > MAX_DEPTH) return -1;
+    reset_fields(&reader->fields);
+
+    next_char(reader);
+    if (skip_whitespace(reader) == '}') {
+        next_char(reader);
+        return 0;
+    }
+    for (;;) {
+        if (parse_string(reader, &reader->key) != 0) return -1;
+        if (expect_char(reader, ':') != 0) return -1;
+
+        const char *key = reader->key.data;
+        int handled = 0;
+        if (root && strcmp(key, "files") == 0 && skip_whitespace(reader) == '[') {
+            if (parse_files(reader, depth) != 0) return -1;
+            reset_fields(&reader->fields);
+            document = 1;
+            handled = 1;
+        } else if (root && strcmp(key, "scan_info") == 0) {
+            reader->saw_scan_info = 1;
+            if (reader->info && skip_whitespace(reader) == '{') {
+                if (parse_scan_info(reader, depth + 1) != 0) return -1;
+                handled = 1;
+            }
+        } else {
+            if (parse_field(reader, key, &handled) != 0) return -1;
+        }
+        if (!handled && skip_value(reader, depth + 1) != 0) return -1;
+
+        int c = skip_whitespace(reader);
+        if (c == '}') {
+            next_char(reader);
+            break;
+        }
+        if (c != ',') return -1;
+        next_char(reader);
+    }
+
+    return document ? 0 : emit_fields(reader);
+}
+
+static void skip_line(reader_t *reader) {
+    int c;
+    do {
+        c = next_char(reader);
+    } while (c != '\n' && c != EOF);
+}
+
+static void free_text(text_t *text) {
+    free(text->data);
+}
+
+// Record callback state for a binary scan
+typedef struct {
+    scan_record_fn fn;
+    void *user_data;
+    calc_hash_t hash;
+} bin_reader_t;
+
+static int bin_record(const scan_bin_entry_t *entry, void *user_data) {
+    bin_reader_t *bin_reader = (bin_reader_t *)user_data;
+    char md5[2 * SCAN_BIN_DIGEST_SIZE + 1];
+
+    calc_hash_to_string(entry->digest, SCAN_BIN_DIGEST_SIZE, md5);
+    scan_record_t record;
+    record.path = entry->path;
+    record.md5 = md5;
+    record.hash = bin_reader->hash;
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        record.digests[i] = i == (int)bin_reader->hash ? md5 : NULL;
+    }
+    record.has_stamp = entry->has_stamp;
+    record.stamp = entry->stamp;
+    return bin_reader->fn(&record, bin_reader->user_data);
+}
+
+static int read_bin(const char *filepath, scan_record_fn fn, void *user_data,
+                    scan_info_t *info) {
+    scan_bin_t *bin = scan_bin_open(filepath);
+    if (!bin) return -1;
+
+    bin_reader_t bin_reader = {fn, user_data, scan_bin_info(bin)->hashes[0]};
+    int result = scan_bin_read(bin, bin_record, &bin_reader);
+    if (result == 0 && info) {
+        const scan_info_t *bin_info = scan_bin_info(bin);
+        *info = *bin_info;
+        info->scanned_directory = bin_info->scanned_directory ?
+            strdup(bin_info->scanned_directory) : NULL;
+        info->scan_time = bin_info->scan_time ? strdup(bin_info->scan_time) : NULL;
+        if ((bin_info->scanned_directory && !info->scanned_directory) ||
+            (bin_info->scan_time && !info->scan_time)) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            result = -1;
+        }
+    }
+    scan_bin_close(bin);
+    return result;
+}
+
+void scan_info_free(scan_info_t *info) {
+    free((char *)info->scanned_directory);
+    free((char *)info->scan_time);
+    info->scanned_directory = NULL;
+    info->scan_time = NULL;
+}
+
+int scan_reader_read(const char *filepath, scan_record_fn fn, void *user_data) {
+    return scan_reader_read_info(filepath, fn, user_data, NULL);
+}
+
+int scan_reader_read_info(const char *filepath, scan_record_fn fn, void *user_data,
+                          scan_info_t *info) {
+    if (info) {
+        memset(info, 0, sizeof(scan_info_t));
+        info->hashes[0] = CALC_HASH_MD5;
+        info->hash_count = 1;
+    }
+    if (scan_bin_probe(filepath)) return read_bin(filepath, fn, user_data, info);
+
+    reader_t *reader = calloc(1, sizeof(reader_t));
+    if (!reader) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+
+    reader->file = fopen(filepath, "r");
+    if (!reader->file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filepath);
+        free(reader);
+        return -1;
+    }
+    reader->line = 1;
+    reader->fn = fn;
+    reader->user_data = user_data;
+    reader->info = info;
+
+    // A file is a sequence of top-level objects: one document, or NDJSON lines
+    size_t values = 0;
+    int result = 0;
+    while (skip_whitespace(reader) != EOF) {
+        size_t start_line = reader->line;
+        int parsed = skip_whitespace(reader) == '{' ? parse_object(reader, 1, 0) : -1;
+        if (reader->stopped) {
+            result = -1;
+            break;
+        }
+        if (parsed == 0) {
+            values++;
+            continue;
+        }
+
+        // A bad NDJSON line is skipped; a broken document is an error
+        if (reader->in_files || (values == 0 && reader->line != start_line)) {
+            fprintf(stderr, "Error: Invalid JSON format in file %s near line %zu\n",
+                    filepath, reader->line);
+            result = -1;
+            break;
+        }
+        fprintf(stderr, "Warning: Skipping invalid line %zu in %s\n", reader->line, filepath);
+        if (reader->line == start_line) skip_line(reader);
+    }
+
+    if (result == 0 && values == 0) {
+        fprintf(stderr, "Error: Empty or invalid file %s\n", filepath);
+        result = -1;
+    } else if (result == 0 && values == 1 && !reader->saw_files &&
+               !reader->saw_scan_info && reader->records == 0) {
+        fprintf(stderr, "Error: Invalid JSON structure - 'files' array not found\n");
+        result = -1;
+    }
+
+    fclose(reader->file);
+    free_text(&reader->key);
+    free_text(&reader->scratch);
+    free_text(&reader->fields.path);
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        free_text(&reader->fields.digests[i]);
+    }
+    free_text(&reader->fields.mtime);
+    free_text(&reader->fields.ctime);
+    free(reader);
+    return result;
+}
+
+// Result of scan_reader_probe_hash(): the first record decides
+typedef struct {
+    calc_hash_t *hashes;
+    int count;
+    int found;
+} hash_probe_t;
+
+static int probe_record(const scan_record_t *record, void *user_data) {
+    hash_probe_t *probe = (hash_probe_t *)user_data;
+
+    probe->hashes[probe->count++] = record->hash;
+    for (int i = 0; i < CALC_HASH_COUNT; i++) {
+        if (record->digests[i] && i != (int)record->hash) {
+            probe->hashes[probe->count++] = (calc_hash_t)i;
+        }
+    }
+    probe->found = 1;
+    return 1;
+}
+
+int scan_reader_probe_hash(const char *filepath, calc_hash_t *hashes, int *count) {
+    hash_probe_t probe = {hashes, 0, 0};
+    scan_info_t info;
+
+    int result = scan_reader_read_info(filepath, probe_record, &probe, &info);
+    if (probe.found) {
+        *count = probe.count;
+    } else if (result == 0) {
+        memcpy(hashes, info.hashes, sizeof(info.hashes));
+        *count = info.hash_count;
+    }
+    scan_info_free(&info);
+    return probe.found || result == 0 ? 0 : -1;
+}
+
+int scan_reader_check_hash(const char *file1_path, const char *file2_path, calc_hash_t *hash) {
+    calc_hash_t hashes1[CALC_HASH_COUNT], hashes2[CALC_HASH_COUNT];
+    int count1, count2;
+
+    if (scan_reader_probe_hash(file1_path, hashes1, &count1) != 0 ||
+        scan_reader_probe_hash(file2_path, hashes2, &count2) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < count1; i++) {
+        for (int j = 0; j < count2; j++) {
+            if (hashes1[i] == hashes2[j]) {
+                if (hash) *hash = hashes1[i];
+                return 0;
+            }
+        }
+    }
+
+    char names1[64], names2[64];
+    calc_hash_format_list(hashes1, count1, names1, sizeof(names1));
+    calc_hash_format_list(hashes2, count2, names2, sizeof(names2));
+    fprintf(stderr, "Error: %s was hashed with %s and %s with %s; "
+            "scan both with a common --hash to compare them\n",
+            file1_path, names1, file2_path, names2);
+    return -1;
+}
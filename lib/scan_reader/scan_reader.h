@@ -0,0 +1,97 @@
+#ifndef SCAN_READER_H
+#define SCAN_READER_H
+
+#include "../scan_cache/scan_cache.h"
+#include "../calc_md5/calc_md5.h"
+
+// Layouts a scan result can be written in
+typedef enum {
+    SCAN_FORMAT_JSON,       // One document with a "files" array
+    SCAN_FORMAT_NDJSON,     // One record object per line
+    SCAN_FORMAT_BIN         // Columnar binary scan (see scan_bin.h)
+} scan_format_t;
+
+// Summary stored with a scan; strings are NULL when absent
+typedef struct {
+    const char *scanned_directory;
+    const char *scan_time;
+    uint64_t total_files;
+    uint64_t errors;
+    uint64_t cached_files;
+    int has_cached_files;
+    calc_hash_t hashes[CALC_HASH_COUNT];  // Digest algorithms, primary first (MD5 when absent)
+    int hash_count;
+} scan_info_t;
+
+// One file record of a scan; strings are only valid during the callback
+typedef struct {
+    const char *path;
+    const char *md5;            // Hex digest of the first digest member (the primary)
+    calc_hash_t hash;           // Algorithm of md5, named by its key
+    const char *digests[CALC_HASH_COUNT];  // Every digest by algorithm, NULL when absent
+    int has_stamp;          // stamp is filled if the record carries all metadata
+    scan_stamp_t stamp;
+} scan_record_t;
+
+// Called for every record in file order; return non-zero to stop reading
+typedef int (*scan_record_fn)(const scan_record_t *record, void *user_data);
+
+/**
+ * Read the file records of a scan result
+ *
+ * Accepts a document with a "files" array, NDJSON (one object per line)
+ * or a binary scan (scan_bin.h, digests formatted back to hex). Records
+ * go to fn as soon as their object closes; no DOM is built.
+ * Digests are the members named after their algorithm, the first one
+ * being the primary. Objects without path and digest, like the NDJSON
+ * scan_info line, are skipped; an invalid NDJSON line is skipped with a
+ * warning.
+ *
+ * @param filepath Path to a scan result
+ * @param fn Record callback
+ * @param user_data Passed to fn
+ * @return 0 on success, -1 on error or if fn stopped the read
+ */
+int scan_reader_read(const char *filepath, scan_record_fn fn, void *user_data);
+
+/**
+ * As scan_reader_read(), also collecting the scan_info of the scan
+ *
+ * @param filepath Path to a scan result
+ * @param fn Record callback
+ * @param user_data Passed to fn
+ * @param info Filled with the scan_info; release with scan_info_free(), also on error
+ * @return 0 on success, -1 on error or if fn stopped the read
+ */
+int scan_reader_read_info(const char *filepath, scan_record_fn fn, void *user_data,
+                          scan_info_t *info);
+
+// Free the strings of a scan_info filled by scan_reader_read_info()
+void scan_info_free(scan_info_t *info);
+
+/**
+ * Find the digest algorithms of a scan from its first record
+ *
+ * Only the head of the file is read. A scan without records falls back
+ * to its scan_info, and to MD5 if that has no "hash" either.
+ *
+ * @param filepath Path to a scan result
+ * @param hashes Output algorithms, primary first, CALC_HASH_COUNT entries
+ * @param count Output number of algorithms
+ * @return 0 on success, -1 if the scan cannot be read
+ */
+int scan_reader_probe_hash(const char *filepath, calc_hash_t *hashes, int *count);
+
+/**
+ * Pick the digest two scans are compared by: digests of different
+ * algorithms never match, so scans without a common one are refused.
+ * The first scan's algorithms are tried in order, primary first.
+ *
+ * @param file1_path First scan
+ * @param file2_path Second scan
+ * @param hash Output common algorithm, may be NULL
+ * @return 0 if both share an algorithm, -1 otherwise (reported on stderr)
+ */
+int scan_reader_check_hash(const char *file1_path, const char *file2_path, calc_hash_t *hash);
+
+#endif // SCAN_READER_H
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include "sha256.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*transform_fn)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+static sha256_kernel_t active_kernel = SHA256_AUTO;
+static transform_fn sha256_transform = NULL;
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define SIGMA0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define SIGMA1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define GAMMA0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define GAMMA1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static inline uint32_t load_be32(const uint8_t *bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+           ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static inline void store_be32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+// Portable transform; the message schedule is a rolling window of 16 words
+static void transform_generic(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    for (; blocks > 0; blocks--, data += 64) {
+        uint32_t w[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; i++) {
+            uint32_t word;
+            if (i < 16) {
+                word = w[i] = load_be32(data + i * 4);
+            } else {
+                word = w[i & 15] += GAMMA1(w[(i - 2) & 15]) + w[(i - 7) & 15] +
+                                    GAMMA0(w[(i - 15) & 15]);
+            }
+            uint32_t t1 = h + SIGMA1(e) + CH(e, f, g) + K[i] + word;
+            uint32_t t2 = SIGMA0(a) + MAJ(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+// SHA-NI transform: SHA256RNDS2 runs two rounds on the state kept as
+// ABEF/CDGH, SHA256MSG1/MSG2 extend the message schedule four words at a time
+__attribute__((target("sha,sse4.1")))
+static void transform_shani(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i w[4];
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), byte_swap);
+            } else {
+                // w[i & 3] holds W[4i-16..], the other three the following groups
+                __m128i t = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(t, w[(i + 3) & 3]);
+            }
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *)&K[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+#endif
+
+static void select_kernel(void) {
+    if (sha256_transform) return;
+    sha256_set_kernel(SHA256_AUTO);
+}
+
+int sha256_set_kernel(sha256_kernel_t kernel) {
+#ifdef SHA256_X86
+    __builtin_cpu_init();
+    int has_shani = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#else
+    int has_shani = 0;
+#endif
+
+    if (kernel == SHA256_AUTO) {
+        kernel = has_shani ? SHA256_SHANI : SHA256_GENERIC;
+    }
+
+    switch (kernel) {
+        case SHA256_GENERIC:
+            sha256_transform = transform_generic;
+            break;
+#ifdef SHA256_X86
+        case SHA256_SHANI:
+            if (!has_shani) return -1;
+            sha256_transform = transform_shani;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+sha256_kernel_t sha256_kernel(void) {
+    select_kernel();
+    return active_kernel;
+}
+
+const char *sha256_kernel_name(sha256_kernel_t kernel) {
+    switch (kernel) {
+        case SHA256_AUTO:    return "auto";
+        case SHA256_GENERIC: return "generic";
+        case SHA256_SHANI:   return "sha-ni";
+    }
+    return "unknown";
+}
+
+void sha256_init(sha256_ctx_t *ctx) {
+    select_kernel();
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->count = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    size_t index = (size_t)(ctx->count & 63);
+    ctx->count += len;
+
+    // Complete a partial block first; whole blocks are hashed in place
+    if (index > 0) {
+        size_t part = 64 - index;
+        if (len < part) {
+            memcpy(&ctx->buffer[index], data, len);
+            return;
+        }
+        memcpy(&ctx->buffer[index], data, part);
+        sha256_transform(ctx->state, ctx->buffer, 1);
+        data += part;
+        len -= part;
+    }
+
+    if (len >= 64) {
+        sha256_transform(ctx->state, data, len / 64);
+        data += len & ~(size_t)63;
+        len &= 63;
+    }
+    if (len > 0) {
+        memcpy(ctx->buffer, data, len);
+    }
+}
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    size_t index = (size_t)(ctx->count & 63);
+    uint64_t bits = ctx->count << 3;
+
+    // Pad in place: 0x80, zeros up to 56 mod 64, then the big-endian bit count
+    ctx->buffer[index++] = 0x80;
+    if (index > 56) {
+        memset(&ctx->buffer[index], 0, 64 - index);
+        sha256_transform(ctx->state, ctx->buffer, 1);
+        index = 0;
+    }
+    memset(&ctx->buffer[index], 0, 56 - index);
+    store_be32(&ctx->buffer[56], (uint32_t)(bits >> 32));
+    store_be32(&ctx->buffer[60], (uint32_t)bits);
+    sha256_transform(ctx->state, ctx->buffer, 1);
+
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + i * 4, ctx->state[i]);
+    }
+}
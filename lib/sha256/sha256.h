@@ -0,0 +1,40 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+// SHA-256 context structure
+typedef struct {
+    uint32_t state[8];
+    uint64_t count;             // Bytes hashed so far
+    uint8_t buffer[64];
+} sha256_ctx_t;
+
+// Block transform kernels
+typedef enum {
+    SHA256_AUTO,            // Best kernel the CPU supports
+    SHA256_GENERIC,         // Portable C
+    SHA256_SHANI            // x86 SHA extensions (SHA-NI)
+} sha256_kernel_t;
+
+/**
+ * Select the transform kernel used by sha256_update()
+ *
+ * @param kernel Kernel, or SHA256_AUTO for the best supported one
+ * @return 0 on success, -1 if the CPU or build does not support it
+ */
+int sha256_set_kernel(sha256_kernel_t kernel);
+
+// Kernel currently in use (never SHA256_AUTO)
+sha256_kernel_t sha256_kernel(void);
+
+const char *sha256_kernel_name(sha256_kernel_t kernel);
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif // SHA256_H
@@ -0,0 +1,408 @@
+#define _GNU_SOURCE
+#include "sort_join.h"
+#include "../scan_reader/scan_reader.h"
+#include "../json_map/json_map.h"
+#include "../digest_table/digest_table.h"
+#include "../compare_output/compare_output.h"
+#include "../thread_pool/thread_pool.h"
+#include "../json_diff/json_diff.h"
+#include "../external_join/external_join.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIN_ENTRIES 1024
+#define MIN_POOL_SIZE (64 * 1024)
+#define RADIX_BITS 16
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+#define INSERTION_LIMIT 32
+#define MIN_PARALLEL_ENTRIES 65536
+#define MAX_SORT_THREADS 16
+
+// One record keyed on its digest, zero-padded to DIGEST_SIZE
+typedef struct {
+    unsigned char digest[DIGEST_SIZE];
+    uint64_t path;          // Offset into the pool, or into the mapped scan
+    uint32_t length;
+    uint32_t unused;
+} sort_entry_t;
+
+// One scan reduced to what the join needs
+typedef struct {
+    sort_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    char *pool;
+    size_t pool_used;
+    size_t pool_size;
+    digest_scan_t scan;     // Holds the mapping the paths point into, if any
+} digest_list_t;
+
+// Work item of one radix sort phase
+typedef struct {
+    const sort_entry_t *in;
+    sort_entry_t *out;
+    size_t begin;           // Entry range for the count and scatter phases
+    size_t end;
+    size_t *offsets;        // Per-bucket counts, then scatter positions
+    const size_t *bucket_start;
+    size_t first_bucket;    // Bucket range for the finishing phase
+    size_t last_bucket;
+} radix_task_t;
+
+static const char *entry_path(const digest_list_t *list, const sort_entry_t *entry) {
+    return list->scan.map ? json_map_data(list->scan.map) + entry->path : list->pool + entry->path;
+}
+
+static sort_entry_t *append_entry(digest_list_t *list, const unsigned char digest[DIGEST_SIZE]) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : MIN_ENTRIES;
+        sort_entry_t *entries = realloc(list->entries, capacity * sizeof(sort_entry_t));
+        if (!entries) return NULL;
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+    sort_entry_t *entry = &list->entries[list->count++];
+    memcpy(entry->digest, digest, DIGEST_SIZE);
+    entry->unused = 0;
+    return entry;
+}
+
+// Copy a path into the pool; offsets grow with input order, which keeps the sort stable
+static int add_pooled(digest_list_t *list, const unsigned char digest[DIGEST_SIZE],
+                      const char *path, size_t length) {
+    if (length > UINT32_MAX) return -1;
+    if (length + 1 > list->pool_size - list->pool_used) {
+        size_t size = list->pool_size ? list->pool_size * 2 : MIN_POOL_SIZE;
+        while (length + 1 > size - list->pool_used) size *= 2;
+        char *pool = realloc(list->pool, size);
+        if (!pool) return -1;
+        list->pool = pool;
+        list->pool_size = size;
+    }
+
+    sort_entry_t *entry = append_entry(list, digest);
+    if (!entry) return -1;
+    entry->path = list->pool_used;
+    entry->length = (uint32_t)length;
+    memcpy(list->pool + list->pool_used, path, length + 1);
+    list->pool_used += length + 1;
+    return 0;
+}
+
+// Record callback: mapped paths stay views, others are copied
+static int add_path(const unsigned char digest[DIGEST_SIZE], const char *path, size_t length,
+                    void *user_data) {
+    digest_list_t *list = (digest_list_t *)user_data;
+    json_map_t *map = list->scan.map;
+
+    if (!map) return add_pooled(list, digest, path, length);
+
+    sort_entry_t *entry = append_entry(list, digest);
+    if (!entry) return -1;
+    entry->path = (uint64_t)(path - json_map_data(map));
+    entry->length = (uint32_t)length;
+    return 0;
+}
+
+static int load_list(const char *filepath, calc_hash_t hash, digest_list_t *list) {
+    if (digest_scan_open(&list->scan, filepath, hash, 1) != 0 ||
+        digest_scan_read(&list->scan, add_path, list) != 0) {
+        fprintf(stderr, "Error: Failed to load %s\n", filepath);
+        return -1;
+    }
+    return 0;
+}
+
+static void free_list(digest_list_t *list) {
+    free(list->entries);
+    free(list->pool);
+    digest_scan_close(&list->scan);
+}
+
+static int compare_keys(const sort_entry_t *a, const sort_entry_t *b) {
+    return memcmp(a->digest, b->digest, DIGEST_SIZE);
+}
+
+// Digest order, then input order for equal digests
+static int compare_entries(const void *a, const void *b) {
+    const sort_entry_t *entry_a = (const sort_entry_t *)a;
+    const sort_entry_t *entry_b = (const sort_entry_t *)b;
+    int result = compare_keys(entry_a, entry_b);
+    if (result != 0) return result;
+    return entry_a->path < entry_b->path ? -1 : entry_a->path > entry_b->path;
+}
+
+static size_t bucket_of(const sort_entry_t *entry) {
+    return (size_t)entry->digest[0] << 8 | entry->digest[1];
+}
+
+static void count_task(void *arg) {
+    radix_task_t *task = (radix_task_t *)arg;
+    for (size_t i = task->begin; i < task->end; i++) {
+        task->offsets[bucket_of(&task->in[i])]++;
+    }
+}
+
+static void scatter_task(void *arg) {
+    radix_task_t *task = (radix_task_t *)arg;
+    for (size_t i = task->begin; i < task->end; i++) {
+        task->out[task->offsets[bucket_of(&task->in[i])]++] = task->in[i];
+    }
+}
+
+// Finish a range of buckets; uniform digests leave only a few entries in each
+static void finish_task(void *arg) {
+    radix_task_t *task = (radix_task_t *)arg;
+    for (size_t bucket = task->first_bucket; bucket < task->last_bucket; bucket++) {
+        sort_entry_t *entries = task->out + task->bucket_start[bucket];
+        size_t count = task->bucket_start[bucket + 1] - task->bucket_start[bucket];
+
+        if (count > INSERTION_LIMIT) {
+            qsort(entries, count, sizeof(sort_entry_t), compare_entries);
+            continue;
+        }
+        for (size_t i = 1; i < count; i++) {
+            sort_entry_t entry = entries[i];
+            size_t j = i;
+            while (j > 0 && compare_entries(&entries[j - 1], &entry) > 0) {
+                entries[j] = entries[j - 1];
+                j--;
+            }
+            entries[j] = entry;
+        }
+    }
+}
+
+// Run one task per worker on the pool, or inline without one
+static void run_tasks(thread_pool_t *pool, thread_task_fn fn, radix_task_t *tasks, int count) {
+    for (int t = 0; t < count; t++) {
+        if (!pool || thread_pool_submit(pool, fn, &tasks[t]) != 0) fn(&tasks[t]);
+    }
+    if (pool) thread_pool_wait(pool);
+}
+
+/**
+ * Sort a list by digest: MSD radix sort on the top RADIX_BITS bits
+ *
+ * Every worker counts and then scatters its own slice of the input, with
+ * per-worker bucket offsets so the scatter needs no locking and stays
+ * stable. The buckets are then split into ranges of about equal size and
+ * finished in parallel.
+ */
+static int sort_list(digest_list_t *list, thread_pool_t *pool, int threads) {
+    size_t count = list->count;
+    if (count < 2) return 0;
+    if (count < MIN_PARALLEL_ENTRIES) threads = 1;
+
+    sort_entry_t *sorted = malloc(count * sizeof(sort_entry_t));
+    size_t *offsets = calloc((size_t)threads * RADIX_BUCKETS, sizeof(size_t));
+    size_t *bucket_start = malloc((RADIX_BUCKETS + 1) * sizeof(size_t));
+    radix_task_t *tasks = calloc((size_t)threads, sizeof(radix_task_t));
+    if (!sorted || !offsets || !bucket_start || !tasks) {
+        free(sorted);
+        free(offsets);
+        free(bucket_start);
+        free(tasks);
+        return -1;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        tasks[t].in = list->entries;
+        tasks[t].out = sorted;
+        tasks[t].begin = count * (size_t)t / (size_t)threads;
+        tasks[t].end = count * (size_t)(t + 1) / (size_t)threads;
+        tasks[t].offsets = offsets + (size_t)t * RADIX_BUCKETS;
+        tasks[t].bucket_start = bucket_start;
+    }
+    run_tasks(pool, count_task, tasks, threads);
+
+    // Bucket by bucket, each worker's slice lands after the previous workers'
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+        bucket_start[bucket] = position;
+        for (int t = 0; t < threads; t++) {
+            size_t bucket_count = tasks[t].offsets[bucket];
+            tasks[t].offsets[bucket] = position;
+            position += bucket_count;
+        }
+    }
+    bucket_start[RADIX_BUCKETS] = position;
+    run_tasks(pool, scatter_task, tasks, threads);
+
+    size_t bucket = 0;
+    for (int t = 0; t < threads; t++) {
+        size_t target = count * (size_t)(t + 1) / (size_t)threads;
+        tasks[t].first_bucket = bucket;
+        while (bucket < RADIX_BUCKETS && (t == threads - 1 || bucket_start[bucket + 1] <= target)) {
+            bucket++;
+        }
+        tasks[t].last_bucket = bucket;
+    }
+    run_tasks(pool, finish_task, tasks, threads);
+
+    free(list->entries);
+    list->entries = sorted;
+    list->capacity = count;
+    free(offsets);
+    free(bucket_start);
+    free(tasks);
+    return 0;
+}
+
+// Length of the run of entries equal to entries[start]
+static size_t run_length(const sort_entry_t *entries, size_t start, size_t count) {
+    size_t end = start + 1;
+    while (end < count && compare_keys(&entries[end], &entries[start]) == 0) end++;
+    return end - start;
+}
+
+// Gather the paths of a run into a reusable array
+static const char *const *collect_paths(const digest_list_t *list, size_t start, size_t count,
+                                        compare_paths_t *array) {
+    if (compare_paths_reserve(array, count) != 0) return NULL;
+    for (size_t i = 0; i < count; i++) {
+        const sort_entry_t *entry = &list->entries[start + i];
+        array->paths[i] = entry_path(list, entry);
+        array->lengths[i] = entry->length;
+    }
+    return array->paths;
+}
+
+static int sort_threads(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) return 1;
+    return online > MAX_SORT_THREADS ? MAX_SORT_THREADS : (int)online;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int compare_scan_digests(const char *file1_path, const char *file2_path,
+                         const char *diff_output_path, const char *same_output_path) {
+    if (!file1_path || !file2_path || !diff_output_path || !same_output_path) {
+        fprintf(stderr, "Error: Invalid parameters\n");
+        return -1;
+    }
+    json_diff_options_t options;
+    json_diff_get_options(&options);
+    if (options.mem_limit > 0) {
+        return compare_scan_digests_external(file1_path, file2_path, diff_output_path,
+                                             same_output_path, options.mem_limit,
+                                             options.temp_dir);
+    }
+
+    calc_hash_t hash;
+    if (scan_reader_check_hash(file1_path, file2_path, &hash) != 0) {
+        return -1;
+    }
+
+    compare_output_print_header("Comparing scans by sorted digest", file1_path, file2_path,
+                                diff_output_path, same_output_path);
+
+    digest_list_t list1;
+    digest_list_t list2;
+    memset(&list1, 0, sizeof(list1));
+    memset(&list2, 0, sizeof(list2));
+    if (load_list(file1_path, hash, &list1) != 0 || load_list(file2_path, hash, &list2) != 0) {
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    int threads = sort_threads();
+    thread_pool_t *pool = threads > 1 ? thread_pool_create(threads) : NULL;
+    struct timespec sort_start;
+    clock_gettime(CLOCK_MONOTONIC, &sort_start);
+    int sorted = sort_list(&list1, pool, threads) == 0 && sort_list(&list2, pool, threads) == 0;
+    double sort_seconds = elapsed_seconds(&sort_start);
+    if (pool) thread_pool_destroy(pool);
+    if (!sorted) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    compare_output_t *diff;
+    compare_output_t *same;
+    if (compare_output_open_digest(diff_output_path, same_output_path, file1_path, file2_path,
+                                   "sort", hash, &diff, &same) != 0) {
+        free_list(&list1);
+        free_list(&list2);
+        return -1;
+    }
+
+    // Merge: each step consumes the run of the smallest digest on either side
+    compare_paths_t paths1 = {NULL, NULL, 0};
+    compare_paths_t paths2 = {NULL, NULL, 0};
+    size_t same_files = 0;
+    size_t diff_files = 0;
+    size_t i = 0;
+    size_t j = 0;
+    int result = 0;
+    char hex[2 * DIGEST_SIZE + 1];
+
+    while ((i < list1.count || j < list2.count) && result == 0) {
+        int order = i == list1.count ? 1 :
+                    j == list2.count ? -1 : compare_keys(&list1.entries[i], &list2.entries[j]);
+        const sort_entry_t *key = order <= 0 ? &list1.entries[i] : &list2.entries[j];
+        size_t run1 = order <= 0 ? run_length(list1.entries, i, list1.count) : 0;
+        size_t run2 = order >= 0 ? run_length(list2.entries, j, list2.count) : 0;
+
+        digest_to_hex(key->digest, list1.scan.digest_size, hex);
+
+        compare_record_t record = {0};
+        record.grouped = 1;
+        record.digest = hex;
+        if (run1 > 0) {
+            record.file1_paths = collect_paths(&list1, i, run1, &paths1);
+            record.file1_count = run1;
+            // Mapped paths are still JSON-escaped and are written as they are
+            record.file1_lengths = list1.scan.map ? paths1.lengths : NULL;
+        }
+        if (run2 > 0) {
+            record.file2_paths = collect_paths(&list2, j, run2, &paths2);
+            record.file2_count = run2;
+            record.file2_lengths = list2.scan.map ? paths2.lengths : NULL;
+        }
+        if ((run1 > 0 && !record.file1_paths) || (run2 > 0 && !record.file2_paths)) {
+            result = -1;
+            break;
+        }
+
+        if (run1 > 0 && run2 > 0) {
+            record.status = "same";
+            compare_output_write(same, &record);
+            same_files += run1 + run2;
+        } else {
+            record.status = run1 > 0 ? "only_in_file1" : "only_in_file2";
+            compare_output_write(diff, &record);
+            diff_files += run1 + run2;
+        }
+        i += run1;
+        j += run2;
+    }
+    compare_paths_free(&paths1);
+    compare_paths_free(&paths2);
+
+    if (result != 0) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+    }
+    result = compare_output_close_digest(diff, same, diff_output_path, same_output_path,
+                                         diff_files, same_files, result);
+    if (result == 0) {
+        printf("Radix sort: %zu + %zu entries on %d thread%s in %.3fs\n",
+               list1.count, list2.count, threads, threads == 1 ? "" : "s", sort_seconds);
+    }
+
+    free_list(&list1);
+    free_list(&list2);
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef SORT_JOIN_H
+#define SORT_JOIN_H
+
+/**
+ * Compare two scans by digest with a sort-merge join
+ *
+ * Both scans are loaded into flat arrays of (digest, path) entries, which
+ * are radix-sorted on the digest in parallel: one scatter pass on the top
+ * 16 bits, which MD5 spreads evenly over the buckets, then each bucket is
+ * finished on its own. A single linear merge of the two sorted arrays
+ * then yields the same grouped rows as compare_json_files() ("same",
+ * "only_in_file1", "only_in_file2"), in digest order rather than scan
+ * order, so the output does not depend on the input order of either scan.
+ * With a mem_limit set (json_diff_set_options()) the scans are joined out
+ * of core by external_join.h instead.
+ *
+ * @param file1_path Path to the first scan file
+ * @param file2_path Path to the second scan file
+ * @param diff_output_path Output path for digests found on one side only
+ * @param same_output_path Output path for digests found on both sides
+ * @return 0 on success, -1 on error
+ */
+int compare_scan_digests(const char *file1_path, const char *file2_path,
+                         const char *diff_output_path, const char *same_output_path);
+
+#endif // SORT_JOIN_H
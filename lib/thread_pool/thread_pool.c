@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+typedef struct {
+    thread_task_fn fn;
+    void *arg;
+} thread_task_t;
+
+// Growable ring buffer of tasks owned by one worker
+typedef struct {
+    thread_task_t *tasks;
+    size_t head;
+    size_t count;
+    size_t capacity;
+    pthread_mutex_t lock;
+} task_deque_t;
+
+struct thread_pool {
+    pthread_t *threads;
+    task_deque_t *deques;
+    int num_threads;
+    int started;
+    unsigned int next_deque;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    size_t queued;      // tasks sitting in some deque
+    size_t unfinished;  // tasks queued or running
+    size_t steals;
+    int shutdown;
+};
+
+typedef struct {
+    thread_pool_t *pool;
+    int id;
+} worker_arg_t;
+
+static int deque_push(task_deque_t *dq, thread_task_t task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count == dq->capacity) {
+        size_t new_capacity = dq->capacity ? dq->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+        thread_task_t *tasks = malloc(new_capacity * sizeof(thread_task_t));
+        if (!tasks) {
+            pthread_mutex_unlock(&dq->lock);
+            return -1;
+        }
+        // Unwrap the ring into the new buffer
+        for (size_t i = 0; i < dq->count; i++) {
+            tasks[i] = dq->tasks[(dq->head + i) % dq->capacity];
+        }
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->head = 0;
+        dq->capacity = new_capacity;
+    }
+    dq->tasks[(dq->head + dq->count) % dq->capacity] = task;
+    dq->count++;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+// Owner and thieves both take the oldest task, so tasks complete in
+// roughly the order they were submitted.
+static int deque_take(task_deque_t *dq, thread_task_t *task) {
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0) {
+        *task = dq->tasks[dq->head];
+        dq->head = (dq->head + 1) % dq->capacity;
+        dq->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static void *worker_main(void *arg) {
+    worker_arg_t *warg = (worker_arg_t *)arg;
+    thread_pool_t *pool = warg->pool;
+    int id = warg->id;
+    free(warg);
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->queued == 0 && pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        // Reserve one task; it is guaranteed to be in some deque
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        thread_task_t task;
+        int stolen = 0;
+        while (!deque_take(&pool->deques[id], &task)) {
+            int found = 0;
+            for (int i = 1; i < pool->num_threads; i++) {
+                int victim = (id + i) % pool->num_threads;
+                if (deque_take(&pool->deques[victim], &task)) {
+                    found = 1;
+                    break;
+                }
+            }
+            if (found) {
+                stolen = 1;
+                break;
+            }
+        }
+
+        task.fn(task.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (stolen) {
+            pool->steals++;
+        }
+        pool->unfinished--;
+        if (pool->unfinished == 0) {
+            pthread_cond_broadcast(&pool->done_cond);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+thread_pool_t *thread_pool_create(int num_threads) {
+    if (num_threads < 1) return NULL;
+
+    thread_pool_t *pool = calloc(1, sizeof(thread_pool_t));
+    if (!pool) return NULL;
+
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    pool->deques = calloc(num_threads, sizeof(task_deque_t));
+    if (!pool->threads || !pool->deques) {
+        free(pool->threads);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pool->num_threads = num_threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        worker_arg_t *warg = malloc(sizeof(worker_arg_t));
+        if (warg) {
+            warg->pool = pool;
+            warg->id = i;
+        }
+        if (!warg || pthread_create(&pool->threads[i], NULL, worker_main, warg) != 0) {
+            free(warg);
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+        pool->started++;
+    }
+
+    return pool;
+}
+
+int thread_pool_submit(thread_pool_t *pool, thread_task_fn fn, void *arg) {
+    if (!pool || !fn) return -1;
+
+    thread_task_t task = { fn, arg };
+
+    pthread_mutex_lock(&pool->lock);
+    int target = (int)(pool->next_deque++ % (unsigned int)pool->num_threads);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (deque_push(&pool->deques[target], task) != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queued++;
+    pool->unfinished++;
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+void thread_pool_wait(thread_pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(thread_pool_t *pool) {
+    if (!pool) return;
+
+    thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        free(pool->deques[i].tasks);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
+
+size_t thread_pool_steal_count(thread_pool_t *pool) {
+    if (!pool) return 0;
+
+    pthread_mutex_lock(&pool->lock);
+    size_t steals = pool->steals;
+    pthread_mutex_unlock(&pool->lock);
+    return steals;
+}
@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+// Task function executed by a pool worker
+typedef void (*thread_task_fn)(void *arg);
+
+typedef struct thread_pool thread_pool_t;
+
+/**
+ * Create a work-stealing thread pool
+ *
+ * Every worker owns a task deque. Submitted tasks are spread over the
+ * deques round-robin; an idle worker first drains its own deque and then
+ * steals from the others, so one slow task never stalls a whole queue.
+ *
+ * @param num_threads Number of worker threads (must be >= 1)
+ * @return Pool handle or NULL on error
+ */
+thread_pool_t *thread_pool_create(int num_threads);
+
+/**
+ * Queue a task for execution
+ *
+ * @param pool Thread pool
+ * @param fn Task function
+ * @param arg Argument passed to the task function
+ * @return 0 on success, -1 on error
+ */
+int thread_pool_submit(thread_pool_t *pool, thread_task_fn fn, void *arg);
+
+/**
+ * Block until every submitted task has finished
+ *
+ * @param pool Thread pool
+ */
+void thread_pool_wait(thread_pool_t *pool);
+
+/**
+ * Wait for outstanding tasks, stop the workers and free the pool
+ *
+ * @param pool Thread pool
+ */
+void thread_pool_destroy(thread_pool_t *pool);
+
+// Number of tasks taken from another worker's deque so far
+size_t thread_pool_steal_count(thread_pool_t *pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,589 @@
+#define _GNU_SOURCE
+#include "uring_md5.h"
+#include "../calc_md5/calc_md5.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+enum {
+    OP_OPEN = 1,
+    OP_READ,
+    OP_FADVISE,
+    OP_CLOSE,
+    OP_PROBE
+};
+
+#define MAKE_USER_DATA(slot, op) (((uint64_t)(slot) << 8) | (uint64_t)(op))
+#define USER_DATA_SLOT(data) ((unsigned int)((data) >> 8))
+#define USER_DATA_OP(data) ((int)((data) & 0xff))
+
+// Mapped submission and completion rings
+typedef struct {
+    int fd;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    unsigned int sq_entries;
+    unsigned int sqe_tail;  // Local tail, published on submit
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} uring_t;
+
+// State of one in-flight file
+typedef struct {
+    int active;
+    int fd;            // Plain descriptor when fixed files are not in use
+    int failed;
+    int direct;        // Opened with O_DIRECT
+    const char *path;
+    void *ctx;
+    uint64_t offset;
+    calc_hash_set_t hashes;
+    uint8_t *buffer;
+} uring_slot_t;
+
+typedef struct {
+    uring_t ring;
+    uring_slot_t *slots;
+    unsigned int *free_slots;
+    unsigned int free_count;
+    unsigned int depth;
+    int dir_fd;
+    int fixed_buffers;  // Buffers registered with IORING_REGISTER_BUFFERS
+    int fixed_files;    // Files opened directly into the fixed file table
+    int direct_io;      // Try O_DIRECT first (calc_md5_options_t.direct_io)
+    int fadvise;        // Drop hashed files from the page cache
+    calc_hash_t hashes[CALC_HASH_COUNT];
+    int hash_count;
+    uring_md5_done_fn done;
+    void *user_data;
+} uring_engine_t;
+
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_teardown(uring_t *ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int ring_setup(uring_t *ring, unsigned int entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = sys_io_uring_setup(entries, &params);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return -1;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        ring_teardown(ring);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            ring_teardown(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_teardown(ring);
+        return -1;
+    }
+
+    char *sq = (char *)ring->sq_ptr;
+    char *cq = (char *)ring->cq_ptr;
+    ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+static struct io_uring_sqe *ring_get_sqe(uring_t *ring) {
+    unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+
+    unsigned int index = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Publish queued SQEs and optionally wait for completions
+static int ring_submit(uring_t *ring, unsigned int wait_nr) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        // Entries the kernel has not consumed yet, including any left over
+        // from a previous partial submission
+        unsigned int to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (to_submit == 0 && wait_nr == 0) {
+            return 0;
+        }
+
+        int ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+                                     wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret >= 0) {
+            if ((unsigned int)ret >= to_submit || wait_nr) {
+                return 0;
+            }
+            continue;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -1;
+        }
+    }
+}
+
+int uring_md5_available(void) {
+    uring_t ring;
+    if (ring_setup(&ring, 4) != 0) {
+        return 0;
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    int supported = 0;
+
+    if (probe && sys_io_uring_register(ring.fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        static const int needed[] = {
+            IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_FADVISE, IORING_OP_CLOSE
+        };
+        supported = 1;
+        for (size_t i = 0; i < sizeof(needed) / sizeof(needed[0]); i++) {
+            if (needed[i] > probe->last_op || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = 0;
+            }
+        }
+    }
+
+    free(probe);
+    ring_teardown(&ring);
+    return supported;
+}
+
+static void prep_open(uring_engine_t *engine, unsigned int slot) {
+    uring_slot_t *s = &engine->slots[slot];
+    struct io_uring_sqe *sqe = ring_get_sqe(&engine->ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = engine->dir_fd;
+    sqe->addr = (uint64_t)(uintptr_t)s->path;
+    if (engine->fixed_files) {
+        // Direct descriptors never reach the fd table, so O_CLOEXEC is invalid
+        sqe->open_flags = O_RDONLY;
+        sqe->file_index = slot + 1;
+    } else {
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    }
+    if (s->direct) {
+        sqe->open_flags |= O_DIRECT;
+    }
+    sqe->user_data = MAKE_USER_DATA(slot, OP_OPEN);
+}
+
+static void prep_read(uring_engine_t *engine, unsigned int slot) {
+    uring_slot_t *s = &engine->slots[slot];
+    struct io_uring_sqe *sqe = ring_get_sqe(&engine->ring);
+    sqe->opcode = engine->fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    if (engine->fixed_files) {
+        sqe->fd = (int)slot;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = s->fd;
+    }
+    sqe->addr = (uint64_t)(uintptr_t)s->buffer;
+    sqe->len = URING_MD5_BLOCK_SIZE;
+    sqe->off = s->offset;
+    sqe->buf_index = (uint16_t)slot;
+    sqe->user_data = MAKE_USER_DATA(slot, OP_READ);
+}
+
+// Release a fully hashed file's pages before closing it
+static void prep_fadvise(uring_engine_t *engine, unsigned int slot) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&engine->ring);
+    sqe->opcode = IORING_OP_FADVISE;
+    if (engine->fixed_files) {
+        sqe->fd = (int)slot;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = engine->slots[slot].fd;
+    }
+    sqe->off = 0;
+    sqe->len = 0;
+    sqe->fadvise_advice = POSIX_FADV_DONTNEED;
+    sqe->user_data = MAKE_USER_DATA(slot, OP_FADVISE);
+}
+
+static void prep_close(uring_engine_t *engine, unsigned int slot) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&engine->ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    if (engine->fixed_files) {
+        sqe->file_index = slot + 1;
+    } else {
+        sqe->fd = engine->slots[slot].fd;
+    }
+    sqe->user_data = MAKE_USER_DATA(slot, OP_CLOSE);
+}
+
+// Report the file's result and release its slot
+static void finish_slot(uring_engine_t *engine, unsigned int slot) {
+    uring_slot_t *s = &engine->slots[slot];
+
+    if (s->failed) {
+        engine->done(engine->user_data, s->ctx, -1, NULL);
+    } else {
+        calc_hash_digests_t digests;
+        calc_hash_set_final(&s->hashes, &digests);
+        engine->done(engine->user_data, s->ctx, 0, &digests);
+    }
+
+    s->active = 0;
+    engine->free_slots[engine->free_count++] = slot;
+}
+
+// Drop O_DIRECT from a slot's file and resubmit the read at its offset. A
+// direct descriptor has no fd to fcntl(), so the file is opened again
+// buffered into the same table entry, which replaces the old one.
+static void read_buffered(uring_engine_t *engine, unsigned int slot) {
+    uring_slot_t *s = &engine->slots[slot];
+    s->direct = 0;
+    if (engine->fixed_files) {
+        prep_open(engine, slot);
+        return;
+    }
+    int flags = fcntl(s->fd, F_GETFL);
+    if (flags < 0 || fcntl(s->fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+        s->failed = 1;
+        prep_close(engine, slot);
+        return;
+    }
+    prep_read(engine, slot);
+}
+
+static void handle_cqe(uring_engine_t *engine, const struct io_uring_cqe *cqe) {
+    unsigned int slot = USER_DATA_SLOT(cqe->user_data);
+    uring_slot_t *s = &engine->slots[slot];
+    int res = cqe->res;
+
+    switch (USER_DATA_OP(cqe->user_data)) {
+        case OP_OPEN:
+            if (res == -EINVAL && s->direct) {
+                // Filesystem without O_DIRECT support: open buffered
+                s->direct = 0;
+                prep_open(engine, slot);
+                return;
+            }
+            if (res < 0) {
+                s->failed = 1;
+                finish_slot(engine, slot);
+                return;
+            }
+            if (!engine->fixed_files) {
+                s->fd = res;
+            }
+            prep_read(engine, slot);
+            break;
+
+        case OP_READ:
+            if (res == -EINTR || res == -EAGAIN) {
+                prep_read(engine, slot);
+            } else if (res == -EINVAL && s->direct) {
+                // A short O_DIRECT read leaves the offset unaligned; read the
+                // rest buffered, as hash_direct() does
+                read_buffered(engine, slot);
+            } else if (res > 0) {
+                calc_hash_set_update(&s->hashes, s->buffer, (size_t)res);
+                s->offset += (uint64_t)res;
+                prep_read(engine, slot);
+            } else if (res == 0 && engine->fadvise && !s->direct) {
+                prep_fadvise(engine, slot);
+            } else {
+                if (res < 0) {
+                    s->failed = 1;
+                }
+                prep_close(engine, slot);
+            }
+            break;
+
+        case OP_FADVISE:
+            // Advice is best effort; its result does not affect the digest
+            prep_close(engine, slot);
+            break;
+
+        case OP_CLOSE:
+            // The slot's file table entry is free again once this completes
+            finish_slot(engine, slot);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int reap_completions(uring_engine_t *engine) {
+    uring_t *ring = &engine->ring;
+    unsigned int head = *ring->cq_head;
+    unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int reaped = 0;
+
+    while (head != tail) {
+        struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        handle_cqe(engine, &cqe);
+        reaped++;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    return reaped;
+}
+
+// Open "." straight into fixed file slot 0 to see whether the kernel
+// supports direct descriptors (5.15+); otherwise plain fds are used.
+static int probe_direct_open(uring_engine_t *engine) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&engine->ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = engine->dir_fd;
+    sqe->addr = (uint64_t)(uintptr_t)".";
+    sqe->open_flags = O_RDONLY | O_DIRECTORY;
+    sqe->file_index = 1;
+    sqe->user_data = MAKE_USER_DATA(0, OP_PROBE);
+
+    if (ring_submit(&engine->ring, 1) != 0) {
+        return 0;
+    }
+
+    uring_t *ring = &engine->ring;
+    unsigned int head = *ring->cq_head;
+    struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    if (cqe.res < 0) {
+        return 0;
+    }
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = 1;
+    sqe->user_data = MAKE_USER_DATA(0, OP_PROBE);
+    if (ring_submit(ring, 1) != 0) {
+        return 0;
+    }
+    head = *ring->cq_head;
+    cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return cqe.res == 0;
+}
+
+static void engine_destroy(uring_engine_t *engine) {
+    ring_teardown(&engine->ring);
+    if (engine->slots) {
+        for (unsigned int i = 0; i < engine->depth; i++) {
+            free(engine->slots[i].buffer);
+        }
+    }
+    free(engine->slots);
+    free(engine->free_slots);
+}
+
+static int engine_init(uring_engine_t *engine, int dir_fd, unsigned int depth) {
+    memset(engine, 0, sizeof(*engine));
+    engine->ring.fd = -1;
+    engine->dir_fd = dir_fd;
+    engine->depth = depth;
+
+    calc_md5_options_t options;
+    calc_md5_get_options(&options);
+    engine->direct_io = options.direct_io;
+    engine->fadvise = options.fadvise;
+    memcpy(engine->hashes, options.hashes, sizeof(engine->hashes));
+    engine->hash_count = options.hash_count;
+
+    if (ring_setup(&engine->ring, depth) != 0) {
+        return -1;
+    }
+
+    engine->slots = calloc(depth, sizeof(uring_slot_t));
+    engine->free_slots = malloc(depth * sizeof(unsigned int));
+    struct iovec *iovs = malloc(depth * sizeof(struct iovec));
+    int *fds = malloc(depth * sizeof(int));
+    if (!engine->slots || !engine->free_slots || !iovs || !fds) {
+        free(iovs);
+        free(fds);
+        engine_destroy(engine);
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < depth; i++) {
+        void *buffer = NULL;
+        if (posix_memalign(&buffer, 4096, URING_MD5_BLOCK_SIZE) != 0) {
+            free(iovs);
+            free(fds);
+            engine_destroy(engine);
+            return -1;
+        }
+        engine->slots[i].buffer = buffer;
+        engine->slots[i].fd = -1;
+        iovs[i].iov_base = buffer;
+        iovs[i].iov_len = URING_MD5_BLOCK_SIZE;
+        fds[i] = -1;
+        engine->free_slots[i] = depth - 1 - i;
+    }
+    engine->free_count = depth;
+
+    // Registration can fail under a tight RLIMIT_MEMLOCK; plain reads still work
+    engine->fixed_buffers = sys_io_uring_register(engine->ring.fd, IORING_REGISTER_BUFFERS,
+                                                  iovs, depth) == 0;
+    if (sys_io_uring_register(engine->ring.fd, IORING_REGISTER_FILES, fds, depth) == 0) {
+        engine->fixed_files = probe_direct_open(engine);
+    }
+
+    free(iovs);
+    free(fds);
+    return 0;
+}
+
+int uring_md5_run(int dir_fd, unsigned int queue_depth,
+                  uring_md5_next_fn next, uring_md5_done_fn done, void *user_data) {
+    if (!next || !done) return -1;
+    if (queue_depth == 0) queue_depth = URING_MD5_DEFAULT_DEPTH;
+
+    uring_engine_t engine;
+    if (engine_init(&engine, dir_fd, queue_depth) != 0) {
+        return -1;
+    }
+    engine.done = done;
+    engine.user_data = user_data;
+
+    int input_done = 0;
+    int ring_failed = 0;
+
+    while (!ring_failed) {
+        // Keep every free slot busy with a new file
+        while (!input_done && engine.free_count > 0) {
+            uring_md5_file_t file;
+            int in_flight = engine.free_count < engine.depth;
+            int got = next(user_data, !in_flight, &file);
+            if (got < 0) {
+                input_done = 1;
+                break;
+            }
+            if (got == 0) {
+                break;
+            }
+
+            unsigned int slot = engine.free_slots[--engine.free_count];
+            uring_slot_t *s = &engine.slots[slot];
+            s->active = 1;
+            s->failed = 0;
+            s->fd = -1;
+            s->direct = engine.direct_io;
+            s->path = file.path;
+            s->ctx = file.ctx;
+            s->offset = 0;
+            calc_hash_set_init(&s->hashes, engine.hashes, engine.hash_count);
+            prep_open(&engine, slot);
+        }
+
+        if (engine.free_count == engine.depth) {
+            if (input_done) break;
+            continue;
+        }
+
+        if (ring_submit(&engine.ring, 1) != 0) {
+            fprintf(stderr, "Error: io_uring submission failed: %s\n", strerror(errno));
+            ring_failed = 1;
+            break;
+        }
+        reap_completions(&engine);
+    }
+
+    if (ring_failed) {
+        // Fail whatever is still in flight and drain the input
+        for (unsigned int i = 0; i < engine.depth; i++) {
+            if (engine.slots[i].active) {
+                if (!engine.fixed_files && engine.slots[i].fd >= 0) {
+                    close(engine.slots[i].fd);
+                }
+                engine.slots[i].failed = 1;
+                finish_slot(&engine, i);
+            }
+        }
+        uring_md5_file_t file;
+        int got;
+        while (!input_done && (got = next(user_data, 1, &file)) >= 0) {
+            if (got > 0) {
+                done(user_data, file.ctx, -1, NULL);
+            }
+        }
+    }
+
+    engine_destroy(&engine);
+    return 0;
+}
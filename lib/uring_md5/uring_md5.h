@@ -0,0 +1,58 @@
+#ifndef URING_MD5_H
+#define URING_MD5_H
+
+#include <stddef.h>
+#include "../calc_md5/calc_md5.h"
+
+#define URING_MD5_DEFAULT_DEPTH 32
+#define URING_MD5_BLOCK_SIZE (128 * 1024)
+
+// File handed to the io_uring engine
+typedef struct {
+    const char *path;  // Path relative to the engine's directory descriptor
+    void *ctx;         // Caller cookie returned in the completion callback
+} uring_md5_file_t;
+
+/**
+ * Fetch the next file to hash
+ *
+ * @param user_data Engine user data
+ * @param wait Non-zero when nothing is in flight and the call may block
+ * @param file Filled with the next file
+ * @return 1 if a file was returned, 0 if none is ready yet, -1 when done
+ */
+typedef int (*uring_md5_next_fn)(void *user_data, int wait, uring_md5_file_t *file);
+
+// Completion callback; digests is NULL when status is non-zero
+typedef void (*uring_md5_done_fn)(void *user_data, void *ctx, int status,
+                                  const calc_hash_digests_t *digests);
+
+/**
+ * Check whether the running kernel supports the io_uring operations used
+ * by the engine (openat, fixed-buffer reads, registered files)
+ *
+ * @return 1 if supported, 0 otherwise
+ */
+int uring_md5_available(void);
+
+/**
+ * Hash files with io_uring, keeping up to queue_depth files in flight
+ *
+ * Each in-flight file owns a registered buffer and a slot in the ring's
+ * fixed file table; opens and reads are submitted asynchronously and every
+ * completed block is fed to each of that file's configured digests. Files are opened with
+ * O_DIRECT when calc_md5_options_t.direct_io is set. Returns without
+ * calling next() if the ring cannot be set up, so the caller can fall back
+ * to the synchronous path.
+ *
+ * @param dir_fd Directory that file paths are relative to
+ * @param queue_depth Maximum number of files in flight
+ * @param next Source of files
+ * @param done Called once per file
+ * @param user_data Passed through to the callbacks
+ * @return 0 on success, -1 if the ring could not be set up
+ */
+int uring_md5_run(int dir_fd, unsigned int queue_depth,
+                  uring_md5_next_fn next, uring_md5_done_fn done, void *user_data);
+
+#endif // URING_MD5_H
@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include "xxh3.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define STRIPE_LEN 64
+#define SECRET_CONSUME_RATE 8
+#define SECRET_SIZE 192
+#define SECRET_MERGEACCS_START 11
+#define SECRET_LASTACC_START 7
+#define MID_SIZE_MAX 240
+#define SECRET_SIZE_MIN 136
+// Stripes accumulated between two scrambles of the accumulators
+#define STRIPES_PER_BLOCK ((SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE)
+
+// Default secret of the reference implementation
+static const uint8_t secret[SECRET_SIZE] __attribute__((aligned(64))) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static const uint64_t initial_acc[8] = {
+    PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+    PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+};
+
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} u128_t;
+
+static inline uint32_t read32(const uint8_t *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+#endif
+}
+
+static inline void write64_be(uint8_t *p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static inline uint64_t mult32to64(uint64_t a, uint64_t b) {
+    return (uint64_t)(uint32_t)a * (uint32_t)b;
+}
+
+static inline u128_t mult64to128(uint64_t a, uint64_t b) {
+    u128_t r;
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128)a * b;
+    r.lo = (uint64_t)product;
+    r.hi = (uint64_t)(product >> 64);
+#else
+    uint64_t lo_lo = mult32to64(a, b);
+    uint64_t hi_lo = mult32to64(a >> 32, b);
+    uint64_t lo_hi = mult32to64(a, b >> 32);
+    uint64_t hi_hi = mult32to64(a >> 32, b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    r.hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    r.lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+    return r;
+}
+
+static inline uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+    u128_t product = mult64to128(a, b);
+    return product.lo ^ product.hi;
+}
+
+static inline uint64_t xorshift64(uint64_t value, int shift) {
+    return value ^ (value >> shift);
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h) {
+    h = xorshift64(h, 37);
+    h *= 0x165667919E3779F9ULL;
+    return xorshift64(h, 32);
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+// Short inputs: one to three bytes
+static u128_t len_1to3(const uint8_t *input, size_t len) {
+    uint32_t c1 = input[0];
+    uint32_t c2 = input[len >> 1];
+    uint32_t c3 = input[len - 1];
+    uint32_t combined_lo = (c1 << 16) | (c2 << 24) | c3 | ((uint32_t)len << 8);
+    uint32_t combined_hi = rotl32(__builtin_bswap32(combined_lo), 13);
+    uint64_t flip_lo = (uint64_t)(read32(secret) ^ read32(secret + 4));
+    uint64_t flip_hi = (uint64_t)(read32(secret + 8) ^ read32(secret + 12));
+    u128_t h;
+    h.lo = xxh64_avalanche(combined_lo ^ flip_lo);
+    h.hi = xxh64_avalanche(combined_hi ^ flip_hi);
+    return h;
+}
+
+static u128_t len_4to8(const uint8_t *input, size_t len) {
+    uint32_t input_lo = read32(input);
+    uint32_t input_hi = read32(input + len - 4);
+    uint64_t input_64 = input_lo + ((uint64_t)input_hi << 32);
+    uint64_t flip = read64(secret + 16) ^ read64(secret + 24);
+    uint64_t keyed = input_64 ^ flip;
+    u128_t m = mult64to128(keyed, PRIME64_1 + ((uint64_t)len << 2));
+
+    m.hi += m.lo << 1;
+    m.lo ^= m.hi >> 3;
+    m.lo = xorshift64(m.lo, 35);
+    m.lo *= 0x9FB21C651E98DF25ULL;
+    m.lo = xorshift64(m.lo, 28);
+    m.hi = xxh3_avalanche(m.hi);
+    return m;
+}
+
+static u128_t len_9to16(const uint8_t *input, size_t len) {
+    uint64_t flip_lo = read64(secret + 32) ^ read64(secret + 40);
+    uint64_t flip_hi = read64(secret + 48) ^ read64(secret + 56);
+    uint64_t input_lo = read64(input);
+    uint64_t input_hi = read64(input + len - 8);
+    u128_t m = mult64to128(input_lo ^ input_hi ^ flip_lo, PRIME64_1);
+
+    m.lo += (uint64_t)(len - 1) << 54;
+    input_hi ^= flip_hi;
+    m.hi += input_hi + mult32to64((uint32_t)input_hi, PRIME32_2 - 1);
+    m.lo ^= __builtin_bswap64(m.hi);
+
+    u128_t h = mult64to128(m.lo, PRIME64_2);
+    h.hi += m.hi * PRIME64_2;
+    h.lo = xxh3_avalanche(h.lo);
+    h.hi = xxh3_avalanche(h.hi);
+    return h;
+}
+
+static u128_t len_0to16(const uint8_t *input, size_t len) {
+    if (len > 8) return len_9to16(input, len);
+    if (len >= 4) return len_4to8(input, len);
+    if (len > 0) return len_1to3(input, len);
+
+    u128_t h;
+    h.lo = xxh64_avalanche(read64(secret + 64) ^ read64(secret + 72));
+    h.hi = xxh64_avalanche(read64(secret + 80) ^ read64(secret + 88));
+    return h;
+}
+
+static inline uint64_t mix16(const uint8_t *input, const uint8_t *key) {
+    return mul128_fold64(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+}
+
+static inline void mix32(u128_t *acc, const uint8_t *input1, const uint8_t *input2,
+                         const uint8_t *key) {
+    acc->lo += mix16(input1, key);
+    acc->lo ^= read64(input2) + read64(input2 + 8);
+    acc->hi += mix16(input2, key + 16);
+    acc->hi ^= read64(input1) + read64(input1 + 8);
+}
+
+static u128_t mix_final(u128_t acc, size_t len) {
+    u128_t h;
+    h.lo = xxh3_avalanche(acc.lo + acc.hi);
+    h.hi = 0 - xxh3_avalanche(acc.lo * PRIME64_1 + acc.hi * PRIME64_4 + (uint64_t)len * PRIME64_2);
+    return h;
+}
+
+static u128_t len_17to128(const uint8_t *input, size_t len) {
+    u128_t acc = {(uint64_t)len * PRIME64_1, 0};
+
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                mix32(&acc, input + 48, input + len - 64, secret + 96);
+            }
+            mix32(&acc, input + 32, input + len - 48, secret + 64);
+        }
+        mix32(&acc, input + 16, input + len - 32, secret + 32);
+    }
+    mix32(&acc, input, input + len - 16, secret);
+    return mix_final(acc, len);
+}
+
+static u128_t len_129to240(const uint8_t *input, size_t len) {
+    u128_t acc = {(uint64_t)len * PRIME64_1, 0};
+    size_t rounds = len / 32;
+    size_t i;
+
+    for (i = 0; i < 4; i++) {
+        mix32(&acc, input + 32 * i, input + 32 * i + 16, secret + 32 * i);
+    }
+    acc.lo = xxh3_avalanche(acc.lo);
+    acc.hi = xxh3_avalanche(acc.hi);
+    for (; i < rounds; i++) {
+        mix32(&acc, input + 32 * i, input + 32 * i + 16, secret + 3 + 32 * (i - 4));
+    }
+    mix32(&acc, input + len - 16, input + len - 32, secret + SECRET_SIZE_MIN - 17 - 16);
+    return mix_final(acc, len);
+}
+
+// Fold one 64-byte stripe into the accumulators
+static inline void accumulate_512(uint64_t acc[8], const uint8_t *input, const uint8_t *key) {
+#if defined(__SSE2__)
+    __m128i *xacc = (__m128i *)acc;
+    for (int i = 0; i < 4; i++) {
+        __m128i acc_vec = _mm_loadu_si128(xacc + i);
+        __m128i data = _mm_loadu_si128((const __m128i *)input + i);
+        __m128i data_key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)key + i));
+        __m128i data_key_lo = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(data_key, data_key_lo);
+        __m128i data_swap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm_storeu_si128(xacc + i, _mm_add_epi64(product, _mm_add_epi64(acc_vec, data_swap)));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        uint64_t data = read64(input + 8 * i);
+        uint64_t data_key = data ^ read64(key + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += mult32to64(data_key, data_key >> 32);
+    }
+#endif
+}
+
+static inline void scramble_acc(uint64_t acc[8], const uint8_t *key) {
+#if defined(__SSE2__)
+    __m128i *xacc = (__m128i *)acc;
+    const __m128i prime32 = _mm_set1_epi32((int)PRIME32_1);
+    for (int i = 0; i < 4; i++) {
+        __m128i acc_vec = _mm_loadu_si128(xacc + i);
+        __m128i data = _mm_xor_si128(acc_vec, _mm_srli_epi64(acc_vec, 47));
+        __m128i data_key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)key + i));
+        __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product_lo = _mm_mul_epu32(data_key, prime32);
+        __m128i product_hi = _mm_mul_epu32(data_key_hi, prime32);
+        _mm_storeu_si128(xacc + i, _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32)));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        uint64_t value = xorshift64(acc[i], 47) ^ read64(key + 8 * i);
+        acc[i] = value * PRIME32_1;
+    }
+#endif
+}
+
+static void accumulate(uint64_t acc[8], const uint8_t *input, const uint8_t *key, size_t stripes) {
+    for (size_t i = 0; i < stripes; i++) {
+        accumulate_512(acc, input + i * STRIPE_LEN, key + i * SECRET_CONSUME_RATE);
+    }
+}
+
+// Accumulate stripes continuing a block that already holds done stripes;
+// returns the number of stripes in the block afterwards
+static size_t consume_stripes(uint64_t acc[8], const uint8_t *input, size_t stripes, size_t done) {
+    if (STRIPES_PER_BLOCK - done <= stripes) {
+        size_t to_end = STRIPES_PER_BLOCK - done;
+        accumulate(acc, input, secret + done * SECRET_CONSUME_RATE, to_end);
+        scramble_acc(acc, secret + SECRET_SIZE - STRIPE_LEN);
+        accumulate(acc, input + to_end * STRIPE_LEN, secret, stripes - to_end);
+        return stripes - to_end;
+    }
+    accumulate(acc, input, secret + done * SECRET_CONSUME_RATE, stripes);
+    return done + stripes;
+}
+
+static uint64_t merge_accs(const uint64_t acc[8], const uint8_t *key, uint64_t start) {
+    uint64_t result = start;
+    for (int i = 0; i < 4; i++) {
+        result += mul128_fold64(acc[2 * i] ^ read64(key + 16 * i),
+                                acc[2 * i + 1] ^ read64(key + 16 * i + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+void xxh3_128_init(xxh3_state_t *state) {
+    memcpy(state->acc, initial_acc, sizeof(state->acc));
+    state->buffered = 0;
+    state->stripes = 0;
+    state->total_length = 0;
+}
+
+void xxh3_128_update(xxh3_state_t *state, const uint8_t *data, size_t len) {
+    state->total_length += len;
+
+    // Inputs of up to MID_SIZE_MAX bytes are hashed whole from the buffer
+    if (state->buffered + len <= XXH3_BUFFER_SIZE) {
+        memcpy(state->buffer + state->buffered, data, len);
+        state->buffered += len;
+        return;
+    }
+
+    // The buffer is only consumed once more input follows, so the last
+    // stripe is always at hand for the final accumulation
+    if (state->buffered > 0) {
+        size_t fill = XXH3_BUFFER_SIZE - state->buffered;
+        memcpy(state->buffer + state->buffered, data, fill);
+        data += fill;
+        len -= fill;
+        state->stripes = consume_stripes(state->acc, state->buffer,
+                                         XXH3_BUFFER_SIZE / STRIPE_LEN, state->stripes);
+        state->buffered = 0;
+    }
+
+    if (len > XXH3_BUFFER_SIZE) {
+        do {
+            state->stripes = consume_stripes(state->acc, data,
+                                             XXH3_BUFFER_SIZE / STRIPE_LEN, state->stripes);
+            data += XXH3_BUFFER_SIZE;
+            len -= XXH3_BUFFER_SIZE;
+        } while (len > XXH3_BUFFER_SIZE);
+        // Keep the stripe before the tail for a final stripe shorter than 64 bytes
+        memcpy(state->buffer + XXH3_BUFFER_SIZE - STRIPE_LEN, data - STRIPE_LEN, STRIPE_LEN);
+    }
+
+    memcpy(state->buffer, data, len);
+    state->buffered = len;
+}
+
+void xxh3_128_final(const xxh3_state_t *state, uint8_t digest[XXH3_DIGEST_SIZE]) {
+    uint64_t length = state->total_length;
+    u128_t h;
+
+    if (length <= 16) {
+        h = len_0to16(state->buffer, (size_t)length);
+    } else if (length <= 128) {
+        h = len_17to128(state->buffer, (size_t)length);
+    } else if (length <= MID_SIZE_MAX) {
+        h = len_129to240(state->buffer, (size_t)length);
+    } else {
+        uint64_t acc[8];
+        const uint8_t *last_key = secret + SECRET_SIZE - STRIPE_LEN - SECRET_LASTACC_START;
+        memcpy(acc, state->acc, sizeof(acc));
+
+        if (state->buffered >= STRIPE_LEN) {
+            size_t stripes = (state->buffered - 1) / STRIPE_LEN;
+            consume_stripes(acc, state->buffer, stripes, state->stripes);
+            accumulate_512(acc, state->buffer + state->buffered - STRIPE_LEN, last_key);
+        } else {
+            // The last stripe overlaps the end of the previously consumed input
+            uint8_t last_stripe[STRIPE_LEN];
+            size_t catchup = STRIPE_LEN - state->buffered;
+            memcpy(last_stripe, state->buffer + XXH3_BUFFER_SIZE - catchup, catchup);
+            memcpy(last_stripe + catchup, state->buffer, state->buffered);
+            accumulate_512(acc, last_stripe, last_key);
+        }
+
+        h.lo = merge_accs(acc, secret + SECRET_MERGEACCS_START, length * PRIME64_1);
+        h.hi = merge_accs(acc, secret + SECRET_SIZE - sizeof(acc) - SECRET_MERGEACCS_START,
+                          ~(length * PRIME64_2));
+    }
+
+    write64_be(digest, h.hi);
+    write64_be(digest + 8, h.lo);
+}
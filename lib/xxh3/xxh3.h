@@ -0,0 +1,34 @@
+#ifndef XXH3_H
+#define XXH3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XXH3_DIGEST_SIZE 16
+#define XXH3_BUFFER_SIZE 256
+
+// Streaming XXH3-128 state (default secret, seed 0)
+typedef struct {
+    uint64_t acc[8];
+    uint8_t buffer[XXH3_BUFFER_SIZE];
+    size_t buffered;            // Bytes waiting in buffer
+    size_t stripes;             // Stripes accumulated into the current block
+    uint64_t total_length;
+} xxh3_state_t;
+
+void xxh3_128_init(xxh3_state_t *state);
+void xxh3_128_update(xxh3_state_t *state, const uint8_t *data, size_t len);
+
+/**
+ * Finish an XXH3-128 hash
+ *
+ * The digest is written in the canonical form of the reference
+ * implementation: the high 64 bits, then the low 64 bits, each big-endian,
+ * so its hex matches xxhsum -H2.
+ *
+ * @param state Hash state, unchanged by the call
+ * @param digest Output digest
+ */
+void xxh3_128_final(const xxh3_state_t *state, uint8_t digest[XXH3_DIGEST_SIZE]);
+
+#endif // XXH3_H
@@ -5,130 +5,702 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <time.h>
+#include <errno.h>
+#include <stdint.h>
 #include "lib/calc_md5/calc_md5.h"
 #include "lib/list_file/list_file.h"
-#include "lib/cJSON/cJSON.h"
 #include "lib/json_diff/json_diff.h"
+#include "lib/scan_pipeline/scan_pipeline.h"
+#include "lib/json_writer/json_writer.h"
+#include "lib/scan_reader/scan_reader.h"
+#include "lib/path_join/path_join.h"
+#include "lib/sort_join/sort_join.h"
+#include "lib/external_join/external_join.h"
+#include "lib/md5_mb/md5_mb.h"
+#include "lib/json_index/json_index.h"
+#include "lib/scan_bin/scan_bin.h"
+#include "lib/digest_table/digest_table.h"
 
+// Serializer stage state: records are written as soon as they arrive
 typedef struct {
-    cJSON *json_array;
-    int file_count;
-    int error_count;
+    json_writer_t *json;
+    scan_bin_writer_t *bin;     // Set instead of json for SCAN_FORMAT_BIN
+    scan_format_t format;
+    calc_hash_t hashes[CALC_HASH_COUNT];  // Algorithms of the digests, name their keys
+    int hash_count;
+    char hash_names[64];        // hashes as a comma list, formatted once for messages
     const char *base_directory;
-} process_context_t;
+    int verbose;
+    int record_count;
+    size_t skipped;             // Records dropped for an invalid digest
+    int failed;
+} scan_writer_t;
 
-// Calculate relative path from base directory
-char* get_relative_path(const char *full_path, const char *base_path) {
-    if (!full_path || !base_path) return NULL;
+// Emit one record as a JSON object, one member per digest
+static void write_json_record(json_writer_t *json, scan_format_t format, const calc_hash_t *hashes,
+                              int hash_count, int first, const scan_entry_t *entry) {
+    if (format == SCAN_FORMAT_NDJSON) {
+        json_writer_raw(json, "{");
+    } else {
+        json_writer_raw(json, first ? "\n\t\t{" : ",\n\t\t{");
+    }
+    json_writer_key(json, "path");
+    json_writer_string(json, entry->relative_path);
+    for (int i = 0; i < hash_count; i++) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, calc_hash_name(hashes[i]));
+        json_writer_string(json, entry->digests[i]);
+    }
+    if (entry->stamp) {
+        // Enough metadata for the next run to use this scan as its cache
+        char time_buffer[32];
+        json_writer_raw(json, ",");
+        json_writer_key(json, "size");
+        json_writer_uint(json, entry->stamp->size);
+        json_writer_raw(json, ",");
+        json_writer_key(json, "mtime");
+        scan_format_time_ns(entry->stamp->mtime_ns, time_buffer, sizeof(time_buffer));
+        json_writer_string(json, time_buffer);
+        json_writer_raw(json, ",");
+        json_writer_key(json, "ctime");
+        scan_format_time_ns(entry->stamp->ctime_ns, time_buffer, sizeof(time_buffer));
+        json_writer_string(json, time_buffer);
+        json_writer_raw(json, ",");
+        json_writer_key(json, "inode");
+        json_writer_uint(json, entry->stamp->inode);
+        json_writer_raw(json, ",");
+        json_writer_key(json, "dev");
+        json_writer_uint(json, entry->stamp->dev);
+    }
+    json_writer_raw(json, format == SCAN_FORMAT_NDJSON ? "}\n" : "}");
+}
+
+// Serializer stage: emit one record straight to the output
+void write_scan_entry(const scan_entry_t *entry, void *user_data) {
+    scan_writer_t *writer = (scan_writer_t *)user_data;
+    
+    if (writer->verbose) {
+        printf("Processing: %s/%s\n", writer->base_directory, entry->relative_path);
+    }
     
-    // Find the length of the base path
-    size_t base_len = strlen(base_path);
+    if (!entry->md5) {
+        fprintf(stderr, "Error calculating %s for file: %s/%s\n",
+                writer->hash_names, writer->base_directory, entry->relative_path);
+        return;
+    }
     
-    // If full_path starts with base_path, return the relative part
-    if (strncmp(full_path, base_path, base_len) == 0) {
-        const char *relative_start = full_path + base_len;
-        
-        // Skip leading slash if present
-        if (*relative_start == '/') {
-            relative_start++;
+    if (writer->format == SCAN_FORMAT_BIN) {
+        // Binary scans store one raw 128-bit digest; only converted records
+        // can fail to parse or carry wider or further digests
+        unsigned char digest[DIGEST_SIZE];
+        if (writer->hash_count > 1 ||
+            calc_hash_digest_size(writer->hashes[0]) != SCAN_BIN_DIGEST_SIZE) {
+            fprintf(stderr, "Error: Binary scans hold one 128-bit digest per record, not %s\n",
+                    writer->hash_names);
+            writer->failed = 1;
+            return;
         }
-        
-        // If the relative path is empty, return "."
-        if (*relative_start == '\0') {
-            return strdup(".");
+        if (digest_from_hex(entry->md5, SCAN_BIN_DIGEST_SIZE, digest) != 0) {
+            writer->skipped++;
+            return;
         }
-        
-        return strdup(relative_start);
+        if (scan_bin_writer_add(writer->bin, entry->relative_path, digest, entry->stamp) != 0) {
+            fprintf(stderr, "Error: Failed to store record for %s\n", entry->relative_path);
+            writer->failed = 1;
+            return;
+        }
+    } else {
+        write_json_record(writer->json, writer->format, writer->hashes, writer->hash_count,
+                          writer->record_count == 0, entry);
     }
+    writer->record_count++;
     
-    // If not under base path, return the full path
-    return strdup(full_path);
+    if (writer->verbose) {
+        printf("  Relative path: %s\n", entry->relative_path);
+        for (int i = 0; i < writer->hash_count; i++) {
+            printf("  %s: %s%s\n", calc_hash_name(writer->hashes[i]), entry->digests[i],
+                   entry->cached ? " (cached)" : "");
+        }
+    }
 }
 
-void process_file(const char *filepath, void *user_data) {
-    process_context_t *ctx = (process_context_t *)user_data;
-    char md5_string[33];
-    
-    printf("Processing: %s\n", filepath);
-    
-    if (calculate_file_md5(filepath, md5_string) == 0) {
-        // Calculate relative path
-        char *relative_path = get_relative_path(filepath, ctx->base_directory);
-        if (!relative_path) {
-            fprintf(stderr, "Error calculating relative path for: %s\n", filepath);
-            ctx->error_count++;
-            return;
+// Offsets of the scan_info counts when they are patched into a header
+typedef struct {
+    off_t total_files;
+    off_t errors;
+    off_t cached_files;
+} scan_info_slots_t;
+
+// Emit the scan_info object; with slots the counts are reserved and patched
+// once the records are written, otherwise they are taken from info
+static void write_scan_info(json_writer_t *json, const scan_info_t *info,
+                            scan_info_slots_t *slots) {
+    json_writer_raw(json, "{");
+    json_writer_key(json, "scanned_directory");
+    json_writer_string(json, info->scanned_directory);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "scan_time");
+    json_writer_string(json, info->scan_time);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "hash");
+    char names[64];
+    calc_hash_format_list(info->hashes, info->hash_count, names, sizeof(names));
+    json_writer_string(json, names);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "total_files");
+    if (slots) slots->total_files = json_writer_reserve_number(json);
+    else json_writer_uint(json, info->total_files);
+    json_writer_raw(json, ",");
+    json_writer_key(json, "errors");
+    if (slots) slots->errors = json_writer_reserve_number(json);
+    else json_writer_uint(json, info->errors);
+    if (info->has_cached_files) {
+        json_writer_raw(json, ",");
+        json_writer_key(json, "cached_files");
+        if (slots) slots->cached_files = json_writer_reserve_number(json);
+        else json_writer_uint(json, info->cached_files);
+    }
+    json_writer_raw(json, "}");
+}
+
+// Feeds records to write_scan_entry() and completes info's counts
+typedef int (*record_source_fn)(scan_writer_t *writer, scan_info_t *info, void *source);
+
+/**
+ * Write a scan result in the writer's format
+ *
+ * With info_header, a seekable JSON output gets scan_info up front with
+ * its counts patched in afterwards; otherwise scan_info is a trailer once
+ * the source has filled it in. Binary scans are written in one go at the
+ * end. Write errors set writer->failed.
+ *
+ * @return Result of the source
+ */
+static int write_scan_output(scan_writer_t *writer, scan_info_t *info, int info_header,
+                             record_source_fn source, void *source_data) {
+    json_writer_t *json = writer->json;
+    int result;
+    
+    if (writer->format == SCAN_FORMAT_BIN) {
+        result = source(writer, info, source_data);
+        if (scan_bin_writer_finish(writer->bin, info) != 0) {
+            writer->failed = 1;
         }
+        writer->bin = NULL;
+    } else if (writer->format == SCAN_FORMAT_NDJSON) {
+        // One record per line, scan_info as the last line
+        result = source(writer, info, source_data);
+        json_writer_raw(json, "{");
+        json_writer_key(json, "scan_info");
+        write_scan_info(json, info, NULL);
+        json_writer_raw(json, "}\n");
+    } else {
+        info_header = info_header && json_writer_seekable(json);
+        scan_info_slots_t slots = {-1, -1, -1};
         
-        // Create JSON object for this file
-        cJSON *file_obj = cJSON_CreateObject();
-        cJSON *path_item = cJSON_CreateString(relative_path);
-        cJSON *md5_item = cJSON_CreateString(md5_string);
-        
-        cJSON_AddItemToObject(file_obj, "path", path_item);
-        cJSON_AddItemToObject(file_obj, "md5", md5_item);
-        
-        // Add to array
-        cJSON_AddItemToArray(ctx->json_array, file_obj);
-        ctx->file_count++;
-        
-        printf("  Relative path: %s\n", relative_path);
-        printf("  MD5: %s\n", md5_string);
+        json_writer_raw(json, "{\n");
+        if (info_header) {
+            json_writer_raw(json, "\t\"scan_info\":\t");
+            write_scan_info(json, info, &slots);
+            json_writer_raw(json, ",\n");
+        }
+        json_writer_raw(json, "\t\"files\":\t[");
+        result = source(writer, info, source_data);
+        json_writer_raw(json, writer->record_count ? "\n\t]" : "]");
         
-        free(relative_path);
-    } else {
-        fprintf(stderr, "Error calculating MD5 for file: %s\n", filepath);
-        ctx->error_count++;
+        if (info_header) {
+            json_writer_raw(json, "\n}\n");
+            if (json_writer_patch_number(json, slots.total_files, info->total_files) != 0 ||
+                json_writer_patch_number(json, slots.errors, info->errors) != 0 ||
+                (info->has_cached_files &&
+                 json_writer_patch_number(json, slots.cached_files, info->cached_files) != 0)) {
+                writer->failed = 1;
+            }
+        } else {
+            json_writer_raw(json, ",\n\t\"scan_info\":\t");
+            write_scan_info(json, info, NULL);
+            json_writer_raw(json, "\n}\n");
+        }
+    }
+    return result;
+}
+
+// Record source of a directory scan
+typedef struct {
+    const char *directory;
+    const scan_pipeline_config_t *config;
+    scan_pipeline_stats_t stats;
+} scan_source_t;
+
+static int scan_directory_source(scan_writer_t *writer, scan_info_t *info, void *source) {
+    scan_source_t *scan = (scan_source_t *)source;
+    int result = scan_pipeline_run(scan->directory, scan->config,
+                                   write_scan_entry, writer, &scan->stats);
+    info->total_files = scan->stats.files;
+    info->errors = scan->stats.errors;
+    info->cached_files = scan->stats.cached;
+    return result;
+}
+
+// Record callback of a conversion: re-emit each record unchanged with the
+// digests the scan was probed to have, primary first
+static int convert_record(const scan_record_t *record, void *user_data) {
+    scan_writer_t *writer = (scan_writer_t *)user_data;
+    const char *digests[CALC_HASH_COUNT];
+    
+    for (int i = 0; i < writer->hash_count; i++) {
+        digests[i] = record->digests[writer->hashes[i]];
+        if (!digests[i]) {
+            writer->skipped++;
+            return 0;
+        }
+    }
+    scan_entry_t entry = {record->path, digests[0],
+                          record->has_stamp ? &record->stamp : NULL, 0, digests};
+    write_scan_entry(&entry, writer);
+    return writer->failed;
+}
+
+// Record source of a conversion; info is replaced by the input's scan_info
+static int convert_source(scan_writer_t *writer, scan_info_t *info, void *source) {
+    return scan_reader_read_info((const char *)source, convert_record, writer, info);
+}
+
+// Open the output of a scan or conversion for the given format; hashes
+// must already be set
+static int open_scan_writer(scan_writer_t *writer, FILE *out) {
+    calc_hash_format_list(writer->hashes, writer->hash_count, writer->hash_names,
+                          sizeof(writer->hash_names));
+    if (writer->format == SCAN_FORMAT_BIN) {
+        writer->bin = scan_bin_writer_create(out);
+        return writer->bin ? 0 : -1;
+    }
+    writer->json = json_writer_create(out);
+    return writer->json ? 0 : -1;
+}
+
+// Open "<output_file>.tmp" for a scan or conversion; it only replaces
+// output_file once complete, so a failed run leaves no partial scan behind
+static FILE *open_output_file(const char *output_file, char **temp_path) {
+    size_t length = strlen(output_file) + sizeof(".tmp");
+    *temp_path = malloc(length);
+    if (!*temp_path) return NULL;
+    snprintf(*temp_path, length, "%s.tmp", output_file);
+    
+    FILE *out = fopen(*temp_path, "wb");
+    if (!out) {
+        free(*temp_path);
+        *temp_path = NULL;
+    }
+    return out;
+}
+
+// Close an output from open_output_file(): rename it over output_file if
+// complete, remove it otherwise. Returns 0 if output_file was written.
+static int close_output_file(FILE *out, const char *output_file, char *temp_path, int complete) {
+    int result = fclose(out) == 0 && complete ? 0 : -1;
+    if (result == 0 && rename(temp_path, output_file) != 0) {
+        fprintf(stderr, "Error: Cannot replace %s: %s\n", output_file, strerror(errno));
+        result = -1;
+    }
+    if (result != 0) {
+        remove(temp_path);
     }
+    free(temp_path);
+    return result;
+}
+
+// Rewrite a scan result (JSON, NDJSON or binary) in another format
+static int convert_scan(const char *input, const char *output_file, scan_format_t format) {
+    // Check the input fits the target format before any output is created
+    calc_hash_t hashes[CALC_HASH_COUNT];
+    int hash_count;
+    if (scan_reader_probe_hash(input, hashes, &hash_count) != 0) {
+        fprintf(stderr, "Error: Failed to convert %s\n", input);
+        return 1;
+    }
+    if (format == SCAN_FORMAT_BIN &&
+        (hash_count > 1 || calc_hash_digest_size(hashes[0]) != SCAN_BIN_DIGEST_SIZE)) {
+        char names[64];
+        calc_hash_format_list(hashes, hash_count, names, sizeof(names));
+        fprintf(stderr, "Error: %s holds %s digests; --format=bin holds one 128-bit digest "
+                "(md5 or xxh128).\n", input, names);
+        return 1;
+    }
+    
+    FILE *outfile = stdout;
+    char *temp_path = NULL;
+    if (output_file) {
+        outfile = open_output_file(output_file, &temp_path);
+        if (!outfile) {
+            fprintf(stderr, "Error opening output file: %s\n", output_file);
+            return 1;
+        }
+    }
+    
+    scan_writer_t writer = {
+        .json = NULL,
+        .bin = NULL,
+        .format = format,
+        .hash_count = hash_count,
+        .base_directory = NULL,
+        .verbose = 0,
+        .record_count = 0,
+        .skipped = 0,
+        .failed = 0
+    };
+    memcpy(writer.hashes, hashes, sizeof(writer.hashes));
+    if (open_scan_writer(&writer, outfile) != 0) {
+        fprintf(stderr, "Error: Cannot create output writer.\n");
+        if (outfile != stdout) close_output_file(outfile, output_file, temp_path, 0);
+        return 1;
+    }
+    
+    // scan_info is only known once the input is read, so it always trails
+    scan_info_t info = {NULL, NULL, 0, 0, 0, 0, {CALC_HASH_MD5}, 1};
+    int result = write_scan_output(&writer, &info, 0, convert_source, (void *)input);
+    if (writer.json && json_writer_finish(writer.json) != 0) {
+        writer.failed = 1;
+    }
+    if (outfile != stdout &&
+        close_output_file(outfile, output_file, temp_path, result == 0 && !writer.failed) != 0) {
+        writer.failed = 1;
+    }
+    scan_info_free(&info);
+    
+    if (writer.skipped > 0) {
+        fprintf(stderr, "Warning: Skipped %zu records with an invalid or missing %s in %s\n",
+                writer.skipped, calc_hash_name(writer.hashes[0]), input);
+    }
+    if (result != 0 || writer.failed) {
+        fprintf(stderr, "Error: Failed to convert %s\n", input);
+        return 1;
+    }
+    if (output_file) {
+        printf("Converted %d records from %s to %s\n", writer.record_count, input, output_file);
+    }
+    return 0;
+}
+
+// Compare engine selected with --join
+typedef int (*compare_fn)(const char *file1_path, const char *file2_path,
+                          const char *diff_output_path, const char *same_output_path);
+
+// Parse a byte count with an optional K/M/G suffix
+static int parse_size(const char *text, uint64_t *size) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || errno == ERANGE) return -1;
+    
+    int shift = 0;
+    switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+    }
+    if (*end != '\0') return -1;
+    
+    // Reject sizes the unit would shift out of 64 bits
+    if (value > (UINT64_MAX >> shift)) return -1;
+    
+    *size = (uint64_t)value << shift;
+    return 0;
+}
+
+// Show what the CPU offers and which kernel every dispatcher runs on it
+static void print_cpu_features(void) {
+    printf("CPU features:");
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#define PRINT_FEATURE(name) printf(" %s%s", __builtin_cpu_supports(name) ? "+" : "-", name)
+    PRINT_FEATURE("sse2");
+    PRINT_FEATURE("ssse3");
+    PRINT_FEATURE("sse4.1");
+    PRINT_FEATURE("sse4.2");
+    PRINT_FEATURE("popcnt");
+    PRINT_FEATURE("avx");
+    PRINT_FEATURE("avx2");
+    PRINT_FEATURE("bmi");
+    PRINT_FEATURE("bmi2");
+    PRINT_FEATURE("avx512f");
+    PRINT_FEATURE("avx512bw");
+    PRINT_FEATURE("avx512vl");
+    PRINT_FEATURE("sha");
+#undef PRINT_FEATURE
+#else
+    printf(" (not x86, portable kernels only)");
+#endif
+    printf("\n");
+    
+    // Probe every kernel, then restore the one selected (possibly forced)
+    calc_md5_kernel_t md5_kernel = calc_md5_kernel();
+    printf("MD5 transform:    %-8s supported:", calc_md5_kernel_name(md5_kernel));
+    for (calc_md5_kernel_t k = CALC_MD5_GENERIC; k <= CALC_MD5_BMI2; k++) {
+        if (calc_md5_set_kernel(k) == 0) printf(" %s", calc_md5_kernel_name(k));
+    }
+    calc_md5_set_kernel(md5_kernel);
+    printf("\n");
+    
+    sha256_kernel_t sha256_kernel_current = sha256_kernel();
+    printf("SHA-256:          %-8s supported:", sha256_kernel_name(sha256_kernel_current));
+    for (sha256_kernel_t k = SHA256_GENERIC; k <= SHA256_SHANI; k++) {
+        if (sha256_set_kernel(k) == 0) printf(" %s", sha256_kernel_name(k));
+    }
+    sha256_set_kernel(sha256_kernel_current);
+    printf("\n");
+    
+    md5_mb_kernel_t mb_kernel = md5_mb_kernel();
+    printf("Multi-buffer MD5: %-8s supported:", md5_mb_kernel_name(mb_kernel));
+    for (md5_mb_kernel_t k = MD5_MB_SCALAR; k <= MD5_MB_AVX512; k++) {
+        if (md5_mb_set_kernel(k) == 0) printf(" %s", md5_mb_kernel_name(k));
+    }
+    md5_mb_set_kernel(mb_kernel);
+    printf("\n");
+    
+    json_index_kernel_t json_kernel = json_index_kernel();
+    printf("JSON index:       %-8s supported:", json_index_kernel_name(json_kernel));
+    for (json_index_kernel_t k = JSON_INDEX_SCALAR; k <= JSON_INDEX_AVX2; k++) {
+        if (json_index_set_kernel(k) == 0) printf(" %s", json_index_kernel_name(k));
+    }
+    json_index_set_kernel(json_kernel);
+    printf("\n");
 }
 
 void print_usage(const char *program_name) {
     printf("Usage: %s [OPTIONS] <directory>\n", program_name);
     printf("       %s --diff <file1.json> <file2.json>\n", program_name);
     printf("       %s --same <file1.json> <file2.json>\n", program_name);
+    printf("       %s --convert <scan> --format=<json|ndjson|bin> [-o <file>]\n", program_name);
     printf("Calculate MD5 checksums for all files in a directory tree and output as JSON,\n");
     printf("or compare two JSON files to find differences and similarities.\n\n");
     printf("Scan Mode Options:\n");
     printf("  -o <file>    Output JSON to file (default: stdout)\n");
+    printf("  -j <N>       Hash files with N worker threads (default: 1)\n");
+    printf("  --hash=<md5|xxh128|sha256|blake3>[,...]\n");
+    printf("               Digest algorithms (default: md5); xxh128 is a fast\n");
+    printf("               non-cryptographic hash for change detection. Several\n");
+    printf("               algorithms are computed in one read of each file and\n");
+    printf("               written as one field each, named after the algorithm;\n");
+    printf("               scans are compared by a digest they share, the first\n");
+    printf("               listed one preferred\n");
+    printf("  --parallel-hash\n");
+    printf("               With several --hash algorithms, hash files of 1M and up\n");
+    printf("               on one thread per algorithm, fed from a shared ring of\n");
+    printf("               read buffers (sync engine)\n");
+    printf("  --format=<json|ndjson|bin>\n");
+    printf("               Output one JSON document (default), one record per\n");
+    printf("               line with scan_info on the last line, or a compact\n");
+    printf("               binary scan (requires -o and a single --hash of md5 or\n");
+    printf("               xxh128)\n");
+    printf("  --io-engine=<sync|uring>\n");
+    printf("               File reading backend (default: sync); uring keeps many\n");
+    printf("               opens and reads in flight and falls back to sync when\n");
+    printf("               the kernel lacks io_uring support\n");
+    printf("  --multi-buffer\n");
+    printf("               Hash several files at once per worker in SIMD lanes\n");
+    printf("               (4 with SSE2, 8 with AVX2, 16 with AVX-512); uses\n");
+    printf("               synchronous reads, MD5 only\n");
+    printf("  --mmap-threshold=<size>\n");
+    printf("               Hash files of at least this size (K/M/G suffixes) from\n");
+    printf("               a read-only mmap instead of read() (default: 16M, 0 = off)\n");
+    printf("  --direct     Read files with O_DIRECT so the scan bypasses the page cache\n");
+    printf("  --fadvise    Read ahead with posix_fadvise, prefetch queued files and\n");
+    printf("               drop hashed ranges from the page cache\n");
+    printf("  --cache <file>\n");
+    printf("               Reuse digests from a previous scan for files whose device,\n");
+    printf("               inode, size, mtime and ctime are unchanged\n");
     printf("  -h           Show this help message\n\n");
-    printf("Compare Mode Options:\n");
+    printf("Compare Mode Options (scan files may be JSON, NDJSON or binary):\n");
     printf("  --diff       Compare two JSON files and output differences to diff.json\n");
     printf("  --same       Compare two JSON files and output similarities to same.json\n");
-    printf("  --both       Compare two JSON files and output both diff.json and same.json\n\n");
+    printf("  --both       Compare two JSON files and output both diff.json and same.json\n");
+    printf("  --join=<digest|sort|path>\n");
+    printf("               Match files by digest with a hash join (default) or a parallel\n");
+    printf("               radix sort and merge, or by relative path, reporting\n");
+    printf("               added, removed, modified and unchanged files\n");
+    printf("  --mem-limit=<size>\n");
+    printf("               Join by digest out of core within size bytes (K/M/G\n");
+    printf("               suffixes, at least 1M), spilling sorted runs to disk\n");
+    printf("  --temp-dir <dir>\n");
+    printf("               Directory for spilled runs (default: $TMPDIR or /tmp)\n\n");
+    printf("Convert Mode Options:\n");
+    printf("  --convert <scan>\n");
+    printf("               Rewrite a JSON, NDJSON or binary scan in the --format\n");
+    printf("               given, to -o <file> or stdout\n\n");
+    printf("Kernel Options:\n");
+    printf("  --print-cpu-features\n");
+    printf("               Show the detected CPU features and the kernel chosen for\n");
+    printf("               each hash and parse routine, then exit\n");
+    printf("  --md5-kernel=<auto|generic|bmi2>\n");
+    printf("  --mb-kernel=<auto|scalar|sse2|avx2|avx512>\n");
+    printf("  --sha256-kernel=<auto|generic|sha-ni>\n");
+    printf("  --json-kernel=<auto|scalar|sse4.2|avx2>\n");
+    printf("               Force a kernel instead of the best one the CPU supports\n");
+    printf("               (for testing); fails if the CPU cannot run it\n\n");
     printf("Examples:\n");
     printf("  Scan directory:\n");
     printf("    %s /home/user/documents\n", program_name);
     printf("    %s -o checksums.json /home/user/documents\n", program_name);
+    printf("    %s -j 8 -o checksums.json /home/user/documents\n", program_name);
+    printf("    %s --io-engine=uring -o checksums.json /home/user/documents\n", program_name);
+    printf("    %s --hash=xxh128 -o checksums.json /home/user/documents\n", program_name);
+    printf("    %s --hash=md5,sha256 -j 4 --parallel-hash -o checksums.json /srv\n", program_name);
     printf("  Compare files:\n");
     printf("    %s --diff file1.json file2.json\n", program_name);
     printf("    %s --same file1.json file2.json\n", program_name);
     printf("    %s --both file1.json file2.json\n", program_name);
+    printf("    %s --both --join=path old.json new.json\n", program_name);
+    printf("    %s --both --mem-limit=512M --temp-dir /var/tmp a.json b.json\n", program_name);
+    printf("  Convert scans:\n");
+    printf("    %s --convert checksums.json --format=bin -o checksums.bin\n", program_name);
+    printf("    %s --convert checksums.bin -o checksums.json\n", program_name);
 }
 
 int main(int argc, char *argv[]) {
     char *directory = NULL;
     char *output_file = NULL;
+    char *cache_file = NULL;
+    char *convert_file = NULL;
+    int jobs = 1;
+    scan_format_t format = SCAN_FORMAT_JSON;
+    scan_io_engine_t io_engine = SCAN_IO_SYNC;
+    int multi_buffer = 0;
+    int show_cpu_features = 0;
+    calc_md5_options_t hash_options;
+    json_diff_options_t diff_options;
     int opt;
+    
+    calc_md5_get_options(&hash_options);
+    json_diff_get_options(&diff_options);
     int mode_diff = 0;
     int mode_same = 0;
     int mode_both = 0;
+    compare_fn compare = compare_json_files;
     
     // Define long options
     static struct option long_options[] = {
         {"diff", no_argument, 0, 'd'},
         {"same", no_argument, 0, 's'},
         {"both", no_argument, 0, 'b'},
+        {"io-engine", required_argument, 0, 'e'},
+        {"mmap-threshold", required_argument, 0, 'm'},
+        {"multi-buffer", no_argument, 0, 'B'},
+        {"direct", no_argument, 0, 'D'},
+        {"fadvise", no_argument, 0, 'F'},
+        {"cache", required_argument, 0, 'c'},
+        {"format", required_argument, 0, 'f'},
+        {"join", required_argument, 0, 'J'},
+        {"convert", required_argument, 0, 'C'},
+        {"mem-limit", required_argument, 0, 'M'},
+        {"temp-dir", required_argument, 0, 'T'},
+        {"print-cpu-features", no_argument, 0, 'P'},
+        {"md5-kernel", required_argument, 0, 'K'},
+        {"mb-kernel", required_argument, 0, 'L'},
+        {"json-kernel", required_argument, 0, 'I'},
+        {"hash", required_argument, 0, 'H'},
+        {"sha256-kernel", required_argument, 0, 'S'},
+        {"parallel-hash", no_argument, 0, 'A'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
     
     // Parse command line arguments
     int option_index = 0;
-    while ((opt = getopt_long(argc, argv, "o:h", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "o:j:h", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'o':
                 output_file = optarg;
                 break;
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    fprintf(stderr, "Error: -j requires a positive number of jobs.\n\n");
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'e':
+                if (strcmp(optarg, "sync") == 0) {
+                    io_engine = SCAN_IO_SYNC;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    io_engine = SCAN_IO_URING;
+                } else {
+                    fprintf(stderr, "Error: Unknown io engine '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (parse_size(optarg, &hash_options.mmap_threshold) != 0) {
+                    fprintf(stderr, "Error: Invalid size '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'B':
+                multi_buffer = 1;
+                break;
+            case 'H':
+                if (calc_hash_parse_list(optarg, hash_options.hashes, &hash_options.hash_count) != 0) {
+                    fprintf(stderr, "Error: Unknown or repeated hash algorithm in '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'A':
+                hash_options.parallel_hashes = 1;
+                break;
+            case 'D':
+                hash_options.direct_io = 1;
+                break;
+            case 'F':
+                hash_options.fadvise = 1;
+                break;
+            case 'c':
+                cache_file = optarg;
+                break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) {
+                    format = SCAN_FORMAT_JSON;
+                } else if (strcmp(optarg, "ndjson") == 0) {
+                    format = SCAN_FORMAT_NDJSON;
+                } else if (strcmp(optarg, "bin") == 0) {
+                    format = SCAN_FORMAT_BIN;
+                } else {
+                    fprintf(stderr, "Error: Unknown output format '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'J':
+                if (strcmp(optarg, "digest") == 0) {
+                    compare = compare_json_files;
+                } else if (strcmp(optarg, "sort") == 0) {
+                    compare = compare_scan_digests;
+                } else if (strcmp(optarg, "path") == 0) {
+                    compare = compare_scan_paths;
+                } else {
+                    fprintf(stderr, "Error: Unknown join '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'C':
+                convert_file = optarg;
+                break;
+            case 'M':
+                if (parse_size(optarg, &diff_options.mem_limit) != 0 ||
+                    diff_options.mem_limit < EXTERNAL_JOIN_MIN_MEM_LIMIT) {
+                    fprintf(stderr, "Error: Invalid memory limit '%s'.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'T':
+                diff_options.temp_dir = optarg;
+                break;
             case 'd':
                 mode_diff = 1;
                 break;
@@ -138,6 +710,49 @@ int main(int argc, char *argv[]) {
             case 'b':
                 mode_both = 1;
                 break;
+            case 'P':
+                show_cpu_features = 1;
+                break;
+            case 'K': {
+                calc_md5_kernel_t kernel = CALC_MD5_AUTO;
+                while (kernel <= CALC_MD5_BMI2 && strcmp(optarg, calc_md5_kernel_name(kernel)) != 0) kernel++;
+                if (kernel > CALC_MD5_BMI2 || calc_md5_set_kernel(kernel) != 0) {
+                    fprintf(stderr, "Error: MD5 kernel '%s' is unknown or not supported by this CPU.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'L': {
+                md5_mb_kernel_t kernel = MD5_MB_AUTO;
+                while (kernel <= MD5_MB_AVX512 && strcmp(optarg, md5_mb_kernel_name(kernel)) != 0) kernel++;
+                if (kernel > MD5_MB_AVX512 || md5_mb_set_kernel(kernel) != 0) {
+                    fprintf(stderr, "Error: Multi-buffer kernel '%s' is unknown or not supported by this CPU.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'I': {
+                json_index_kernel_t kernel = JSON_INDEX_AUTO;
+                while (kernel <= JSON_INDEX_AVX2 && strcmp(optarg, json_index_kernel_name(kernel)) != 0) kernel++;
+                if (kernel > JSON_INDEX_AVX2 || json_index_set_kernel(kernel) != 0) {
+                    fprintf(stderr, "Error: JSON kernel '%s' is unknown or not supported by this CPU.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'S': {
+                sha256_kernel_t kernel = SHA256_AUTO;
+                while (kernel <= SHA256_SHANI && strcmp(optarg, sha256_kernel_name(kernel)) != 0) kernel++;
+                if (kernel > SHA256_SHANI || sha256_set_kernel(kernel) != 0) {
+                    fprintf(stderr, "Error: SHA-256 kernel '%s' is unknown or not supported by this CPU.\n\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -147,6 +762,50 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (show_cpu_features) {
+        print_cpu_features();
+        return 0;
+    }
+    
+    if (multi_buffer && io_engine == SCAN_IO_URING) {
+        fprintf(stderr, "Error: --multi-buffer reads files synchronously, drop --io-engine=uring.\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (multi_buffer && (hash_options.hash_count > 1 || hash_options.hashes[0] != CALC_HASH_MD5)) {
+        fprintf(stderr, "Error: --multi-buffer only computes MD5.\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (hash_options.parallel_hashes && io_engine == SCAN_IO_URING) {
+        fprintf(stderr, "Error: --parallel-hash reads files synchronously, drop --io-engine=uring.\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (format == SCAN_FORMAT_BIN && !convert_file &&
+        (hash_options.hash_count > 1 ||
+         calc_hash_digest_size(hash_options.hashes[0]) != SCAN_BIN_DIGEST_SIZE)) {
+        fprintf(stderr, "Error: --format=bin holds one 128-bit digest, use a single --hash=md5 or xxh128.\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    // Binary output cannot share stdout with the progress messages
+    if (format == SCAN_FORMAT_BIN && !output_file) {
+        fprintf(stderr, "Error: --format=bin requires -o <file>.\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    if (convert_file) {
+        if (optind != argc) {
+            fprintf(stderr, "Error: Convert mode takes no directory argument.\n\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        return convert_scan(convert_file, output_file, format);
+    }
+    
     // Check for comparison mode
     if (mode_diff || mode_same || mode_both) {
         // Comparison mode - need exactly 2 file arguments
@@ -159,19 +818,26 @@ int main(int argc, char *argv[]) {
         const char *file1 = argv[optind];
         const char *file2 = argv[optind + 1];
         
+        if (diff_options.mem_limit > 0 && compare == compare_scan_paths) {
+            fprintf(stderr, "Error: --mem-limit applies to the digest joins only.\n\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        json_diff_set_options(&diff_options);
+        
         const char *diff_output = "diff.json";
         const char *same_output = "same.json";
         
         if (mode_both || mode_diff) {
             if (mode_both || mode_same) {
                 // Both diff and same, or just both
-                if (compare_json_files(file1, file2, diff_output, same_output) != 0) {
+                if (compare(file1, file2, diff_output, same_output) != 0) {
                     fprintf(stderr, "Error: Failed to compare JSON files.\n");
                     return 1;
                 }
             } else {
                 // Only diff
-                if (compare_json_files(file1, file2, diff_output, "/dev/null") != 0) {
+                if (compare(file1, file2, diff_output, "/dev/null") != 0) {
                     fprintf(stderr, "Error: Failed to compare JSON files.\n");
                     return 1;
                 }
@@ -179,7 +845,7 @@ int main(int argc, char *argv[]) {
             }
         } else if (mode_same) {
             // Only same
-            if (compare_json_files(file1, file2, "/dev/null", same_output) != 0) {
+            if (compare(file1, file2, "/dev/null", same_output) != 0) {
                 fprintf(stderr, "Error: Failed to compare JSON files.\n");
                 return 1;
             }
@@ -208,90 +874,150 @@ int main(int argc, char *argv[]) {
     printf("MD5 Directory Scanner\n");
     printf("====================\n");
     printf("Scanning directory: %s\n", directory);
+    if (hash_options.hash_count > 1 || hash_options.hashes[0] != CALC_HASH_MD5) {
+        char names[64];
+        calc_hash_format_list(hash_options.hashes, hash_options.hash_count, names, sizeof(names));
+        printf("Hash algorithm%s: %s\n", hash_options.hash_count > 1 ? "s" : "", names);
+    }
+    if (hash_options.parallel_hashes && hash_options.hash_count > 1) {
+        printf("Parallel digests: %d threads per worker\n", hash_options.hash_count);
+    }
+    if (jobs > 1) {
+        printf("Hash workers: %d\n", jobs);
+    }
+    if (io_engine == SCAN_IO_URING) {
+        printf("IO engine: io_uring\n");
+    }
+    if (multi_buffer) {
+        printf("Multi-buffer MD5: %s, %d lanes per worker\n",
+               md5_mb_kernel_name(md5_mb_kernel()), md5_mb_lanes());
+    }
+    if (hash_options.direct_io) {
+        printf("Direct IO: enabled\n");
+    } else if (hash_options.fadvise) {
+        printf("Page cache hygiene: enabled\n");
+    }
     if (output_file) {
         printf("Output file: %s\n", output_file);
     } else {
         printf("Output: stdout\n");
     }
+    
+    // Load the cache before the output is opened, it may be the same file
+    scan_cache_t *cache = NULL;
+    if (cache_file) {
+        cache = scan_cache_load(cache_file, hash_options.hashes, hash_options.hash_count);
+        if (cache) {
+            printf("Cache: %zu entries from %s\n", scan_cache_size(cache), cache_file);
+        } else {
+            fprintf(stderr, "Warning: Cannot use cache %s, hashing every file\n", cache_file);
+        }
+    }
     printf("\n");
     
-    // Initialize JSON structure
-    cJSON *root = cJSON_CreateObject();
-    cJSON *info = cJSON_CreateObject();
-    cJSON *files_array = cJSON_CreateArray();
+    calc_md5_set_options(&hash_options);
     
-    // Add metadata
     char *abs_dir = get_absolute_path(directory);
-    cJSON_AddStringToObject(info, "scanned_directory", abs_dir ? abs_dir : directory);
+    const char *base_directory = abs_dir ? abs_dir : directory;
     
-    // Add timestamp
+    // Scan timestamp
     time_t now = time(NULL);
     char *time_str = ctime(&now);
     // Remove newline from ctime result
     if (time_str && strlen(time_str) > 0) {
         time_str[strlen(time_str) - 1] = '\0';
     }
-    cJSON_AddStringToObject(info, "scan_time", time_str);
     
-    cJSON_AddItemToObject(root, "scan_info", info);
-    cJSON_AddItemToObject(root, "files", files_array);
+    // Open the output before scanning; records are streamed as they are hashed
+    FILE *outfile = stdout;
+    char *temp_path = NULL;
+    if (output_file) {
+        outfile = open_output_file(output_file, &temp_path);
+        if (!outfile) {
+            fprintf(stderr, "Error opening output file: %s\n", output_file);
+            scan_cache_free(cache);
+            if (abs_dir) free(abs_dir);
+            return 1;
+        }
+    } else {
+        printf("=== JSON Output ===\n");
+    }
     
-    // Initialize processing context
-    process_context_t ctx = {
-        .json_array = files_array,
-        .file_count = 0,
-        .error_count = 0,
-        .base_directory = abs_dir ? abs_dir : directory
+    scan_writer_t writer = {
+        .json = NULL,
+        .bin = NULL,
+        .format = format,
+        .hash_count = hash_options.hash_count,
+        .base_directory = base_directory,
+        // Progress lines would interleave with JSON written to stdout
+        .verbose = output_file != NULL,
+        .record_count = 0,
+        .skipped = 0,
+        .failed = 0
     };
-    
-    // Traverse directory and process files
-    printf("Scanning files...\n\n");
-    if (traverse_directory(directory, process_file, &ctx) != 0) {
-        fprintf(stderr, "Error traversing directory.\n");
-        cJSON_Delete(root);
+    memcpy(writer.hashes, hash_options.hashes, sizeof(writer.hashes));
+    if (open_scan_writer(&writer, outfile) != 0) {
+        fprintf(stderr, "Error generating JSON output.\n");
+        if (outfile != stdout) close_output_file(outfile, output_file, temp_path, 0);
+        scan_cache_free(cache);
         if (abs_dir) free(abs_dir);
         return 1;
     }
     
-    // Add file count to metadata
-    cJSON_AddNumberToObject(info, "total_files", ctx.file_count);
-    cJSON_AddNumberToObject(info, "errors", ctx.error_count);
+    scan_pipeline_config_t config = {
+        .jobs = jobs,
+        .queue_depth = 0,
+        .io_engine = io_engine,
+        .cache = cache,
+        .multi_buffer = multi_buffer
+    };
+    scan_source_t source = {directory, &config, {0, 0, 0}};
+    scan_info_t info = {base_directory, time_str, 0, 0, 0, cache != NULL,
+                        {CALC_HASH_MD5}, hash_options.hash_count};
+    memcpy(info.hashes, hash_options.hashes, sizeof(info.hashes));
+    
+    if (output_file) {
+        printf("Scanning files...\n\n");
+    }
+    int scan_result = write_scan_output(&writer, &info, 1, scan_directory_source, &source);
+    int write_error = writer.failed;
+    if (writer.json && json_writer_finish(writer.json) != 0) {
+        write_error = 1;
+    }
     
-    // Output JSON
-    char *json_string = cJSON_Print(root);
-    if (!json_string) {
+    if (outfile != stdout &&
+        close_output_file(outfile, output_file, temp_path, scan_result == 0 && !write_error) != 0) {
+        write_error = 1;
+    }
+    scan_pipeline_stats_t stats = source.stats;
+    int cache_used = cache != NULL;
+    scan_cache_free(cache);
+    
+    if (scan_result != 0) {
+        fprintf(stderr, "Error traversing directory.\n");
+        if (abs_dir) free(abs_dir);
+        return 1;
+    }
+    if (write_error) {
         fprintf(stderr, "Error generating JSON output.\n");
-        cJSON_Delete(root);
         if (abs_dir) free(abs_dir);
         return 1;
     }
     
     if (output_file) {
-        FILE *outfile = fopen(output_file, "w");
-        if (!outfile) {
-            fprintf(stderr, "Error opening output file: %s\n", output_file);
-            free(json_string);
-            cJSON_Delete(root);
-            if (abs_dir) free(abs_dir);
-            return 1;
-        }
-        fprintf(outfile, "%s\n", json_string);
-        fclose(outfile);
         printf("\nResults written to: %s\n", output_file);
-    } else {
-        printf("\n=== JSON Output ===\n");
-        printf("%s\n", json_string);
     }
     
     printf("\nScan complete!\n");
-    printf("Files processed: %d\n", ctx.file_count);
-    if (ctx.error_count > 0) {
-        printf("Errors encountered: %d\n", ctx.error_count);
+    printf("Files processed: %zu\n", stats.files);
+    if (cache_used) {
+        printf("Reused from cache: %zu\n", stats.cached);
+    }
+    if (stats.errors > 0) {
+        printf("Errors encountered: %zu\n", stats.errors);
     }
     
     // Cleanup
-    free(json_string);
-    cJSON_Delete(root);
     if (abs_dir) free(abs_dir);
     
     return 0;